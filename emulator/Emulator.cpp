@@ -6,8 +6,13 @@
 #include "Emulator.h"
 #include "emubase/Emubase.h"
 #include "qsoundout.h"
+#include "VideoKernels.h"
 #include <QTime>
 #include <QFile>
+#include <QThread>
+#include <QThreadPool>
+#include <QSemaphore>
+#include <vector>
 
 
 //////////////////////////////////////////////////////////////////////
@@ -21,10 +26,15 @@ bool g_okEmulatorRunning = false;
 int m_wEmulatorCPUBpsCount = 0;
 quint16 m_EmulatorCPUBps[MAX_BREAKPOINTCOUNT + 1];
 quint16 m_wEmulatorTempCPUBreakpoint = 0177777;
+int m_nEmulatorCPUBpRangesCount = 0;
+quint16 m_EmulatorCPUBpRanges[MAX_BREAKPOINTRANGECOUNT * 2 + 1];
 int m_wEmulatorWatchesCount = 0;
-uint16_t m_EmulatorWatches[MAX_BREAKPOINTCOUNT];
+uint16_t m_EmulatorWatches[MAX_WATCHESCOUNT + 1];
 
 static bool m_okEmulatorSound = false;
+static bool m_okEmulatorBlockMode = false;
+static bool m_okEmulatorNativeFIS = false;
+static bool m_okEmulatorEmulHLE = false;
 
 bool m_okEmulatorSerial = false;
 FILE* m_fpEmulatorSerialOut = nullptr;
@@ -78,13 +88,13 @@ bool Emulator_Init()
 {
     ASSERT(g_pBoard == nullptr);
 
-    CProcessor::Init();
-
     m_wEmulatorCPUBpsCount = 0;
-    for (int i = 0; i <= MAX_BREAKPOINTCOUNT + 1; i++)
+    for (int i = 0; i <= MAX_BREAKPOINTCOUNT; i++)
     {
         m_EmulatorCPUBps[i] = 0177777;
     }
+    m_nEmulatorCPUBpRangesCount = 0;
+    m_EmulatorCPUBpRanges[0] = 0177777;
     m_wEmulatorWatchesCount = 0;
     for (int i = 0; i <= MAX_WATCHESCOUNT; i++)
     {
@@ -92,6 +102,8 @@ bool Emulator_Init()
     }
 
     g_pBoard = new CMotherboard();
+    g_pBoard->GetCPU()->SetNativeFIS(m_okEmulatorNativeFIS);
+    g_pBoard->SetEmulHLE(m_okEmulatorEmulHLE);
 
     // Allocate memory for old RAM values
     g_pEmulatorRam = static_cast<uint8_t*>(::calloc(65536, 1));
@@ -100,6 +112,7 @@ bool Emulator_Init()
     g_pBoard->Reset();
 
     g_sound = new QSoundOut();
+    g_pBoard->SetSoundSampleRate(SAMPLERATE);
     if (m_okEmulatorSound)
     {
         g_pBoard->SetSoundGenCallback(Emulator_FeedDAC);
@@ -114,8 +127,6 @@ void Emulator_Done()
 {
     ASSERT(g_pBoard != nullptr);
 
-    CProcessor::Done();
-
     g_pBoard->SetSoundGenCallback(nullptr);
     if (g_sound)
     {
@@ -123,6 +134,8 @@ void Emulator_Done()
         g_sound = nullptr;
     }
 
+    Emulator_SetScreenBandCount(1);  // Stop the screen rendering threads
+
     delete g_pBoard;
     g_pBoard = nullptr;
 
@@ -163,8 +176,11 @@ void Emulator_Start()
     m_emulatorTime.restart();
     m_nTickCount = 0;
 
+    if (g_sound)
+        g_sound->SetRunning(m_okEmulatorSound);
+
     // For proper breakpoint processing
-    if (m_wEmulatorCPUBpsCount != 0)
+    if (g_pBoard->HasCPUBreakpoints())
     {
         g_pBoard->GetCPU()->ClearInternalTick();
     }
@@ -175,6 +191,9 @@ void Emulator_Stop()
 
     Emulator_SetTempCPUBreakpoint(0177777);
 
+    if (g_sound)
+        g_sound->SetRunning(false);
+
     // Set title bar text
     Global_getMainWindow()->updateWindowText();
 
@@ -201,6 +220,16 @@ void Emulator_Reset()
     Global_UpdateAllViews();
 }
 
+// Put the breakpoint list and ranges into the board bitmap
+static void Emulator_UpdateCPUBreakpoints()
+{
+    g_pBoard->ClearCPUBreakpoints();
+    for (int i = 0; i < m_wEmulatorCPUBpsCount; i++)
+        g_pBoard->SetCPUBreakpoint(m_EmulatorCPUBps[i]);
+    for (int i = 0; i < m_nEmulatorCPUBpRangesCount; i++)
+        g_pBoard->SetCPUBreakpointRange(m_EmulatorCPUBpRanges[i * 2], m_EmulatorCPUBpRanges[i * 2 + 1]);
+}
+
 bool Emulator_AddCPUBreakpoint(quint16 address)
 {
     if (m_wEmulatorCPUBpsCount == MAX_BREAKPOINTCOUNT - 1 || address == 0177777)
@@ -219,6 +248,7 @@ bool Emulator_AddCPUBreakpoint(quint16 address)
         }
     }
     m_wEmulatorCPUBpsCount++;
+    Emulator_UpdateCPUBreakpoints();
     return true;
 }
 bool Emulator_RemoveCPUBreakpoint(quint16 address)
@@ -236,6 +266,7 @@ bool Emulator_RemoveCPUBreakpoint(quint16 address)
                 m_EmulatorCPUBps[i] = m_EmulatorCPUBps[m_wEmulatorCPUBpsCount];
                 m_EmulatorCPUBps[m_wEmulatorCPUBpsCount] = 0177777;
             }
+            Emulator_UpdateCPUBreakpoints();
             return true;
         }
     }
@@ -258,37 +289,53 @@ void Emulator_SetTempCPUBreakpoint(quint16 address)
     m_wEmulatorTempCPUBreakpoint = address;
     m_EmulatorCPUBps[m_wEmulatorCPUBpsCount] = address;
     m_wEmulatorCPUBpsCount++;
+    Emulator_UpdateCPUBreakpoints();
 }
 const quint16* Emulator_GetCPUBreakpointList() { return m_EmulatorCPUBps; }
-bool Emulator_IsBreakpoint()
+bool Emulator_AddCPUBreakpointRange(quint16 start, quint16 end)
+{
+    if (m_nEmulatorCPUBpRangesCount == MAX_BREAKPOINTRANGECOUNT || start > end)
+        return false;
+    m_EmulatorCPUBpRanges[m_nEmulatorCPUBpRangesCount * 2] = start;
+    m_EmulatorCPUBpRanges[m_nEmulatorCPUBpRangesCount * 2 + 1] = end;
+    m_nEmulatorCPUBpRangesCount++;
+    m_EmulatorCPUBpRanges[m_nEmulatorCPUBpRangesCount * 2] = 0177777;
+    Emulator_UpdateCPUBreakpoints();
+    return true;
+}
+bool Emulator_RemoveCPUBreakpointRange(quint16 address)
 {
-    quint16 address = g_pBoard->GetCPU()->GetPC();
-    if (m_wEmulatorCPUBpsCount > 0)
+    for (int i = 0; i < m_nEmulatorCPUBpRangesCount; i++)
     {
-        for (int i = 0; i < m_wEmulatorCPUBpsCount; i++)
+        if (address >= m_EmulatorCPUBpRanges[i * 2] && address <= m_EmulatorCPUBpRanges[i * 2 + 1])
         {
-            if (address == m_EmulatorCPUBps[i])
-                return true;
+            m_nEmulatorCPUBpRangesCount--;
+            for (int j = i * 2; j < m_nEmulatorCPUBpRangesCount * 2; j++)  // Shift the rest, keep the order
+                m_EmulatorCPUBpRanges[j] = m_EmulatorCPUBpRanges[j + 2];
+            m_EmulatorCPUBpRanges[m_nEmulatorCPUBpRangesCount * 2] = 0177777;
+            Emulator_UpdateCPUBreakpoints();
+            return true;
         }
     }
     return false;
 }
+const quint16* Emulator_GetCPUBreakpointRangeList() { return m_EmulatorCPUBpRanges; }
+bool Emulator_IsBreakpoint()
+{
+    return g_pBoard->IsCPUBreakpoint(g_pBoard->GetCPU()->GetPC());
+}
 bool Emulator_IsBreakpoint(quint16 address)
 {
-    if (m_wEmulatorCPUBpsCount == 0)
-        return false;
-    for (int i = 0; i < m_wEmulatorCPUBpsCount; i++)
-    {
-        if (address == m_EmulatorCPUBps[i])
-            return true;
-    }
-    return false;
+    return g_pBoard->IsCPUBreakpoint(address);
 }
 void Emulator_RemoveAllBreakpoints()
 {
     for (int i = 0; i < MAX_BREAKPOINTCOUNT; i++)
         m_EmulatorCPUBps[i] = 0177777;
     m_wEmulatorCPUBpsCount = 0;
+    m_nEmulatorCPUBpRangesCount = 0;
+    m_EmulatorCPUBpRanges[0] = 0177777;
+    Emulator_UpdateCPUBreakpoints();
 }
 
 const uint16_t* Emulator_GetWatchList() { return m_EmulatorWatches; }
@@ -301,7 +348,7 @@ bool Emulator_AddWatch(uint16_t address)
         if (m_EmulatorWatches[i] == address)
             return false;  // Already in the list
     }
-    for (int i = 0; i < MAX_BREAKPOINTCOUNT; i++)  // Put in the first empty cell
+    for (int i = 0; i < MAX_WATCHESCOUNT; i++)  // Put in the first empty cell
     {
         if (m_EmulatorWatches[i] == 0177777)
         {
@@ -348,10 +395,33 @@ void Emulator_SetSound(bool enable)
         else
             g_pBoard->SetSoundGenCallback(nullptr);
     }
+    if (g_sound)
+        g_sound->SetRunning(enable && g_okEmulatorRunning);
 
     m_okEmulatorSound = enable;
 }
 
+void Emulator_SetBlockMode(bool enable)
+{
+    m_okEmulatorBlockMode = enable;
+}
+
+void Emulator_SetNativeFIS(bool enable)
+{
+    if (g_pBoard != nullptr)
+        g_pBoard->GetCPU()->SetNativeFIS(enable);
+
+    m_okEmulatorNativeFIS = enable;
+}
+
+void Emulator_SetEmulHLE(bool enable)
+{
+    if (g_pBoard != nullptr)
+        g_pBoard->SetEmulHLE(enable);
+
+    m_okEmulatorEmulHLE = enable;
+}
+
 void Emulator_UpdateKeyboardMatrix(const quint8 matrix[8])
 {
     g_pBoard->UpdateKeyboardMatrix(matrix);
@@ -359,7 +429,8 @@ void Emulator_UpdateKeyboardMatrix(const quint8 matrix[8])
 
 bool Emulator_SystemFrame()
 {
-    g_pBoard->SetCPUBreakpoints(m_wEmulatorCPUBpsCount > 0 ? m_EmulatorCPUBps : nullptr);
+    // Translated blocks skip over breakpoints and trace
+    g_pBoard->GetCPU()->SetBlockMode(m_okEmulatorBlockMode && !g_pBoard->HasCPUBreakpoints() && g_pBoard->GetTrace() == 0);
 
     //Emulator_ProcessKeyEvent();
 
@@ -439,29 +510,21 @@ quint16 Emulator_GetChangeRamStatus(quint16 address)
     return *((uint16_t*)(g_pEmulatorChangedRam + address));
 }
 
-// Прототип функции, вызываемой для каждой сформированной строки экрана
-typedef void (CALLBACK* SCREEN_LINE_CALLBACK)(uint32_t* pImageBits, const quint32* pLineBits, int line);
-
-void CALLBACK PrepareScreenLine416x300(uint32_t* pImageBits, const quint32* pLineBits, int line);
-void CALLBACK PrepareScreenLine624x450(uint32_t* pImageBits, const quint32* pLineBits, int line);
-void CALLBACK PrepareScreenLine832x600(uint32_t* pImageBits, const quint32* pLineBits, int line);
-void CALLBACK PrepareScreenLine1040x750(uint32_t* pImageBits, const quint32* pLineBits, int line);
-void CALLBACK PrepareScreenLine1248x900(uint32_t* pImageBits, const quint32* pLineBits, int line);
-
+// Экран формируется в родном размере 832x300, затем масштабируется в изображение любого размера,
+// см. Emulator_ScaleScreenBand()
 struct ScreenModeStruct
 {
     int width;
     int height;
-    SCREEN_LINE_CALLBACK lineCallback;
 }
 static ScreenModeReference[] =
 {
-    // wid  hei  callback                           size      scaleX scaleY   notes
-    {  416, 300, PrepareScreenLine416x300  },  //  416 x 300   0.5     1      Debug mode
-    {  624, 450, PrepareScreenLine624x450  },  //  624 x 450   0.75    1.5
-    {  832, 600, PrepareScreenLine832x600  },  //  832 x 600   1       2
-    { 1040, 750, PrepareScreenLine1040x750 },  // 1040 x 750   1.25    2.5
-    { 1248, 900, PrepareScreenLine1248x900 },  // 1248 x 900   1.5     3
+    // wid  hei     size      scaleX scaleY   notes
+    {  416, 300 },  //  416 x 300   0.5     1      Debug mode
+    {  624, 450 },  //  624 x 450   0.75    1.5
+    {  832, 600 },  //  832 x 600   1       2
+    { 1040, 750 },  // 1040 x 750   1.25    2.5
+    { 1248, 900 },  // 1248 x 900   1.5     3
 };
 
 void Emulator_GetScreenSize(int scrmode, int* pwid, int* phei)
@@ -473,15 +536,15 @@ void Emulator_GetScreenSize(int scrmode, int* pwid, int* phei)
     *phei = pinfo->height;
 }
 
-void Emulator_PrepareScreenLines(void* pImageBits, SCREEN_LINE_CALLBACK lineCallback);
-
 void Emulator_PrepareScreenRGB32(void* pImageBits, int screenMode)
 {
     if (pImageBits == nullptr) return;
+    if (screenMode < 0 || screenMode >= sizeof(ScreenModeReference) / sizeof(ScreenModeStruct))
+        return;
 
     // Render to bitmap
-    SCREEN_LINE_CALLBACK lineCallback = ScreenModeReference[screenMode].lineCallback;
-    Emulator_PrepareScreenLines(pImageBits, lineCallback);
+    ScreenModeStruct* pinfo = ScreenModeReference + screenMode;
+    Emulator_PrepareScreenRGB32(pImageBits, pinfo->width, pinfo->height);
 }
 
 uint32_t Color16Convert(uint16_t color)
@@ -499,43 +562,151 @@ uint32_t Color16Convert(uint16_t color)
     *plinebits++ = color; *plinebits++ = color; *plinebits++ = color; *plinebits++ = color; \
     *plinebits++ = color; *plinebits++ = color; *plinebits++ = color; *plinebits++ = color; \
 }
-// Выражение для получения 16-разрядного цвета из палитры; pala = адрес старшего байта
-#define GETPALETTEHILO(pala) ((uint16_t)(pBoard->GetRAMByteView(pala) << 8) | pBoard->GetRAMByteView((pala) + 256))
 
-// Формирует 300 строк экрана; для каждой сформированной строки вызывает функцию lineCallback
-void Emulator_PrepareScreenLines(void* pImageBits, SCREEN_LINE_CALLBACK lineCallback)
+static uint32_t m_Color16Table[65536];  // Color16Convert() для всех 16-разрядных цветов
+static bool m_okColor16Table = false;
+
+// Таблица палитр 2048 байт: старший байт цвета по смещению, младший байт на 256 дальше
+static uint8_t m_PaletteBytes[2048];  // Копия таблицы палитр, по которой сделан m_PaletteColors
+static uint32_t m_PaletteAddr = 0xffffffff;  // Адрес таблицы палитр для m_PaletteColors
+static uint32_t m_PaletteColors[2048];  // Цвета RGB32 по смещению старшего байта в таблице палитр
+
+// Готовит цвета палитр; они пересчитываются только после записи в таблицу палитр или при смене её адреса.
+// Возвращает true, если цвета изменились
+static bool Emulator_UpdatePaletteCache(uint32_t tapaddr, const uint8_t* pPal)
 {
-    if (pImageBits == nullptr || lineCallback == nullptr || g_pBoard == nullptr) return;
+    if (!m_okColor16Table)
+    {
+        for (uint32_t color = 0; color < 65536; color++)
+            m_Color16Table[color] = Color16Convert((uint16_t)color);
+        m_okColor16Table = true;
+    }
 
-    uint32_t linebits[NEON_SCREEN_WIDTH];  // буфер под строку
+    if (tapaddr == m_PaletteAddr && memcmp(pPal, m_PaletteBytes, sizeof(m_PaletteBytes)) == 0)
+        return false;
+    m_PaletteAddr = tapaddr;
+    memcpy(m_PaletteBytes, pPal, sizeof(m_PaletteBytes));
+    for (uint32_t offset = 0; offset < 2048; offset++)
+    {
+        if ((offset & 256) == 0)
+            m_PaletteColors[offset] = m_Color16Table[(uint16_t)(pPal[offset] << 8) | pPal[offset + 256]];
+    }
+    return true;
+}
 
-    const CMotherboard* pBoard = g_pBoard;
+// Участок ОЗУ для отрисовки; если участок выходит за пределы ОЗУ, он копируется в buffer, снаружи ОЗУ нули
+static const uint8_t* Emulator_GetVideoSpan(const CMotherboard* pBoard, uint32_t address, uint32_t size, uint8_t* buffer)
+{
+    const uint8_t* pSpan = pBoard->GetRAMSpanView(address, size);
+    if (pSpan != nullptr)
+        return pSpan;
+    for (uint32_t i = 0; i < size; i++)
+        buffer[i] = pBoard->GetRAMByteView(address + i);
+    return buffer;
+}
 
-    uint16_t vdptaslo = pBoard->GetRAMWordView(0000010);  // VDPTAS
-    uint16_t vdptashi = pBoard->GetRAMWordView(0000012);  // VDPTAS
-    uint16_t vdptaplo = pBoard->GetRAMWordView(0000004);  // VDPTAP
-    uint16_t vdptaphi = pBoard->GetRAMWordView(0000006);  // VDPTAP
+// Состояние экрана после прошлой отрисовки, см. Emulator_PrepareScreenRGB32()
+static uint32_t m_ScreenNative[NEON_SCREEN_HEIGHT * NEON_SCREEN_WIDTH];  // Экран в родном размере
+static bool m_ScreenLineChanged[NEON_SCREEN_HEIGHT];  // Строки m_ScreenNative, перерисованные в этом кадре
+static bool m_okScreenNative = false;  // false = перерисовать весь экран
+static uint32_t m_ScreenTasAddr = 0;
+static void* m_pScreenImageBits = nullptr;  // nullptr = перемасштабировать всё изображение
+static int m_ScreenImageWidth = 0;
+static int m_ScreenImageHeight = 0;
+// Отсчёты масштабирования по ширине и высоте, см. VideoKernels_GetScaleTaps()
+static std::vector<uint16_t> m_ScaleXIndex, m_ScaleYIndex;
+static std::vector<uint8_t> m_ScaleXWeight, m_ScaleYWeight;
+
+void Emulator_InvalidateScreen()
+{
+    m_okScreenNative = false;
+    m_pScreenImageBits = nullptr;
+}
 
-    uint32_t tasaddr = (((uint32_t)vdptaslo) << 2) | (((uint32_t)(vdptashi & 0x000f)) << 18);
-    uint32_t tapaddr = (((uint32_t)vdptaplo) << 2) | (((uint32_t)(vdptaphi & 0x000f)) << 18);
-    uint16_t pal0 = GETPALETTEHILO(tapaddr);
-    uint32_t colorBorder = Color16Convert(pal0);  // Глобальный цвет бордюра
+// Была ли запись в ОЗУ, из которого формируется строка: элемент таблицы строк, дескрипторы и данные отрезков;
+// разбор отрезков такой же, как в Emulator_PrepareScreenBand()
+static bool Emulator_IsScreenLineDirty(const CMotherboard* pBoard, uint32_t tasaddr)
+{
+    if (pBoard->IsRAMDirty(tasaddr, 4))
+        return true;
+
+    uint16_t otrbuf[2];
+    const uint16_t* pTas = (const uint16_t*)Emulator_GetVideoSpan(pBoard, tasaddr, 4, (uint8_t*)otrbuf);
+    uint32_t lineaddr = (((uint32_t)pTas[0]) << 2) | (((uint32_t)(pTas[1] & 0x000f)) << 18);
+    bool firstOtr = true;
+    int bar = 52;
+    for (;;)
+    {
+        if (pBoard->IsRAMDirty(lineaddr, 4))
+            return true;
+        const uint16_t* pOtr = (const uint16_t*)Emulator_GetVideoSpan(pBoard, lineaddr, 4, (uint8_t*)otrbuf);
+        uint16_t otrlo = pOtr[0];
+        uint16_t otrhi = pOtr[1];
+        lineaddr += 4;
+        int otrcount = 32 - (otrhi >> 10) & 037;
+        if (otrcount == 0) otrcount = 32;
+        uint32_t otraddr = (((uint32_t)otrlo) << 2) | (((uint32_t)otrhi & 0x000f) << 18);
+        uint16_t vmode = (otrhi >> 6) & 0x0f;
+        if (!firstOtr)
+        {
+            bar--;  if (bar == 0) break;
+        }
+        int barcount = otrcount * 2;
+        if (!firstOtr) barcount--;
+        if (barcount > bar) barcount = bar;
+        bar -= barcount;
+        uint32_t barbytes = (vmode < 8) ? 1 : (vmode < 12 ? 2 : 4);
+        if (pBoard->IsRAMDirty(otraddr, barcount * barbytes))
+            return true;
+        if (bar <= 0) break;
+        firstOtr = false;
+    }
+    return false;
+}
+
+// Параметры отрисовки кадра, общие для всех полос
+struct ScreenFrameStruct
+{
+    const CMotherboard* pBoard;
+    uint32_t tasaddr;
+    const uint16_t* pTas;  // Таблица строк
+    const uint32_t* pColors;  // Цвета палитр, см. Emulator_UpdatePaletteCache()
+    bool okFullScreen;  // Рисовать все строки, иначе только изменившиеся
+    uint32_t* pImageBits;
+    int width, height;  // Размер изображения
+    bool okFullImage;  // Масштабировать все строки изображения, иначе только по изменившимся строкам экрана
+};
+
+// Формирует строки first..last-1 экрана в m_ScreenNative и отмечает их в m_ScreenLineChanged
+static void Emulator_PrepareScreenBand(const ScreenFrameStruct& frame, int first, int last)
+{
+    uint16_t otrbuf[2];  // буферы для участков за пределами ОЗУ
+    uint16_t databuf[52 * 2];
 
-    for (int line = 0; line < NEON_SCREEN_HEIGHT; line++)  // Цикл по строкам 0..299
+    const CMotherboard* pBoard = frame.pBoard;
+    const uint16_t* pTas = frame.pTas + first * 2;
+    const uint32_t* pColors = frame.pColors;
+    uint32_t colorBorder = pColors[0];  // Глобальный цвет бордюра
+
+    for (int line = first; line < last; line++)
     {
-        uint16_t linelo = pBoard->GetRAMWordView(tasaddr);
-        uint16_t linehi = pBoard->GetRAMWordView(tasaddr + 2);
-        tasaddr += 4;
+        uint16_t linelo = *pTas++;
+        uint16_t linehi = *pTas++;
+
+        m_ScreenLineChanged[line] = frame.okFullScreen || Emulator_IsScreenLineDirty(pBoard, frame.tasaddr + line * 4);
+        if (!m_ScreenLineChanged[line])
+            continue;
 
-        uint32_t* plinebits = linebits;
+        uint32_t* plinebits = m_ScreenNative + line * NEON_SCREEN_WIDTH;
         uint32_t lineaddr = (((uint32_t)linelo) << 2) | (((uint32_t)(linehi & 0x000f)) << 18);
         bool firstOtr = true;  // Признак первого отрезка в строке
         uint32_t colorbprev = 0;  // Цвет бордюра предыдущего отрезка
         int bar = 52;  // Счётчик полосок от 52 к 0
         for (;;)  // Цикл по видеоотрезкам строки, до полного заполнения строки
         {
-            uint16_t otrlo = pBoard->GetRAMWordView(lineaddr);
-            uint16_t otrhi = pBoard->GetRAMWordView(lineaddr + 2);
+            const uint16_t* pOtr = (const uint16_t*)Emulator_GetVideoSpan(pBoard, lineaddr, 4, (uint8_t*)otrbuf);
+            uint16_t otrlo = pOtr[0];
+            uint16_t otrhi = pOtr[1];
             lineaddr += 4;
             // Получаем параметры отрезка
             int otrcount = 32 - (otrhi >> 10) & 037;  // Длина отрезка в 32-разрядных словах
@@ -544,8 +715,8 @@ void Emulator_PrepareScreenLines(void* pImageBits, SCREEN_LINE_CALLBACK lineCall
             uint16_t otrvn = (otrhi >> 6) & 3;  // VN1 VN0 - бит/точку
             bool otrpb = (otrhi & 0x8000) != 0;
             uint16_t vmode = (otrhi >> 6) & 0x0f;  // биты VD1 VD0 VN1 VN0
-            // Получить адрес палитры
-            uint32_t paladdr = tapaddr;
+            // Получить смещение палитры в таблице палитр
+            uint32_t paladdr = 0;
             if (otrvn == 3 && otrpb)  // Многоцветный режим
             {
                 paladdr += (otrhi & 0x10) ? 1024 + 512 : 1024;
@@ -557,9 +728,7 @@ void Emulator_PrepareScreenLines(void* pImageBits, SCREEN_LINE_CALLBACK lineCall
                 paladdr += otrpn * 16;
             }
             // Бордюр
-            uint16_t palbhi = pBoard->GetRAMWordView(paladdr);
-            uint16_t palblo = pBoard->GetRAMWordView(paladdr + 256);
-            uint32_t colorb = Color16Convert((uint16_t)((palbhi & 0xff) << 8 | (palblo & 0xff)));
+            uint32_t colorb = pColors[paladdr];
             if (!firstOtr)  // Это не первый отрезок - будет бордюр, цвета по пикселям: AAAAAAAAABBCCCCC
             {
                 FILL8PIXELS(colorbprev)  FILL1PIXEL(colorbprev)
@@ -573,548 +742,262 @@ void Emulator_PrepareScreenLines(void* pImageBits, SCREEN_LINE_CALLBACK lineCall
             if (!firstOtr) barcount--;
             if (barcount > bar) barcount = bar;
             bar -= barcount;
-            // Заполняем отрезок
-            if (vmode == 0)  // VM1, плотность видео-строки 52 байта, со сдвигом влево на 2 байта
+            // Данные отрезка: на полоску 1 байт при плотности 52 байта, 2 байта при 104, 4 байта при 208
+            uint32_t barbytes = (vmode < 8) ? 1 : (vmode < 12 ? 2 : 4);
+            const uint8_t* pdata = Emulator_GetVideoSpan(pBoard, otraddr, barcount * barbytes, (uint8_t*)databuf);
+            // Заполняем отрезок: каждые bits бит данных - номер цвета в палитре для width пикселей
+            int bits, width;
+            const uint32_t* pPalette = pColors + paladdr;
+            uint32_t colors12[4];
+            if (vmode == 0 || vmode == 4)  // VM1, плотность видео-строки 52 байта
             {
-                uint16_t pal14hi = pBoard->GetRAMWordView(paladdr + 14);
-                uint16_t pal14lo = pBoard->GetRAMWordView(paladdr + 14 + 256);
-                uint32_t color0 = Color16Convert((uint16_t)((pal14hi & 0xff) << 8 | (pal14lo & 0xff)));
-                uint32_t color1 = Color16Convert((uint16_t)((pal14hi & 0xff00) | (pal14lo & 0xff00) >> 8));
-                while (barcount > 0)
-                {
-                    uint16_t bits = pBoard->GetRAMByteView(otraddr);
-                    otraddr++;
-                    uint32_t color = (bits & 1) ? color1 : color0;
-                    FILL2PIXELS(color)
-                    color = (bits & 2) ? color1 : color0;
-                    FILL2PIXELS(color)
-                    color = (bits & 4) ? color1 : color0;
-                    FILL2PIXELS(color)
-                    color = (bits & 8) ? color1 : color0;
-                    FILL2PIXELS(color)
-                    color = (bits & 16) ? color1 : color0;
-                    FILL2PIXELS(color)
-                    color = (bits & 32) ? color1 : color0;
-                    FILL2PIXELS(color)
-                    color = (bits & 64) ? color1 : color0;
-                    FILL2PIXELS(color)
-                    color = (bits & 128) ? color1 : color0;
-                    FILL2PIXELS(color)
-                    barcount--;
-                }
+                bits = 1;  width = 2;  pPalette += 14;
             }
             else if (vmode == 1)  // VM2, плотность видео-строки 52 байта
             {
-                while (barcount > 0)
-                {
-                    uint8_t bits = pBoard->GetRAMByteView(otraddr);  // читаем байт - выводим 16 пикселей
-                    otraddr++;
-                    uint32_t palc = paladdr + (bits & 3);
-                    uint16_t c = GETPALETTEHILO(palc);
-                    uint32_t color = Color16Convert(c);
-                    FILL4PIXELS(color)
-                    palc = paladdr + ((bits >> 2) & 3);
-                    c = GETPALETTEHILO(palc);
-                    color = Color16Convert(c);
-                    FILL4PIXELS(color)
-                    palc = paladdr + ((bits >> 4) & 3);
-                    c = GETPALETTEHILO(palc);
-                    color = Color16Convert(c);
-                    FILL4PIXELS(color)
-                    palc = paladdr + (bits >> 6);
-                    c = GETPALETTEHILO(palc);
-                    color = Color16Convert(c);
-                    FILL4PIXELS(color)
-                    barcount--;
-                }
+                bits = 2;  width = 4;
             }
             else if (vmode == 2 || vmode == 6 ||
                     (vmode == 3 && !otrpb) ||
                     (vmode == 7 && !otrpb))  // VM4, плотность видео-строки 52 байта
             {
-                while (barcount > 0)
-                {
-                    uint8_t bits = pBoard->GetRAMByteView(otraddr);  // читаем байт - выводим 16 пикселей
-                    otraddr++;
-                    uint32_t palc = paladdr + (bits & 15);
-                    uint16_t c = GETPALETTEHILO(palc);
-                    uint32_t color = Color16Convert(c);
-                    FILL8PIXELS(color)
-                    palc = paladdr + (bits >> 4);
-                    c = GETPALETTEHILO(palc);
-                    color = Color16Convert(c);
-                    FILL8PIXELS(color)
-                    barcount--;
-                }
+                bits = 4;  width = 8;
             }
             else if ((vmode == 3 && otrpb) ||
                     (vmode == 7 && otrpb))  // VM8, плотность видео-строки 52 байта
             {
-                while (barcount > 0)
-                {
-                    uint8_t bits = pBoard->GetRAMByteView(otraddr);  // читаем байт - выводим 16 пикселей
-                    otraddr++;
-                    uint32_t palc = paladdr + bits;
-                    uint16_t c = GETPALETTEHILO(palc);
-                    uint32_t color = Color16Convert(c);
-                    FILL8PIXELS(color)
-                    FILL8PIXELS(color)
-                    barcount--;
-                }
-            }
-            else if (vmode == 4)  // VM1, плотность видео-строки 52 байта
-            {
-                uint16_t pal14hi = pBoard->GetRAMWordView(paladdr + 14);
-                uint16_t pal14lo = pBoard->GetRAMWordView(paladdr + 14 + 256);
-                uint32_t color0 = Color16Convert((uint16_t)((pal14hi & 0xff) << 8 | (pal14lo & 0xff)));
-                uint32_t color1 = Color16Convert((uint16_t)((pal14hi & 0xff00) | (pal14lo & 0xff00) >> 8));
-                while (barcount > 0)
-                {
-                    uint16_t bits = pBoard->GetRAMWordView(otraddr & ~1);
-                    if (otraddr & 1) bits = bits >> 8;
-                    otraddr++;
-                    uint32_t color = (bits & 1) ? color1 : color0;
-                    FILL2PIXELS(color)
-                    color = (bits & 2) ? color1 : color0;
-                    FILL2PIXELS(color)
-                    color = (bits & 4) ? color1 : color0;
-                    FILL2PIXELS(color)
-                    color = (bits & 8) ? color1 : color0;
-                    FILL2PIXELS(color)
-                    color = (bits & 16) ? color1 : color0;
-                    FILL2PIXELS(color)
-                    color = (bits & 32) ? color1 : color0;
-                    FILL2PIXELS(color)
-                    color = (bits & 64) ? color1 : color0;
-                    FILL2PIXELS(color)
-                    color = (bits & 128) ? color1 : color0;
-                    FILL2PIXELS(color)
-                    barcount--;
-                }
+                bits = 8;  width = 16;
             }
             else if (vmode == 5)  // VM2, плотность видео-строки 52 байта
             {
-                while (barcount > 0)
-                {
-                    uint8_t bits = pBoard->GetRAMByteView(otraddr);  // читаем байт - выводим 16 пикселей
-                    otraddr++;
-                    uint32_t palc0 = (paladdr + 12 + (bits & 3));
-                    uint16_t c0 = GETPALETTEHILO(palc0);
-                    uint32_t color0 = Color16Convert(c0);
-                    FILL4PIXELS(color0)
-                    uint32_t palc1 = (paladdr + 12 + ((bits >> 2) & 3));
-                    uint16_t c1 = GETPALETTEHILO(palc1);
-                    uint32_t color1 = Color16Convert(c1);
-                    FILL4PIXELS(color1)
-                    uint32_t palc2 = (paladdr + 12 + ((bits >> 4) & 3));
-                    uint16_t c2 = GETPALETTEHILO(palc2);
-                    uint32_t color2 = Color16Convert(c2);
-                    FILL4PIXELS(color2)
-                    uint32_t palc3 = (paladdr + 12 + ((bits >> 6) & 3));
-                    uint16_t c3 = GETPALETTEHILO(palc3);
-                    uint32_t color3 = Color16Convert(c3);
-                    FILL4PIXELS(color3)
-                    barcount--;
-                }
+                bits = 2;  width = 4;  pPalette += 12;
             }
             else if (vmode == 8)  // VM1, плотность видео-строки 104 байта
             {
-                uint16_t pal14hi = pBoard->GetRAMWordView(paladdr + 14);
-                uint16_t pal14lo = pBoard->GetRAMWordView(paladdr + 14 + 256);
-                uint32_t color0 = Color16Convert((uint16_t)((pal14hi & 0xff) << 8 | (pal14lo & 0xff)));
-                uint32_t color1 = Color16Convert((uint16_t)((pal14hi & 0xff00) | (pal14lo & 0xff00) >> 8));
-                while (barcount > 0)
-                {
-                    uint16_t bits = pBoard->GetRAMWordView(otraddr);
-                    otraddr += 2;
-                    uint32_t color = (bits & 1) ? color1 : color0;
-                    FILL1PIXEL(color)
-                    color = (bits & 2) ? color1 : color0;
-                    FILL1PIXEL(color)
-                    color = (bits & 4) ? color1 : color0;
-                    FILL1PIXEL(color)
-                    color = (bits & 8) ? color1 : color0;
-                    FILL1PIXEL(color)
-                    color = (bits & 16) ? color1 : color0;
-                    FILL1PIXEL(color)
-                    color = (bits & 32) ? color1 : color0;
-                    FILL1PIXEL(color)
-                    color = (bits & 64) ? color1 : color0;
-                    FILL1PIXEL(color)
-                    color = (bits & 128) ? color1 : color0;
-                    FILL1PIXEL(color)
-                    color = (bits & 0x0100) ? color1 : color0;
-                    FILL1PIXEL(color)
-                    color = (bits & 0x0200) ? color1 : color0;
-                    FILL1PIXEL(color)
-                    color = (bits & 0x0400) ? color1 : color0;
-                    FILL1PIXEL(color)
-                    color = (bits & 0x0800) ? color1 : color0;
-                    FILL1PIXEL(color)
-                    color = (bits & 0x1000) ? color1 : color0;
-                    FILL1PIXEL(color)
-                    color = (bits & 0x2000) ? color1 : color0;
-                    FILL1PIXEL(color)
-                    color = (bits & 0x4000) ? color1 : color0;
-                    FILL1PIXEL(color)
-                    color = (bits & 0x8000) ? color1 : color0;
-                    FILL1PIXEL(color)
-                    barcount--;
-                }
+                bits = 1;  width = 1;  pPalette += 14;
             }
-            else if (vmode == 9)
+            else if (vmode == 9)  // VM2, плотность видео-строки 104 байта
             {
-                while (barcount > 0)
-                {
-                    uint16_t bits = pBoard->GetRAMWordView(otraddr);  // читаем слово - выводим 16 пикселей
-                    otraddr += 2;
-                    uint32_t palc0 = (paladdr + 12 + (bits & 3));
-                    uint16_t c0 = GETPALETTEHILO(palc0);
-                    uint32_t color0 = Color16Convert(c0);
-                    FILL2PIXELS(color0)
-                    uint32_t palc1 = (paladdr + 12 + ((bits >> 2) & 3));
-                    uint16_t c1 = GETPALETTEHILO(palc1);
-                    uint32_t color1 = Color16Convert(c1);
-                    FILL2PIXELS(color1)
-                    uint32_t palc2 = (paladdr + 12 + ((bits >> 4) & 3));
-                    uint16_t c2 = GETPALETTEHILO(palc2);
-                    uint32_t color2 = Color16Convert(c2);
-                    FILL2PIXELS(color2)
-                    uint32_t palc3 = (paladdr + 12 + ((bits >> 6) & 3));
-                    uint16_t c3 = GETPALETTEHILO(palc3);
-                    uint32_t color3 = Color16Convert(c3);
-                    FILL2PIXELS(color3)
-                    uint32_t palc4 = (paladdr + 12 + ((bits >> 8) & 3));
-                    uint16_t c4 = GETPALETTEHILO(palc4);
-                    uint32_t color4 = Color16Convert(c4);
-                    FILL2PIXELS(color4)
-                    uint32_t palc5 = (paladdr + 12 + ((bits >> 10) & 3));
-                    uint16_t c5 = GETPALETTEHILO(palc5);
-                    uint32_t color5 = Color16Convert(c5);
-                    FILL2PIXELS(color5)
-                    uint32_t palc6 = (paladdr + 12 + ((bits >> 12) & 3));
-                    uint16_t c6 = GETPALETTEHILO(palc6);
-                    uint32_t color6 = Color16Convert(c6);
-                    FILL2PIXELS(color6)
-                    uint32_t palc7 = (paladdr + 12 + ((bits >> 14) & 3));
-                    uint16_t c7 = GETPALETTEHILO(palc7);
-                    uint32_t color7 = Color16Convert(c7);
-                    FILL2PIXELS(color7)
-                    barcount--;
-                }
+                bits = 2;  width = 2;  pPalette += 12;
             }
-            else if (vmode == 10)  // VM4, плотность видео-строки 104 байта
+            else if (vmode == 10 ||  // VM4, плотность видео-строки 104 байта
+                    (vmode == 11 && !otrpb))  // VM41, плотность видео-строки 104 байта
             {
-                while (barcount > 0)
-                {
-                    uint16_t bits = pBoard->GetRAMWordView(otraddr);  // читаем слово - выводим 16 пикселей
-                    otraddr += 2;
-                    uint32_t palc = paladdr + (bits & 15);
-                    uint16_t c = GETPALETTEHILO(palc);
-                    uint32_t color = Color16Convert(c);
-                    FILL4PIXELS(color)
-                    palc = paladdr + ((bits >> 4) & 15);
-                    c = GETPALETTEHILO(palc);
-                    color = Color16Convert(c);
-                    FILL4PIXELS(color)
-                    palc = paladdr + ((bits >> 8) & 15);
-                    c = GETPALETTEHILO(palc);
-                    color = Color16Convert(c);
-                    FILL4PIXELS(color)
-                    palc = paladdr + ((bits >> 12) & 15);
-                    c = GETPALETTEHILO(palc);
-                    color = Color16Convert(c);
-                    FILL4PIXELS(color)
-                    barcount--;
-                }
-            }
-            else if (vmode == 11 && !otrpb)  // VM41, плотность видео-строки 104 байта
-            {
-                while (barcount > 0)
-                {
-                    uint16_t bits = pBoard->GetRAMWordView(otraddr);  // читаем слово - выводим 16 пикселей
-                    otraddr += 2;
-                    uint32_t palc0 = (paladdr + (bits & 15));
-                    uint16_t c0 = GETPALETTEHILO(palc0);
-                    uint32_t color0 = Color16Convert(c0);
-                    FILL4PIXELS(color0)
-                    uint32_t palc1 = (paladdr + ((bits >> 4) & 15));
-                    uint16_t c1 = GETPALETTEHILO(palc1);
-                    uint32_t color1 = Color16Convert(c1);
-                    FILL4PIXELS(color1)
-                    uint32_t palc2 = (paladdr + ((bits >> 8) & 15));
-                    uint16_t c2 = GETPALETTEHILO(palc2);
-                    uint32_t color2 = Color16Convert(c2);
-                    FILL4PIXELS(color2)
-                    uint32_t palc3 = (paladdr + ((bits >> 12) & 15));
-                    uint16_t c3 = GETPALETTEHILO(palc3);
-                    uint32_t color3 = Color16Convert(c3);
-                    FILL4PIXELS(color3)
-                    barcount--;
-                }
+                bits = 4;  width = 4;
             }
             else if (vmode == 11 && otrpb)  // VM8, плотность видео-строки 104 байта
             {
-                while (barcount > 0)
-                {
-                    uint16_t bits = pBoard->GetRAMWordView(otraddr);  // читаем слово - выводим 16 пикселей
-                    otraddr += 2;
-                    uint32_t palc0 = (paladdr + (bits & 0xff));
-                    uint16_t c0 = GETPALETTEHILO(palc0);
-                    uint32_t color0 = Color16Convert(c0);
-                    FILL8PIXELS(color0)
-                    uint32_t palc1 = (paladdr + (bits >> 8));
-                    uint16_t c1 = GETPALETTEHILO(palc1);
-                    uint32_t color1 = Color16Convert(c1);
-                    FILL8PIXELS(color1)
-                    barcount--;
-                }
+                bits = 8;  width = 8;
             }
             else if (vmode == 13)  // VM2, плотность видео-строки 208 байт
             {
-                for (int j = 0; j < barcount * 2; j++)
-                {
-                    uint16_t bits = pBoard->GetRAMWordView(otraddr);  // читаем слово - выводим 8 пикселей
-                    otraddr += 2;
-                    uint32_t palc0 = (paladdr + 12 + (bits & 3));
-                    uint16_t c0 = GETPALETTEHILO(palc0);
-                    uint32_t color0 = Color16Convert(c0);
-                    FILL1PIXEL(color0)
-                    uint32_t palc1 = (paladdr + 12 + ((bits >> 2) & 3));
-                    uint16_t c1 = GETPALETTEHILO(palc1);
-                    uint32_t color1 = Color16Convert(c1);
-                    FILL1PIXEL(color1)
-                    uint32_t palc2 = (paladdr + 12 + ((bits >> 4) & 3));
-                    uint16_t c2 = GETPALETTEHILO(palc2);
-                    uint32_t color2 = Color16Convert(c2);
-                    FILL1PIXEL(color2)
-                    uint32_t palc3 = (paladdr + 12 + ((bits >> 6) & 3));
-                    uint16_t c3 = GETPALETTEHILO(palc3);
-                    uint32_t color3 = Color16Convert(c3);
-                    FILL1PIXEL(color3)
-                    uint32_t palc4 = (paladdr + 12 + ((bits >> 8) & 3));
-                    uint16_t c4 = GETPALETTEHILO(palc4);
-                    uint32_t color4 = Color16Convert(c4);
-                    FILL1PIXEL(color4)
-                    uint32_t palc5 = (paladdr + 12 + ((bits >> 10) & 3));
-                    uint16_t c5 = GETPALETTEHILO(palc5);
-                    uint32_t color5 = Color16Convert(c5);
-                    FILL1PIXEL(color5)
-                    uint32_t palc6 = (paladdr + 12 + ((bits >> 12) & 3));
-                    uint16_t c6 = GETPALETTEHILO(palc6);
-                    uint32_t color6 = Color16Convert(c6);
-                    FILL1PIXEL(color6)
-                    uint32_t palc7 = (paladdr + 12 + ((bits >> 14) & 3));
-                    uint16_t c7 = GETPALETTEHILO(palc7);
-                    uint32_t color7 = Color16Convert(c7);
-                    FILL1PIXEL(color7)
-                }
+                bits = 2;  width = 1;  pPalette += 12;
             }
             else if ((vmode == 14) ||  // VM4, плотность видео-строки 208 байт
                     (vmode == 15 && !otrpb))  // VM41, плотность видео-строки 208 байт
             {
-                for (int j = 0; j < barcount * 2; j++)
-                {
-                    uint16_t bits = pBoard->GetRAMWordView(otraddr);  // читаем слово - выводим 8 пикселей
-                    otraddr += 2;
-                    uint32_t palc0 = (paladdr + (bits & 15));
-                    uint16_t c0 = GETPALETTEHILO(palc0);
-                    uint32_t color0 = Color16Convert(c0);
-                    FILL2PIXELS(color0)
-                    uint32_t palc1 = (paladdr + ((bits >> 4) & 15));
-                    uint16_t c1 = GETPALETTEHILO(palc1);
-                    uint32_t color1 = Color16Convert(c1);
-                    FILL2PIXELS(color1)
-                    uint32_t palc2 = (paladdr + ((bits >> 8) & 15));
-                    uint16_t c2 = GETPALETTEHILO(palc2);
-                    uint32_t color2 = Color16Convert(c2);
-                    FILL2PIXELS(color2)
-                    uint32_t palc3 = (paladdr + ((bits >> 12) & 15));
-                    uint16_t c3 = GETPALETTEHILO(palc3);
-                    uint32_t color3 = Color16Convert(c3);
-                    FILL2PIXELS(color3)
-                }
+                bits = 4;  width = 2;
             }
             else if (vmode == 15 && otrpb)  // VM8, плотность видео-строки 208 байт
             {
-                while (barcount > 0)
-                {
-                    uint16_t bits0 = pBoard->GetRAMWordView(otraddr);  // читаем слово - выводим 8 пикселей
-                    otraddr += 2;
-                    uint32_t palc0 = (paladdr + (bits0 & 0xff));
-                    uint16_t c0 = GETPALETTEHILO(palc0);
-                    uint32_t color0 = Color16Convert(c0);
-                    FILL4PIXELS(color0)
-                    uint32_t palc1 = (paladdr + (bits0 >> 8));
-                    uint16_t c1 = GETPALETTEHILO(palc1);
-                    uint32_t color1 = Color16Convert(c1);
-                    FILL4PIXELS(color1)
-                    uint16_t bits1 = pBoard->GetRAMWordView(otraddr);  // читаем слово - выводим 8 пикселей
-                    otraddr += 2;
-                    uint32_t palc2 = (paladdr + (bits1 & 0xff));
-                    uint16_t c2 = GETPALETTEHILO(palc2);
-                    uint32_t color2 = Color16Convert(c2);
-                    FILL4PIXELS(color2)
-                    uint32_t palc3 = (paladdr + (bits1 >> 8));
-                    uint16_t c3 = GETPALETTEHILO(palc3);
-                    uint32_t color3 = Color16Convert(c3);
-                    FILL4PIXELS(color3)
-                    barcount--;
-                }
+                bits = 8;  width = 4;
             }
             else //if (vmode == 12)  // VM1, плотность видео-строки 208 байт - запрещенный режим
             {
                 //NOTE: Как выяснилось, берутся только чётные биты из строки в 208 байт
-                uint16_t pal14hi = pBoard->GetRAMWordView(paladdr + 14);
-                uint16_t pal14lo = pBoard->GetRAMWordView(paladdr + 14 + 256);
-                uint32_t color0 = Color16Convert((uint16_t)((pal14hi & 0xff) << 8 | (pal14lo & 0xff)));
-                uint32_t color1 = Color16Convert((uint16_t)((pal14hi & 0xff00) | (pal14lo & 0xff00) >> 8));
-                while (barcount > 0)
-                {
-                    uint16_t bits = pBoard->GetRAMWordView(otraddr);
-                    otraddr += 2;
-                    for (uint16_t k = 0; k < 8; k++)
-                    {
-                        uint32_t color = (bits & 2) ? color1 : color0;
-                        FILL1PIXEL(color)
-                        bits = bits >> 2;
-                    }
-                    bits = pBoard->GetRAMWordView(otraddr);
-                    otraddr += 2;
-                    for (uint16_t k = 0; k < 8; k++)
-                    {
-                        uint32_t color = (bits & 2) ? color1 : color0;
-                        FILL1PIXEL(color)
-                        bits = bits >> 2;
-                    }
-                    barcount--;
-                }
+                colors12[0] = colors12[1] = pPalette[14];
+                colors12[2] = colors12[3] = pPalette[15];
+                pPalette = colors12;
+                bits = 2;  width = 1;
             }
+            VIDEOEXPANDPROC expand = VideoKernels_GetExpandProc(bits, width);
+            (*expand)(plinebits, pdata, (int)(barcount * barbytes), pPalette);
+            plinebits += barcount * 16;
 
             if (bar <= 0) break;
             firstOtr = false;
         }
-
-        (*lineCallback)((uint32_t*)pImageBits, linebits, line);
     }
 }
 
-// 1/2 part of "a" plus 1/2 part of "b"
-#define AVERAGERGB(a, b)  ( (((a) & 0xfefefeffUL) + ((b) & 0xfefefeffUL)) >> 1 )
-
-// 1/4 part of "a" plus 3/4 parts of "b"
-#define AVERAGERGB13(a, b)  ( ((a) == (b)) ? a : (((a) & 0xfcfcfcffUL) >> 2) + ((b) - (((b) & 0xfcfcfcffUL) >> 2)) )
+// Строки экрана, масштабированные по ширине изображения: две последние строки, в буфере или прямо в изображении
+struct ScaledLinesStruct
+{
+    int lines[2];
+    const uint32_t* pBits[2];
+    std::vector<uint32_t> buffer;  // Место под две строки
+};
 
-void CALLBACK PrepareScreenLine416x300(uint32_t* pImageBits, const uint32_t* pLineBits, int line)
+// Строка line экрана, масштабированная по ширине изображения; строку keep не вытесняем.
+// Если pTarget не nullptr, новая строка масштабируется прямо туда - это строка изображения из одной строки экрана
+static const uint32_t* Emulator_GetScaledScreenLine(
+    int line, int keep, uint32_t* pTarget, int width, ScaledLinesStruct& scaled, VIDEOSCALEROWPROC scaleRow)
 {
-    uint32_t* pBits = pImageBits + line * 416;
-    for (int x = 0; x < 832; x += 2)
-    {
-        uint32_t color1 = *pLineBits++;
-        uint32_t color2 = *pLineBits++;
-        uint32_t color = AVERAGERGB(color1, color2);
-        *pBits++ = color;
-    }
+    const uint32_t* pLine = m_ScreenNative + line * NEON_SCREEN_WIDTH;
+    if (width == NEON_SCREEN_WIDTH)
+        return pLine;
+    if (scaled.lines[0] == line)
+        return scaled.pBits[0];
+    if (scaled.lines[1] == line)
+        return scaled.pBits[1];
+    int slot = (scaled.lines[0] == keep) ? 1 : 0;
+    uint32_t* pRow = (pTarget != nullptr) ? pTarget : scaled.buffer.data() + slot * width;
+    (*scaleRow)(pRow, pLine, NEON_SCREEN_WIDTH, m_ScaleXIndex.data(), m_ScaleXWeight.data(), width);
+    scaled.lines[slot] = line;
+    scaled.pBits[slot] = pRow;
+    return pRow;
 }
 
-void CALLBACK PrepareScreenLine624x450(uint32_t* pImageBits, const uint32_t* pLineBits, int line)
+// Масштабирует экран в строки first..last-1 изображения: каждая точка изображения - смесь двух соседних
+// строк и двух соседних точек экрана, по площади, в четвертях; пропускает строки из неизменившихся строк экрана
+static void Emulator_ScaleScreenBand(const ScreenFrameStruct& frame, int first, int last)
 {
-    bool even = (line & 1) == 0;
-    uint32_t* pBits = pImageBits + (line / 2 * 3) * 624;
-    if (!even)
-        pBits += 624 * 2;
-
-    uint32_t* p = pBits;
-    for (int x = 0; x < 832; x += 4)  // x0.75 - mapping every 4 pixels into 3 pixels
+    const int width = frame.width;
+    ScaledLinesStruct scaled;
+    scaled.lines[0] = scaled.lines[1] = -1;
+    scaled.buffer.resize(width == NEON_SCREEN_WIDTH ? 0 : width * 2);
+    VIDEOSCALEROWPROC scaleRow = VideoKernels_GetScaleRowProc();
+    VIDEOBLENDROWSPROC blendRows = VideoKernels_GetBlendRowsProc();
+    for (int y = first; y < last; y++)
     {
-        uint32_t color1 = *pLineBits++;
-        uint32_t color2 = *pLineBits++;
-        uint32_t color3 = *pLineBits++;
-        uint32_t color4 = *pLineBits++;
-        *p++ = AVERAGERGB13(color2, color1);
-        *p++ = AVERAGERGB(color2, color3);
-        *p++ = AVERAGERGB13(color3, color4);
-    }
+        int line = m_ScaleYIndex[y];
+        int weight = m_ScaleYWeight[y];
+        if (!frame.okFullImage && !(weight < 4 && m_ScreenLineChanged[line]) && !(weight > 0 && m_ScreenLineChanged[line + 1]))
+            continue;
 
-    if (!even)  // odd line
-    {
-        uint32_t* pBits1 = pBits;
-        uint32_t* pBits12 = pBits1 - 624;
-        uint32_t* pBits2 = pBits12 - 624;
-        for (int x = 0; x < 624; x++)
+        uint32_t* pDest = frame.pImageBits + y * width;
+        if (weight == 0 || weight == 4)  // Строка изображения из одной строки экрана
         {
-            uint32_t color1 = *pBits1++;
-            uint32_t color2 = *pBits2++;
-            uint32_t color12 = AVERAGERGB(color1, color2);
-            *pBits12++ = color12;
+            const uint32_t* pRow = Emulator_GetScaledScreenLine(line + weight / 4, -1, pDest, width, scaled, scaleRow);
+            if (pRow != pDest)
+                ::memcpy(pDest, pRow, width * sizeof(uint32_t));
+            continue;
         }
+        const uint32_t* pRowA = Emulator_GetScaledScreenLine(line, -1, nullptr, width, scaled, scaleRow);
+        const uint32_t* pRowB = Emulator_GetScaledScreenLine(line + 1, line, nullptr, width, scaled, scaleRow);
+        (*blendRows)(pDest, pRowA, pRowB, weight, width);
     }
 }
 
-void CALLBACK PrepareScreenLine832x600(uint32_t* pImageBits, const uint32_t* pLineBits, int line)
+// Многопоточная отрисовка: кадр делится на полосы строк, первую полосу рисует вызывающий поток,
+// остальные - постоянный пул потоков; ОЗУ во время отрисовки не меняется, эмулятор стоит в том же потоке
+#define SCREEN_BANDS_MAX 4
+static int m_nScreenBands = 0;  // 0 = ещё не выбрано, см. Emulator_SetScreenBandCount()
+static QThreadPool* m_pScreenThreadPool = nullptr;
+static QSemaphore m_ScreenBandsDone;
+
+typedef void (*SCREEN_BAND_PROC)(const ScreenFrameStruct& frame, int first, int last);
+
+class ScreenBandTask : public QRunnable
 {
-    uint32_t* pBits = pImageBits + line * 832 * 2;
-    memcpy(pBits, pLineBits, sizeof(uint32_t) * 832);
-    pBits += 832;
-    memcpy(pBits, pLineBits, sizeof(uint32_t) * 832);
+public:
+    ScreenBandTask() : m_proc(nullptr), m_pFrame(nullptr), m_first(0), m_last(0) { setAutoDelete(false); }
+    void Set(SCREEN_BAND_PROC proc, const ScreenFrameStruct* pFrame, int first, int last)
+    {
+        m_proc = proc;  m_pFrame = pFrame;  m_first = first;  m_last = last;
+    }
+    void run() override
+    {
+        (*m_proc)(*m_pFrame, m_first, m_last);
+        m_ScreenBandsDone.release();
+    }
+private:
+    SCREEN_BAND_PROC m_proc;
+    const ScreenFrameStruct* m_pFrame;
+    int m_first, m_last;
 }
+static m_ScreenBandTasks[SCREEN_BANDS_MAX - 1];
 
-void CALLBACK PrepareScreenLine1040x750(uint32_t* pImageBits, const uint32_t* pLineBits, int line)
+void Emulator_SetScreenBandCount(int count)
 {
-    bool even = (line & 1) == 0;
-    uint32_t* pBits = pImageBits + (line / 2 * 5) * 1040;
-    if (!even)
-        pBits += 1040 * 3;
+    if (m_pScreenThreadPool != nullptr)
+    {
+        delete m_pScreenThreadPool;  // Ждёт завершения потоков
+        m_pScreenThreadPool = nullptr;
+    }
 
-    uint32_t* p = pBits;
-    for (int x = 0; x < 832; x += 4)  // x1.25 - mapping every 4 pixels into 5 pixels
+    VideoKernels_Init();  // Уровень ядер выбирается до запуска полос, потоки его только читают
+    if (count <= 0)
+        count = QThread::idealThreadCount();
+    m_nScreenBands = qBound(1, count, SCREEN_BANDS_MAX);
+    if (m_nScreenBands > 1)
     {
-        uint32_t color1 = *pLineBits++;
-        uint32_t color2 = *pLineBits++;
-        uint32_t color3 = *pLineBits++;
-        uint32_t color4 = *pLineBits++;
-        *p++ = color1;
-        *p++ = AVERAGERGB13(color1, color2);
-        *p++ = AVERAGERGB(color2, color3);
-        *p++ = AVERAGERGB13(color4, color3);
-        *p++ = color4;
+        m_pScreenThreadPool = new QThreadPool();
+        m_pScreenThreadPool->setMaxThreadCount(m_nScreenBands - 1);
+        m_pScreenThreadPool->setExpiryTimeout(-1);  // Потоки живут до Emulator_SetScreenBandCount()
     }
+}
 
-    memcpy(pBits + 1040, pBits, sizeof(uint32_t) * 1040);
+int Emulator_GetScreenBandCount()
+{
+    return m_nScreenBands;
+}
 
-    if (!even)  // odd line
+// Выполняет proc для строк 0..count-1, разбитых на полосы, и ждёт завершения всех полос
+static void Emulator_RunScreenBands(SCREEN_BAND_PROC proc, const ScreenFrameStruct& frame, int count)
+{
+    if (m_nScreenBands == 0)
+        Emulator_SetScreenBandCount(0);
+    int bands = m_nScreenBands;
+    for (int band = 1; band < bands; band++)
     {
-        uint32_t* pBits1 = pBits;
-        uint32_t* pBits12 = pBits1 - 1040;
-        uint32_t* pBits2 = pBits12 - 1040;
-        for (int x = 0; x < 1040; x++)
-        {
-            uint32_t color1 = *pBits1++;
-            uint32_t color2 = *pBits2++;
-            uint32_t color12 = AVERAGERGB(color1, color2);
-            *pBits12++ = color12;
-        }
+        ScreenBandTask* pTask = m_ScreenBandTasks + band - 1;
+        pTask->Set(proc, &frame, count * band / bands, count * (band + 1) / bands);
+        m_pScreenThreadPool->start(pTask);
     }
+    (*proc)(frame, 0, count / bands);
+    m_ScreenBandsDone.acquire(bands - 1);  // Ждём остальные полосы
 }
 
-void CALLBACK PrepareScreenLine1248x900(uint32_t* pImageBits, const uint32_t* pLineBits, int line)
+// Формирует экран и масштабирует его в изображение width x height. Перерисовываются только строки экрана,
+// для которых была запись в их данные в ОЗУ, и только строки изображения из этих строк экрана
+void Emulator_PrepareScreenRGB32(void* pImageBits, int width, int height)
 {
-    uint32_t* pBits = pImageBits + line * 1248 * 3;
-    uint32_t* p = pBits;
-    for (int x = 0; x < 832 / 2; x++)
+    if (pImageBits == nullptr || width <= 0 || height <= 0 || g_pBoard == nullptr) return;
+
+    uint16_t tasbuf[NEON_SCREEN_HEIGHT * 2];  // буферы для участков за пределами ОЗУ
+    uint16_t palbuf[1024];
+
+    const CMotherboard* pBoard = g_pBoard;
+
+    uint16_t vdptaslo = pBoard->GetRAMWordView(0000010);  // VDPTAS
+    uint16_t vdptashi = pBoard->GetRAMWordView(0000012);  // VDPTAS
+    uint16_t vdptaplo = pBoard->GetRAMWordView(0000004);  // VDPTAP
+    uint16_t vdptaphi = pBoard->GetRAMWordView(0000006);  // VDPTAP
+
+    uint32_t tasaddr = (((uint32_t)vdptaslo) << 2) | (((uint32_t)(vdptashi & 0x000f)) << 18);
+    uint32_t tapaddr = (((uint32_t)vdptaplo) << 2) | (((uint32_t)(vdptaphi & 0x000f)) << 18);
+    const uint8_t* pPal = Emulator_GetVideoSpan(pBoard, tapaddr, 2048, (uint8_t*)palbuf);  // Таблица палитр
+    bool okPaletteChanged = Emulator_UpdatePaletteCache(tapaddr, pPal);
+
+    if (width != m_ScreenImageWidth || height != m_ScreenImageHeight)
     {
-        uint32_t color1 = *pLineBits++;
-        uint32_t color2 = *pLineBits++;
-        uint32_t color12 = AVERAGERGB(color1, color2);
-        *p++ = color1;
-        *p++ = color12;
-        *p++ = color2;
+        m_ScaleXIndex.resize(width);  m_ScaleXWeight.resize(width);
+        m_ScaleYIndex.resize(height);  m_ScaleYWeight.resize(height);
+        VideoKernels_GetScaleTaps(NEON_SCREEN_WIDTH, width, m_ScaleXIndex.data(), m_ScaleXWeight.data());
+        VideoKernels_GetScaleTaps(NEON_SCREEN_HEIGHT, height, m_ScaleYIndex.data(), m_ScaleYWeight.data());
     }
 
-    uint32_t* pBits2 = pBits + 1248;
-    memcpy(pBits2, pBits, sizeof(uint32_t) * 1248);
-    uint32_t* pBits3 = pBits2 + 1248;
-    memcpy(pBits3, pBits, sizeof(uint32_t) * 1248);
+    ScreenFrameStruct frame;
+    frame.pBoard = pBoard;
+    frame.tasaddr = tasaddr;
+    frame.pTas = (const uint16_t*)Emulator_GetVideoSpan(pBoard, tasaddr, NEON_SCREEN_HEIGHT * 4, (uint8_t*)tasbuf);
+    frame.pColors = m_PaletteColors;
+    frame.okFullScreen = !m_okScreenNative || okPaletteChanged || tasaddr != m_ScreenTasAddr;
+    frame.pImageBits = (uint32_t*)pImageBits;
+    frame.width = width;
+    frame.height = height;
+    frame.okFullImage = pImageBits != m_pScreenImageBits || width != m_ScreenImageWidth || height != m_ScreenImageHeight;
+    m_okScreenNative = true;
+    m_ScreenTasAddr = tasaddr;
+    m_pScreenImageBits = pImageBits;
+    m_ScreenImageWidth = width;
+    m_ScreenImageHeight = height;
+
+    Emulator_RunScreenBands(Emulator_PrepareScreenBand, frame, NEON_SCREEN_HEIGHT);
+    Emulator_RunScreenBands(Emulator_ScaleScreenBand, frame, height);
+
+    g_pBoard->ClearRAMDirty();
 }
 
 
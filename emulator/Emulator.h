@@ -7,7 +7,8 @@
 
 //////////////////////////////////////////////////////////////////////
 
-const int MAX_BREAKPOINTCOUNT = 16;
+const int MAX_BREAKPOINTCOUNT = 256;
+const int MAX_BREAKPOINTRANGECOUNT = 16;
 const int MAX_WATCHESCOUNT = 16;
 
 extern CMotherboard* g_pBoard;
@@ -31,8 +32,11 @@ bool Emulator_AddCPUBreakpoint(quint16 address);
 bool Emulator_RemoveCPUBreakpoint(quint16 address);
 void Emulator_SetTempCPUBreakpoint(quint16 address);
 const quint16* Emulator_GetCPUBreakpointList();
+bool Emulator_AddCPUBreakpointRange(quint16 start, quint16 end);
+bool Emulator_RemoveCPUBreakpointRange(quint16 address);  // Removes the range containing the address
+const quint16* Emulator_GetCPUBreakpointRangeList();  // Pairs start, end; ends with 177777 value
 bool Emulator_IsBreakpoint();
-bool Emulator_IsBreakpoint(quint16 address);
+bool Emulator_IsBreakpoint(quint16 address);  // Breakpoint or breakpoint range
 void Emulator_RemoveAllBreakpoints();
 
 const quint16* Emulator_GetWatchList();
@@ -41,6 +45,9 @@ bool Emulator_RemoveWatch(uint16_t address);
 void Emulator_RemoveAllWatches();
 
 void Emulator_SetSound(bool enable);
+void Emulator_SetBlockMode(bool enable);
+void Emulator_SetNativeFIS(bool enable);
+void Emulator_SetEmulHLE(bool enable);
 
 void Emulator_Start();
 void Emulator_Stop();
@@ -52,6 +59,10 @@ void Emulator_UpdateKeyboardMatrix(const quint8 matrix[8]);
 
 void Emulator_GetScreenSize(int scrmode, int* pwid, int* phei);
 void Emulator_PrepareScreenRGB32(void* pImageBits, int screenMode);
+void Emulator_PrepareScreenRGB32(void* pImageBits, int width, int height);  // Any image size, the screen is scaled
+void Emulator_InvalidateScreen();  // The next Emulator_PrepareScreenRGB32() renders all the lines
+void Emulator_SetScreenBandCount(int count);  // Render threads count, 0 = by the number of CPU cores
+int Emulator_GetScreenBandCount();
 
 // Update cached values after Run or Step
 void Emulator_OnUpdate();
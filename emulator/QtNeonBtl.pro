@@ -5,6 +5,7 @@ TARGET = QtNeonBtl
 TEMPLATE = app
 SOURCES += main.cpp \
     emubase/pit8253.cpp \
+    emubase/SoundBlep.cpp \
     mainwindow.cpp \
     Common.cpp \
     emubase/Processor.cpp \
@@ -22,6 +23,7 @@ SOURCES += main.cpp \
     qmemoryview.cpp \
     qsoundout.cpp \
     UnitTests.cpp \
+    VideoKernels.cpp \
     qdialogs.cpp
 HEADERS += mainwindow.h \
     stdafx.h \
@@ -40,6 +42,7 @@ HEADERS += mainwindow.h \
     qmemoryview.h \
     qsoundout.h \
     UnitTests.h \
+    VideoKernels.h \
     qdialogs.h
 FORMS += mainwindow.ui
 RESOURCES += QtNeonBtl.qrc
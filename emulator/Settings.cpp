@@ -66,6 +66,36 @@ bool Settings_GetSound()
     return value.toBool();
 }
 
+void Settings_SetBlockMode(bool flag)
+{
+    Global_getSettings()->setValue("BlockMode", flag);
+}
+bool Settings_GetBlockMode()
+{
+    QVariant value = Global_getSettings()->value("BlockMode", false);
+    return value.toBool();
+}
+
+void Settings_SetNativeFIS(bool flag)
+{
+    Global_getSettings()->setValue("NativeFIS", flag);
+}
+bool Settings_GetNativeFIS()
+{
+    QVariant value = Global_getSettings()->value("NativeFIS", false);
+    return value.toBool();
+}
+
+void Settings_SetEmulHLE(bool flag)
+{
+    Global_getSettings()->setValue("EmulHLE", flag);
+}
+bool Settings_GetEmulHLE()
+{
+    QVariant value = Global_getSettings()->value("EmulHLE", false);
+    return value.toBool();
+}
+
 void Settings_SetDebugMemoryMode(quint16 mode)
 {
     Global_getSettings()->setValue("DebugMemoryMode", mode);
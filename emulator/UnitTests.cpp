@@ -3,11 +3,18 @@
 #if !defined(QT_NO_DEBUG)
 
 #include "UnitTests.h"
+#include "emubase/Emubase.h"
+#include "Emulator.h"
+#include "VideoKernels.h"
+#include <QFile>
+#include <vector>
 
 void UnitTests_ExecuteAll()
 {
     TestCommon testCommon;
     QTest::qExec(&testCommon);
+    TestEmulator testEmulator;
+    QTest::qExec(&testEmulator);
 }
 
 void TestCommon::testParseOctalValue()
@@ -58,4 +65,906 @@ void TestCommon::testPrintBinaryValue()
     QCOMPARE((const char*)buffer, "1010011100101110");
 }
 
+// Board of 512 KB configuration with the ROM loaded, after reset and the given number of frames
+static void CreateTestBoard(CMotherboard* pBoard, int frames)
+{
+    QFile romFile(":/pk11.rom");
+    QVERIFY(romFile.open(QIODevice::ReadOnly));
+    QByteArray rom = romFile.readAll();
+    romFile.close();
+    QCOMPARE(rom.size(), 16384);
+
+    pBoard->SetConfiguration(512);
+    pBoard->LoadROM(reinterpret_cast<const uint8_t*>(rom.constData()));
+    pBoard->Reset();
+    for (int frame = 0; frame < frames; frame++)
+        pBoard->SystemFrame();
+}
+
+// Next word of the linear congruential generator sequence
+static uint16_t GetRandomWord(uint32_t* pSeed)
+{
+    *pSeed = *pSeed * 1103515245 + 12345;
+    return (uint16_t)(*pSeed >> 16);
+}
+
+// Board of 512 KB configuration for the renderer tests: g_pBoard points to it and the video kernel level
+// may be changed while the object lives; both are restored on any return, failed QVERIFY/QCOMPARE too
+class TestVideoBoard
+{
+public:
+    TestVideoBoard() : m_pBoardSaved(g_pBoard), m_nLevelSaved(VideoKernels_GetLevel())
+    {
+        m_board.SetConfiguration(512);
+        g_pBoard = &m_board;
+    }
+    ~TestVideoBoard()
+    {
+        Emulator_InvalidateScreen();  // The renderer keeps the image pointer of the test
+        VideoKernels_SetLevel(m_nLevelSaved);
+        g_pBoard = m_pBoardSaved;
+    }
+
+    CMotherboard* GetBoard() { return &m_board; }
+
+    // Random line table, segments and data over the whole RAM
+    void FillRandom(uint32_t seed)
+    {
+        for (uint32_t offset = 0; offset < 512 * 1024; offset += 2)
+        {
+            uint16_t word = GetRandomWord(&seed);
+            if (offset & 2)
+                word &= 0177761;  // Keep the addresses in 512K
+            m_board.SetRAMWord(offset, word);
+        }
+    }
+
+private:
+    CMotherboard m_board;
+    CMotherboard* m_pBoardSaved;
+    int m_nLevelSaved;
+};
+
+void TestEmulator::benchmarkRomBoot_data()
+{
+    QTest::addColumn<bool>("blockMode");
+    QTest::newRow("interpreter") << false;
+    QTest::newRow("blocks") << true;
+}
+
+// Fixed workload: 100 frames of ROM boot from reset, 512 KB configuration
+void TestEmulator::benchmarkRomBoot()
+{
+    QFETCH(bool, blockMode);
+
+    CMotherboard board;
+    CreateTestBoard(&board, 0);
+    board.GetCPU()->SetBlockMode(blockMode);
+
+    QBENCHMARK
+    {
+        board.Reset();
+        for (int frame = 0; frame < 100; frame++)
+            board.SystemFrame();
+    }
+}
+
+// Random code run by translated blocks against the interpreter: same CPU state at every block boundary, same RAM;
+// the blocks stay valid over the code changes made while the block mode is off
+void TestEmulator::testBlockLockstep()
+{
+    const uint16_t twoOps[] = { 010000, 020000, 030000, 040000, 050000, 060000, 0160000, 0110000, 0120000, 0130000, 0140000, 0150000 };
+    const uint16_t operands[] = { 000, 001, 002, 003, 014, 024, 015, 025 };  // R0..R3, (R4), (R4)+, (R5), (R5)+
+    const uint16_t branches[] =
+    {
+        001000, 001400, 002000, 002400, 003000, 003400, 0100000,
+        0100400, 0101000, 0101400, 0102000, 0102400, 0103000, 0103400
+    };
+    for (uint32_t test = 1; test <= 8; test++)
+    {
+        CMotherboard boardBlocks, boardInterp;
+        CreateTestBoard(&boardBlocks, 60);
+        CreateTestBoard(&boardInterp, 60);
+        CProcessor* pBlocks = boardBlocks.GetCPU();
+        CProcessor* pInterp = boardInterp.GetCPU();
+        pInterp->SetBlockMode(false);
+        uint32_t seed = test * 7919;
+        for (uint16_t address = 0; address < 020000; address += 2)  // After the boot every USER mode window maps here
+        {
+            uint16_t random = GetRandomWord(&seed);
+            uint16_t word;
+            switch (random % 8)
+            {
+            case 0: case 1: case 2:  // MOV, CMP, BIT, BIC, BIS, ADD, SUB and byte forms
+                word = (uint16_t)(twoOps[(random >> 3) % 12] | (operands[(random >> 7) & 7] << 6) | operands[(random >> 10) & 7]);
+                break;
+            case 3: case 4: case 6:  // CLR, COM, INC, DEC, NEG, ADC, SBC, TST, ROR, ROL, ASR, ASL and byte forms
+                word = (uint16_t)((random & 0100000) | (005000 + ((random >> 3) % 12) * 0100) | operands[(random >> 7) & 7]);
+                break;
+            case 5:  // Conditional branch forward
+                word = (uint16_t)(branches[(random >> 3) % 14] | ((random >> 7) & 7));
+                break;
+            default:  // SOB R0..R3, for the loops
+                word = (uint16_t)(077000 | (((random >> 3) & 3) << 6) | (((random >> 5) & 7) + 1));
+                break;
+            }
+            boardBlocks.SetWord(address, false, word);
+            boardInterp.SetWord(address, false, word);
+        }
+
+        int boundaries = 0, boundariesInterp = 0, restartTick = 0;
+        for (int tick = 0; tick < 100000; tick++)
+        {
+            if (pInterp->GetInternalTick() == 0)
+                boundariesInterp++;
+            if (pBlocks->GetInternalTick() == 0)  // Block end is an instruction boundary for the interpreter too
+            {
+                boundaries++;
+                QCOMPARE(pInterp->GetInternalTick(), 0);
+                for (int regno = 0; regno < 8; regno++)
+                    QCOMPARE(pBlocks->GetReg(regno), pInterp->GetReg(regno));
+                QCOMPARE(pBlocks->GetPSW(), pInterp->GetPSW());
+                QCOMPARE(pBlocks->GetCPSW(), pInterp->GetCPSW());
+
+                pBlocks->SetBlockMode(tick % 200 >= 50);  // Off now and then, as for debugger steps
+                if (tick >= restartTick || pBlocks->IsHaltMode())  // Random code traps and hangs sooner or later
+                {
+                    uint16_t pc = (uint16_t)(001000 + (GetRandomWord(&seed) & 016776));
+                    uint16_t sp = (uint16_t)(001000 + (GetRandomWord(&seed) & 016776));
+                    uint16_t pointer = (uint16_t)(pc + (GetRandomWord(&seed) & 076));  // R4 and R5 write to the code
+                    uint16_t psw = GetRandomWord(&seed) & 0357;  // USER mode without T-bit
+                    CProcessor* cpus[2] = { pBlocks, pInterp };
+                    for (CProcessor* pCPU : cpus)
+                    {
+                        pCPU->SetHALTPin(false);  // Emulated register access, the devices do not run here
+                        pCPU->SetReg(4, pointer);
+                        pCPU->SetReg(5, (uint16_t)(pointer + 0100));
+                        pCPU->SetPC(pc);
+                        pCPU->SetSP(sp);
+                        pCPU->SetPSW(psw);
+                    }
+                    restartTick = tick + 1000;
+                }
+            }
+            pBlocks->Execute();
+            pInterp->Execute();
+        }
+        QVERIFY(boundaries < boundariesInterp);  // Some instructions were run in blocks
+        while (pBlocks->GetInternalTick() != 0)  // To the end of the current block
+        {
+            pBlocks->Execute();
+            pInterp->Execute();
+        }
+        QCOMPARE(pInterp->GetInternalTick(), 0);
+        for (uint32_t offset = 0; offset < 512 * 1024; offset += 2)
+            QCOMPARE(boardBlocks.GetRAMWord(offset), boardInterp.GetRAMWord(offset));
+    }
+}
+
+// Reference result and NZVC of the instruction on R0 (source) and R1 (destination), by the PDP-11 definitions;
+// returns the new R1 value
+static uint16_t GetReferenceResult(uint16_t instruction, uint16_t src, uint16_t dst, uint16_t* pPSW)
+{
+    const bool okByte = (instruction & 0100000) != 0 && (instruction & 0170000) != 0160000;
+    const uint16_t opcode = okByte ? (uint16_t)(instruction & 077777) : instruction;
+    const uint32_t mask = okByte ? 0377 : 0177777;
+    const uint32_t sign = okByte ? 0200 : 0100000;
+    const uint32_t a = src & mask, b = dst & mask;
+    bool c = (*pPSW & PSW_C) != 0;
+    bool v = false, okStore = true, okShift = false;
+    uint32_t res;
+    switch ((opcode & 0170000) ? (opcode & 0170000) : (opcode & 0177700))
+    {
+    case 010000: res = a; break;  // MOV
+    case 020000: res = a - b;  v = ((a ^ b) & (a ^ res) & sign) != 0;  c = a < b;  okStore = false;  break;  // CMP
+    case 030000: res = a & b;  okStore = false;  break;  // BIT
+    case 040000: res = ~a & b;  break;  // BIC
+    case 050000: res = a | b;  break;  // BIS
+    case 060000: res = a + b;  v = (~(a ^ b) & (a ^ res) & sign) != 0;  c = res > mask;  break;  // ADD
+    case 0160000: res = b - a;  v = ((a ^ b) & (b ^ res) & sign) != 0;  c = b < a;  break;  // SUB
+    case 005000: res = 0;  c = false;  break;  // CLR
+    case 005100: res = ~b;  c = true;  break;  // COM
+    case 005200: res = b + 1;  v = b == sign - 1;  break;  // INC
+    case 005300: res = b - 1;  v = b == sign;  break;  // DEC
+    case 005400: res = 0 - b;  v = b == sign;  c = b != 0;  break;  // NEG
+    case 005500: res = b + c;  v = c && b == sign - 1;  c = c && b == mask;  break;  // ADC
+    case 005600: res = b - c;  v = c && b == sign;  c = c && b == 0;  break;  // SBC
+    case 005700: res = b;  c = false;  okStore = false;  break;  // TST
+    case 006000: res = (b >> 1) | (c ? sign : 0);  c = (b & 1) != 0;  okShift = true;  break;  // ROR
+    case 006100: res = (b << 1) | (c ? 1 : 0);  c = (b & sign) != 0;  okShift = true;  break;  // ROL
+    case 006200: res = (b >> 1) | (b & sign);  c = (b & 1) != 0;  okShift = true;  break;  // ASR
+    default:     res = b << 1;  c = (b & sign) != 0;  okShift = true;  break;  // ASL
+    }
+    res &= mask;
+    const bool n = (res & sign) != 0;
+    if (okShift)
+        v = n != c;
+    *pPSW = (uint16_t)((*pPSW & ~(PSW_N | PSW_Z | PSW_V | PSW_C)) |
+            (n ? PSW_N : 0) | (res == 0 ? PSW_Z : 0) | (v ? PSW_V : 0) | (c ? PSW_C : 0));
+    if (!okStore)
+        return dst;
+    if (!okByte)
+        return (uint16_t)res;
+    if (opcode == 010001)  // MOVB to register extends the sign
+        return (uint16_t)(n ? res | 0177400 : res);
+    return (uint16_t)((dst & 0177400) | res);
+}
+
+// Condition codes of the flag-setting instructions, lazy and eager, against the reference: each instruction alone
+// and followed by another one, as the pending operation keeps C for INC, DEC and the logic instructions
+void TestEmulator::testLazyFlags()
+{
+    const uint16_t instructions[] =
+    {
+        0010001, 0020001, 0030001, 0040001, 0050001, 0060001, 0160001,  // MOV .. SUB R0,R1
+        0110001, 0120001, 0130001, 0140001, 0150001,                    // MOVB .. BISB R0,R1
+        0005001, 0005101, 0005201, 0005301, 0005401, 0005501, 0005601, 0005701,  // CLR .. TST R1
+        0006001, 0006101, 0006201, 0006301,                             // ROR .. ASL R1
+        0105001, 0105101, 0105201, 0105301, 0105401, 0105501, 0105601, 0105701,  // CLRB .. TSTB R1
+        0106001, 0106101, 0106201, 0106301,                             // RORB .. ASLB R1
+    };
+    const int count = sizeof(instructions) / sizeof(instructions[0]);
+    const uint16_t edgecases[] = { 0, 1, 0177, 0200, 0377, 077777, 0100000, 0177777 };
+
+    CMotherboard board;
+    CreateTestBoard(&board, 10);  // The ROM sets up the USER mode windows
+    CProcessor* pCPU = board.GetCPU();
+    uint32_t seed = 8642;
+    for (int test = 0; test < 20000; test++)
+    {
+        uint16_t instruction1 = instructions[GetRandomWord(&seed) % count];
+        uint16_t instruction2 = instructions[GetRandomWord(&seed) % count];
+        uint16_t src = GetRandomWord(&seed), dst = GetRandomWord(&seed);
+        if (test & 1)
+            src = edgecases[src % 8];
+        if (test & 2)
+            dst = edgecases[dst % 8];
+        uint16_t psw = (uint16_t)(0340 | (GetRandomWord(&seed) & 017));  // Priority 7, random NZVC
+
+        uint16_t expectedPSW1 = psw;
+        uint16_t expected1 = GetReferenceResult(instruction1, src, dst, &expectedPSW1);
+        uint16_t expectedPSW2 = expectedPSW1;
+        uint16_t expected2 = GetReferenceResult(instruction2, src, expected1, &expectedPSW2);
+
+        pCPU->SetLazyFlags((test & 4) == 0);
+        board.SetRAMWord(001000, instruction1);
+        board.SetRAMWord(001002, instruction2);
+        pCPU->SetReg(0, src);
+        pCPU->SetReg(1, dst);
+        pCPU->SetPSW(psw);
+        pCPU->SetPC(001000);
+        pCPU->ClearInternalTick();
+        pCPU->Execute();
+        QCOMPARE(pCPU->GetPC(), (uint16_t)001002);
+        QCOMPARE(pCPU->GetReg(1), expected1);
+        QCOMPARE(pCPU->GetPSW(), expectedPSW1);
+        pCPU->ClearInternalTick();
+        pCPU->Execute();
+        QCOMPARE(pCPU->GetReg(1), expected2);
+        QCOMPARE(pCPU->GetPSW(), expectedPSW2);
+        QCOMPARE(pCPU->GetReg(0), src);
+    }
+}
+
+// Word and byte read-modify-write over the whole USER mode RAM area, 1 MB configuration
+void TestEmulator::benchmarkMemoryAccess()
+{
+    CMotherboard board;
+    board.SetConfiguration(1024);
+
+    QBENCHMARK
+    {
+        for (uint16_t address = 0; address < 0160000; address += 2)
+            board.SetWord(address, false, board.GetWord(address, false) + 1);
+        for (uint16_t address = 0; address < 0160000; address++)
+            board.SetByte(address, false, board.GetByte(address, false) ^ 0125);
+    }
+
+    QCOMPARE(board.GetWord(0, false), board.GetWord(0157776, false));
+}
+
+// Run FADD/FSUB/FMUL/FDIV R1 at 001000 on the operand block at 002000, return when back at 001002
+static void RunFISInstruction(CMotherboard* pBoard, int op, const uint16_t operands[4], uint16_t result[7])
+{
+    CProcessor* pCPU = pBoard->GetCPU();
+    pBoard->SetWord(001000, false, (uint16_t)(075001 | (op << 3)));
+    pBoard->SetWord(001002, false, 000777);  // BR .
+    for (int i = 0; i < 4; i++)
+        pBoard->SetWord((uint16_t)(002000 + i * 2), false, operands[i]);
+    pCPU->SetReg(1, 002000);
+    pCPU->SetSP(000700);
+    pCPU->SetPSW(000017);
+    pCPU->SetPC(001000);
+    pCPU->ClearInternalTick();
+    for (int tick = 0; tick < 100000; tick++)
+    {
+        pCPU->Execute();
+        if (tick > 0 && pCPU->GetInternalTick() == 0 && !pCPU->IsHaltMode() && pCPU->GetPC() == 001002)
+            break;
+    }
+    for (int i = 0; i < 4; i++)
+        result[i] = pBoard->GetWord((uint16_t)(002000 + i * 2), false);
+    result[4] = pCPU->GetReg(1);
+    result[5] = pCPU->GetPSW();
+    result[6] = pCPU->GetPC();
+}
+
+// Native FIS against the ROM routine: same results, including zero on overflow and underflow
+void TestEmulator::testNativeFIS()
+{
+    CMotherboard board;
+    CreateTestBoard(&board, 100);
+
+    // B hi, B lo, A hi, A lo
+    const uint16_t edgecases[][4] =
+    {
+        { 040400, 0, 040200, 0 },               // 2.0, 1.0
+        { 040200, 0, 0140200, 0 },              // Different signs
+        { 040200, 0, 040200, 0 },               // Equal: zero on FSUB
+        { 0, 0, 040200, 0 },                    // Division by zero
+        { 000123, 045670, 040200, 0 },          // Dirty zero
+        { 077777, 0177777, 077777, 0177777 },   // Overflow
+        { 000200, 0, 000200, 0 },               // Underflow
+        { 050000, 0, 030000, 0 },               // Large exponent difference
+    };
+    uint32_t seed = 12345;
+    for (int test = 0; test < 4000; test++)
+    {
+        uint16_t operands[4];
+        for (int i = 0; i < 4; i++)
+            operands[i] = GetRandomWord(&seed);
+        if (test < 8 * 4)
+            ::memcpy(operands, edgecases[test / 4], sizeof(operands));
+        else if (test & 8)  // Close exponents
+            operands[0] = (uint16_t)((operands[2] & 0177600) | (operands[0] & 0100177));
+        int op = test & 3;
+
+        uint16_t resultROM[7], resultNative[7];
+        board.GetCPU()->SetNativeFIS(false);
+        RunFISInstruction(&board, op, operands, resultROM);
+        board.GetCPU()->SetNativeFIS(true);
+        RunFISInstruction(&board, op, operands, resultNative);
+        QCOMPARE(resultROM[6], (uint16_t)001002);
+        for (int i = 0; i < 7; i++)
+            QCOMPARE(resultNative[i], resultROM[i]);
+    }
+}
+
+// Reads of the emulated registers without the HALT mode round trip, by the OS descriptor table
+void TestEmulator::testEmulHLE()
+{
+    CMotherboard board;
+    board.SetConfiguration(512);
+    board.SetEmulHLE(true);
+    const CProcessor* pCPU = board.GetCPU();
+
+    // HR6 = 0: the descriptor table for 0177560.. is at RAM 017560.., the registers are at RAM 007560..
+    board.SetRAMWord(017564, 000001);  // 0177564: no processing on read
+    board.SetRAMWord(017566, 000001);
+    board.SetRAMWord(017562, 0100010);  // 0177562: the OS driver processes the read
+    board.SetRAMWord(007564, 000200);
+    board.SetRAMWord(007562, 000101);
+
+    QCOMPARE(board.GetWord(0177564, false), (uint16_t)000200);
+    QCOMPARE(board.GetByte(0177564, false), (uint8_t)0200);
+    QVERIFY(!pCPU->GetHALTPin());
+
+    // Read-modify-write: the write is latched as usual
+    board.SetWord(0177566, false, (uint16_t)(board.GetWord(0177566, false) | 1), true);
+    QVERIFY(pCPU->GetHALTPin());
+    QCOMPARE(board.GetPortView(0161200), (uint16_t)0177566);
+
+    // Without HLE, and with the HALT mode processing pending, every read goes to the ROM
+    CMotherboard boardROM;
+    boardROM.SetConfiguration(512);
+    boardROM.SetRAMWord(017564, 000001);
+    boardROM.SetRAMWord(007564, 000200);
+    QCOMPARE(boardROM.GetWord(0177564, false), (uint16_t)000200);
+    QVERIFY(boardROM.GetCPU()->GetHALTPin());
+    QCOMPARE(boardROM.GetPortView(0161200), (uint16_t)0177564);
+    boardROM.SetEmulHLE(true);
+    boardROM.GetWord(0177564, false);
+    QCOMPARE(boardROM.GetPortView(0161202), (uint16_t)0177564);
+
+    CMotherboard boardDriver;
+    boardDriver.SetConfiguration(512);
+    boardDriver.SetEmulHLE(true);
+    boardDriver.SetRAMWord(017562, 0100010);
+    boardDriver.SetRAMWord(007562, 000101);
+    QCOMPARE(boardDriver.GetWord(0177562, false), (uint16_t)000101);
+    QVERIFY(boardDriver.GetCPU()->GetHALTPin());
+    QCOMPARE(boardDriver.GetPortView(0161200), (uint16_t)0177562);
+}
+
+// Reads of the emulated registers with HLE against the ROM HALT mode handler, on the booted board:
+// same registers, PSW and USER mode memory, and the HLE run is shorter
+void TestEmulator::testEmulHLEvsROM()
+{
+    // Register addresses; HALT mode descriptor for each: positive means no processing on read, zero means trap to 4
+    const uint16_t registers[] = { 0177560, 0177564, 0177566, 0176500, 0176504, 0177514, 0174000, 0175002 };
+    const uint16_t program[] =
+    {
+        0013700, 0177564,  // MOV @#177564,R0
+        0113701, 0177560,  // MOVB @#177560,R1
+        0063700, 0176500,  // ADD @#176500,R0
+        0023701, 0177566,  // CMP @#177566,R1
+        0005737, 0176504,  // TST @#176504
+        0033702, 0177514,  // BIT @#177514,R2
+        0113703, 0174000,  // MOVB @#174000,R3
+        0013704, 0175002,  // MOV @#175002,R4
+        0000777,           // BR .
+    };
+    const uint16_t endAddress = (uint16_t)(001000 + sizeof(program) - 2);
+
+    CMotherboard boardHLE, boardROM;
+    CreateTestBoard(&boardHLE, 100);
+    CreateTestBoard(&boardROM, 100);
+    boardHLE.SetEmulHLE(true);
+    uint32_t seed = 97531;
+    for (int test = 0; test < 16; test++)
+    {
+        CMotherboard* boards[2] = { &boardHLE, &boardROM };
+        uint32_t seedBoard = seed;
+        for (CMotherboard* pBoard : boards)
+        {
+            CProcessor* pCPU = pBoard->GetCPU();
+            seed = seedBoard;
+            for (uint16_t address : registers)
+            {
+                uint16_t descriptor = GetRandomWord(&seed) & 077777;
+                if (test & 1 && address == 0176504)
+                    descriptor = 0;
+                pBoard->SetWord((uint16_t)(0160000 + address), true, descriptor);
+                pBoard->SetRAMWord(address & 07776, GetRandomWord(&seed));
+            }
+            for (uint16_t i = 0; i < sizeof(program) / 2; i++)
+                pBoard->SetWord((uint16_t)(001000 + i * 2), false, program[i]);
+            // The ROM handler saves the registers to the current process area and returns to it when
+            // the area at HALT mode 100016 matches the one at 100022; there is no OS process after the boot
+            pBoard->SetWord(0100016, true, 0100220);
+            pBoard->SetWord(0100022, true, 0100200);
+            pBoard->SetWord(000004, false, 002000);  // Trap to 4: INC R5, RTI
+            pBoard->SetWord(000006, false, 000340);
+            pBoard->SetWord(002000, false, 005205);
+            pBoard->SetWord(002002, false, 000002);
+            for (int regno = 0; regno < 6; regno++)
+                pCPU->SetReg(regno, 0);
+            pCPU->SetSP(000700);
+            pCPU->SetPSW(000340);
+            pCPU->SetPC(001000);
+            pCPU->ClearInternalTick();
+            pBoard->ClearCPUBreakpoints();
+            pBoard->SetCPUBreakpoint(endAddress);
+            if (pBoard == &boardHLE && (test & 1) == 0)
+                pBoard->SetCPUBreakpoint(001550);  // The ROM handler of the HALT signal should not be entered
+            for (int frame = 0; frame < 10; frame++)
+            {
+                if (!pBoard->SystemFrame() && (pCPU->GetPC() == 001550 || !pCPU->IsHaltMode()))
+                    break;
+            }
+        }
+        const CProcessor* pHLE = boardHLE.GetCPU();
+        const CProcessor* pROM = boardROM.GetCPU();
+        QCOMPARE(pHLE->GetPC(), endAddress);
+        QCOMPARE(pROM->GetPC(), endAddress);
+        QVERIFY(!pHLE->IsHaltMode() && !pROM->IsHaltMode());
+        for (int regno = 0; regno < 8; regno++)
+            QCOMPARE(pHLE->GetReg(regno), pROM->GetReg(regno));
+        QCOMPARE(pHLE->GetPSW(), pROM->GetPSW());
+        for (uint16_t address = 0; address < 0160000; address += 2)
+            QCOMPARE(boardHLE.GetWord(address, false), boardROM.GetWord(address, false));
+    }
+}
+
+// Run the loop of one instruction and SOB R0 at 001000 till the fall through, return the CPU state and the ticks spent
+static int RunSOBLoop(CMotherboard* pBoard, uint16_t instruction, uint16_t count, uint16_t result[5])
+{
+    CProcessor* pCPU = pBoard->GetCPU();
+    pBoard->SetWord(001000, false, instruction);
+    pBoard->SetWord(001002, false, 077002);  // SOB R0, 001000
+    pBoard->SetWord(001004, false, 000777);  // BR .
+    pCPU->SetReg(0, count);
+    pCPU->SetReg(1, (instruction & 0100000) ? 002001 : 002000);
+    pCPU->SetReg(2, 010000);
+    pCPU->SetPSW(000340);
+    pCPU->SetPC(001000);
+    pCPU->ClearInternalTick();
+    int ticks = 0;
+    while (ticks < 1000000)
+    {
+        pCPU->Execute();
+        ticks++;
+        if (pCPU->GetInternalTick() == 0 && pCPU->GetPC() == 001004)
+            break;
+    }
+    result[0] = pCPU->GetReg(0);
+    result[1] = pCPU->GetReg(1);
+    result[2] = pCPU->GetReg(2);
+    result[3] = pCPU->GetPSW();
+    result[4] = pCPU->GetPC();
+    return ticks;
+}
+
+// Copy and fill loops done at once in block mode against the interpreter: same registers, flags, memory and ticks
+void TestEmulator::testSOBIdiom()
+{
+    CMotherboard boardBlocks, boardInterp;
+    CreateTestBoard(&boardBlocks, 100);
+    CreateTestBoard(&boardInterp, 100);
+    boardBlocks.GetCPU()->SetBlockMode(true);
+    boardInterp.GetCPU()->SetBlockMode(false);
+    // After the boot every USER mode window maps to RAM 000000..017777: the blocks stay below 020000
+
+    const uint16_t instructions[] =
+    {
+        0105021,  // CLRB (R1)+
+        0112122,  // MOVB (R1)+,(R2)+
+        0012122,  // MOV (R1)+,(R2)+
+        0005022,  // CLR (R2)+
+    };
+    const uint16_t counts[] = { 1, 2, 300, 1000 };
+    for (uint16_t instruction : instructions)
+    {
+        for (uint16_t count : counts)
+        {
+            uint32_t seed = count * 7u + instruction;
+            for (uint16_t address = 002000; address < 020000; address += 2)
+            {
+                uint16_t value = GetRandomWord(&seed);
+                boardBlocks.SetWord(address, false, value);
+                boardInterp.SetWord(address, false, value);
+            }
+            uint16_t resultBlocks[5], resultInterp[5];
+            int ticksBlocks = RunSOBLoop(&boardBlocks, instruction, count, resultBlocks);
+            int ticksInterp = RunSOBLoop(&boardInterp, instruction, count, resultInterp);
+            QCOMPARE(resultInterp[4], (uint16_t)001004);
+            QCOMPARE(ticksBlocks, ticksInterp);
+            for (int i = 0; i < 5; i++)
+                QCOMPARE(resultBlocks[i], resultInterp[i]);
+            for (uint16_t address = 002000; address < 020000; address += 2)
+                QCOMPARE(boardBlocks.GetWord(address, false), boardInterp.GetWord(address, false));
+        }
+    }
+}
+
+// PIT ticks in closed form against one by one: same output and counter, output change when predicted
+void TestEmulator::testPITAdvance()
+{
+    uint32_t seed = 4321;
+    for (int test = 0; test < 3000; test++)
+    {
+        uint8_t mode = (uint8_t)(GetRandomWord(&seed) % 4);
+        uint8_t channel = (uint8_t)(GetRandomWord(&seed) % 3);
+        bool gate = (test & 7) != 0;
+        uint16_t count = (uint16_t)(GetRandomWord(&seed) % ((test & 1) ? 16 : 3000));
+        uint32_t ticks = GetRandomWord(&seed) % ((test & 2) ? 20 : 10000);
+
+        PIT8253 pitTick, pitAdvance;
+        PIT8253* pits[2] = { &pitTick, &pitAdvance };
+        for (PIT8253* pPit : pits)
+        {
+            pPit->Write(3, (uint8_t)((channel << 6) | 060 | (mode << 1)));  // lo byte then hi byte
+            pPit->Write(channel, (uint8_t)(count & 0xff));
+            pPit->Write(channel, (uint8_t)(count >> 8));
+            for (int i = 0; i < test % 5; i++)
+                pPit->Tick();
+        }
+
+        bool output = pitTick.GetOutput(channel);
+        uint32_t change = pitAdvance.GetOutputChangeTicks(channel, gate);
+        uint32_t changeTick = PIT_NEVER;
+        for (uint32_t tick = 1; tick <= ticks; tick++)
+        {
+            pitTick.SetGate(channel, gate);
+            pitTick.Tick();
+            if (changeTick == PIT_NEVER && pitTick.GetOutput(channel) != output)
+                changeTick = tick;
+        }
+        pitAdvance.Advance(channel, gate, ticks);
+
+        if (change <= ticks)
+            QCOMPARE(changeTick, change);
+        else
+            QCOMPARE(changeTick, PIT_NEVER);
+        QCOMPARE(pitAdvance.GetOutput(channel), pitTick.GetOutput(channel));
+        QCOMPARE(pitAdvance.Read(channel), pitTick.Read(channel));
+        QCOMPARE(pitAdvance.Read(channel), pitTick.Read(channel));
+    }
+}
+
+// Band-limited step: silence before the step, exact level after the step length, frame sample count by the rate
+void TestEmulator::testSoundBlep()
+{
+    static SoundBlep blep;  // Too big for the stack
+    const int rates[] = { 22050, 44100, 48000 };
+    for (int rate : rates)
+    {
+        blep.SetSampleRate(rate);
+        QCOMPARE(blep.GetSampleRate(), rate);
+        for (uint32_t time = 0; time < SOUNDBLEP_FRAMETICKS; time += 7919)
+        {
+            blep.Clear();
+            blep.AddDelta(time, 10752);
+            int count = blep.EndFrame(SOUNDBLEP_FRAMETICKS);
+            QCOMPARE(count, rate / 25);
+
+            const uint16_t* samples = blep.GetSamples();
+            int pos = (int)((uint64_t)time * (rate / 25) / SOUNDBLEP_FRAMETICKS);
+            for (int i = 0; i < pos && i < count; i++)
+                QCOMPARE(samples[i], (uint16_t)0);
+            for (int i = pos + SOUNDBLEP_WIDTH; i < count; i++)
+                QCOMPARE(samples[i], (uint16_t)10752);
+
+            count = blep.EndFrame(SOUNDBLEP_FRAMETICKS);  // The step tail goes to the next frame
+            QCOMPARE(count, rate / 25);
+            QCOMPARE(samples[count - 1], (uint16_t)10752);
+        }
+    }
+}
+
+// Scaler taps of the fixed screen modes keep the former x0.5, x0.75, x1.25 and x1.5 blends;
+// SSE2/AVX2 row kernels against the scalar ones for arbitrary sizes
+void TestEmulator::testVideoScaler()
+{
+    struct { int destSize; int period; uint16_t index[5]; uint8_t weight[5]; } modes[] =
+    {
+        {  416, 1, { 0 },             { 2 } },              // Average of two pixels
+        {  624, 3, { 0, 1, 2 },       { 1, 2, 3 } },        // 4 pixels into 3
+        {  832, 1, { 0 },             { 0 } },
+        { 1040, 5, { 0, 0, 1, 2, 3 }, { 0, 3, 2, 1, 0 } },  // 4 pixels into 5
+        { 1248, 3, { 0, 0, 1 },       { 0, 2, 0 } },        // 2 pixels into 3
+    };
+    for (auto& mode : modes)
+    {
+        std::vector<uint16_t> index(mode.destSize);
+        std::vector<uint8_t> weight(mode.destSize);
+        VideoKernels_GetScaleTaps(832, mode.destSize, index.data(), weight.data());
+        const int step = 832 * mode.period / mode.destSize;
+        for (int x = 0; x < mode.destSize; x++)  // Full weight of B is the same as A of the next pair
+        {
+            QCOMPARE(index[x] + weight[x] / 4, x / mode.period * step + mode.index[x % mode.period]);
+            QCOMPARE(weight[x] % 4, (int)mode.weight[x % mode.period]);
+        }
+    }
+
+    uint32_t seed = 5678;
+    std::vector<uint32_t> src(832), other(832);
+    for (int i = 0; i < 832; i++)
+    {
+        src[i] = (uint32_t)GetRandomWord(&seed) << 8;
+        src[i] |= GetRandomWord(&seed) & 0xff;
+        other[i] = (uint32_t)GetRandomWord(&seed) << 8;
+        other[i] |= GetRandomWord(&seed) & 0xff;
+    }
+    TestVideoBoard videoBoard;  // Puts back the kernel level
+    const int maxLevel = VideoKernels_GetMaxLevel();
+    const int sizes[] = { 1, 7, 300, 415, 832, 1000, 1366, 1920 };
+    for (int destSize : sizes)
+    {
+        std::vector<uint16_t> index(destSize);
+        std::vector<uint8_t> weight(destSize);
+        VideoKernels_GetScaleTaps(832, destSize, index.data(), weight.data());
+        for (int x = 0; x < destSize; x++)
+        {
+            QVERIFY(index[x] + 1 < 832 && weight[x] <= 4);
+            QVERIFY(x == 0 || index[x] >= index[x - 1]);
+        }
+
+        std::vector<uint32_t> expected(destSize + 1, 0xdeadbeef);
+        VideoKernels_SetLevel(VIDEOKERNELS_SCALAR);
+        VideoKernels_GetScaleRowProc()(expected.data(), src.data(), 832, index.data(), weight.data(), destSize);
+        QCOMPARE(expected[destSize], (uint32_t)0xdeadbeef);
+        for (int level = VIDEOKERNELS_SCALAR + 1; level <= maxLevel; level++)
+        {
+            std::vector<uint32_t> actual(destSize + 1, 0xdeadbeef);
+            VideoKernels_SetLevel(level);
+            VideoKernels_GetScaleRowProc()(actual.data(), src.data(), 832, index.data(), weight.data(), destSize);
+            QVERIFY(actual == expected);
+        }
+    }
+    for (int count = 0; count <= 40; count++)
+    {
+        for (int rowWeight = 0; rowWeight <= 4; rowWeight++)
+        {
+            std::vector<uint32_t> expected(count + 1, 0xdeadbeef);
+            VideoKernels_SetLevel(VIDEOKERNELS_SCALAR);
+            VideoKernels_GetBlendRowsProc()(expected.data(), src.data(), other.data(), rowWeight, count);
+            QCOMPARE(expected[count], (uint32_t)0xdeadbeef);
+            for (int level = VIDEOKERNELS_SCALAR + 1; level <= maxLevel; level++)
+            {
+                std::vector<uint32_t> actual(count + 1, 0xdeadbeef);
+                VideoKernels_SetLevel(level);
+                VideoKernels_GetBlendRowsProc()(actual.data(), src.data(), other.data(), rowWeight, count);
+                QVERIFY(actual == expected);
+            }
+        }
+    }
+}
+
+// RAM writes mark their 256-byte pages dirty until ClearRAMDirty(), the spans are clamped to RAM
+void TestEmulator::testRAMDirty()
+{
+    CMotherboard board;
+    board.SetConfiguration(512);
+    QVERIFY(board.IsRAMDirty(0, 512 * 1024));  // Fresh RAM is dirty
+    board.ClearRAMDirty();
+    QVERIFY(!board.IsRAMDirty(0, 512 * 1024));
+
+    board.SetRAMWord(0012346, 0177777);
+    QVERIFY(board.IsRAMDirty(0012346, 2));
+    QVERIFY(board.IsRAMDirty(0012000, 01000));
+    QVERIFY(!board.IsRAMDirty(0011000, 0400));  // Other 256-byte pages
+    QVERIFY(!board.IsRAMDirty(0013000, 01000));
+    QVERIFY(!board.IsRAMDirty(4096 * 1024 - 2, 2));  // Out of RAM
+
+    board.ClearRAMDirty();
+    board.SetRAMByte(512 * 1024 - 1, 0377);
+    QVERIFY(board.IsRAMDirty(512 * 1024 - 4, 1024));  // The span is clamped to RAM
+    QVERIFY(!board.IsRAMDirty(0, 512 * 1024 - 256));
+}
+
+// SSE2/AVX2 pixel expansion against the scalar one, for every kernel and run length
+void TestEmulator::testVideoKernels()
+{
+    const int kinds[][2] = { {1, 1}, {1, 2}, {2, 1}, {2, 2}, {2, 4}, {4, 2}, {4, 4}, {4, 8}, {8, 4}, {8, 8}, {8, 16} };
+    uint32_t palette[256];
+    uint8_t data[64];
+    uint32_t seed = 1234;
+    for (int i = 0; i < 256; i++)
+    {
+        palette[i] = (uint32_t)GetRandomWord(&seed) << 16;
+        palette[i] |= GetRandomWord(&seed);
+    }
+    for (int i = 0; i < 64; i++)
+        data[i] = (uint8_t)GetRandomWord(&seed);
+
+    TestVideoBoard videoBoard;  // Puts back the kernel level
+    const int maxLevel = VideoKernels_GetMaxLevel();
+    for (const int* kind : kinds)
+    {
+        for (int bytes = 0; bytes <= 64; bytes++)
+        {
+            const int pixels = bytes * 8 / kind[0] * kind[1];
+            std::vector<uint32_t> expected(pixels + 1, 0xdeadbeef);
+            VideoKernels_SetLevel(VIDEOKERNELS_SCALAR);
+            VideoKernels_GetExpandProc(kind[0], kind[1])(expected.data(), data, bytes, palette);
+            QCOMPARE(expected[pixels], (uint32_t)0xdeadbeef);
+            for (int level = VIDEOKERNELS_SCALAR + 1; level <= maxLevel; level++)
+            {
+                std::vector<uint32_t> actual(pixels + 1, 0xdeadbeef);
+                VideoKernels_SetLevel(level);
+                VideoKernels_GetExpandProc(kind[0], kind[1])(actual.data(), data, bytes, palette);
+                QVERIFY(actual == expected);
+            }
+        }
+    }
+}
+
+// Multi-threaded rendering by bands gives the same image as the single thread, in every screen mode
+void TestEmulator::testScreenBands()
+{
+    TestVideoBoard videoBoard;
+    videoBoard.FillRandom(2468);
+    for (int mode = 0; mode < 5; mode++)
+    {
+        int width = 0, height = 0;
+        Emulator_GetScreenSize(mode, &width, &height);
+        std::vector<uint32_t> image1(width * height), image4(width * height);
+        Emulator_SetScreenBandCount(1);
+        Emulator_InvalidateScreen();
+        Emulator_PrepareScreenRGB32(image1.data(), mode);
+        Emulator_SetScreenBandCount(4);
+        QCOMPARE(Emulator_GetScreenBandCount(), 4);
+        Emulator_InvalidateScreen();
+        Emulator_PrepareScreenRGB32(image4.data(), mode);
+        QVERIFY(image1 == image4);
+    }
+    Emulator_SetScreenBandCount(0);
+}
+
+// Video address from the pair of words at the RAM offset, as VDPTAS/VDPTAP, line table entries and segments
+static uint32_t GetVideoAddress(const CMotherboard* pBoard, uint32_t offset)
+{
+    return (((uint32_t)pBoard->GetRAMWordView(offset)) << 2) | (((uint32_t)(pBoard->GetRAMWordView(offset + 2) & 0x000f)) << 18);
+}
+
+// Rendering only the lines with written RAM gives the same image as the full rendering, after writes
+// to the palette table, the line table, the segment descriptors and the segment data
+void TestEmulator::testScreenIncremental()
+{
+    TestVideoBoard videoBoard;
+    videoBoard.FillRandom(3579);
+    CMotherboard* pBoard = videoBoard.GetBoard();
+    uint32_t seed = 9753;
+    const int sizes[][2] = { { 832, 600 }, { 1000, 700 }, { 333, 299 } };
+    for (const int* size : sizes)
+    {
+        const int width = size[0], height = size[1];
+        std::vector<uint32_t> image(width * height), imageFull(width * height);
+        Emulator_InvalidateScreen();
+        Emulator_PrepareScreenRGB32(image.data(), width, height);
+        for (int test = 0; test < 64; test++)
+        {
+            uint32_t tasaddr = GetVideoAddress(pBoard, 0000010);
+            uint32_t tapaddr = GetVideoAddress(pBoard, 0000004);
+            uint32_t lineaddr = tasaddr + GetRandomWord(&seed) % 300 * 4;
+            uint32_t otraddr = GetVideoAddress(pBoard, lineaddr) + GetRandomWord(&seed) % 4 * 4;
+            uint32_t address;
+            switch (test % 4)
+            {
+            case 0:  address = tapaddr + GetRandomWord(&seed) % 2048;  break;  // Palette
+            case 1:  address = lineaddr + (GetRandomWord(&seed) & 2);  break;  // Line table entry
+            case 2:  address = otraddr + (GetRandomWord(&seed) & 2);  break;  // Segment descriptor
+            default:  address = GetVideoAddress(pBoard, otraddr) + GetRandomWord(&seed) % 128;  break;  // Segment data
+            }
+            address &= ~1u;
+            uint16_t word = GetRandomWord(&seed);
+            if (address >= 512 * 1024)
+                continue;
+            pBoard->SetRAMWord(address, (address & 2) ? word & 0177761 : word);  // Keep the addresses in 512K
+
+            Emulator_PrepareScreenRGB32(image.data(), width, height);
+            Emulator_InvalidateScreen();
+            Emulator_PrepareScreenRGB32(imageFull.data(), width, height);
+            QVERIFY(image == imageFull);
+            Emulator_PrepareScreenRGB32(image.data(), width, height);  // Back to the incremental image
+        }
+    }
+}
+
+void TestEmulator::benchmarkVideoModes_data()
+{
+    QTest::addColumn<int>("vmode");
+    QTest::addColumn<bool>("pb");
+    QTest::addColumn<int>("level");
+    const char* levelNames[] = { "scalar", "SSE2", "AVX2" };
+    for (int level = VIDEOKERNELS_SCALAR; level <= VIDEOKERNELS_AVX2; level++)
+    {
+        for (int vmode = 0; vmode < 16; vmode++)
+        {
+            QTest::newRow(qPrintable(QString("vmode %1 %2").arg(vmode).arg(levelNames[level]))) << vmode << false << level;
+            if ((vmode & 3) == 3)
+                QTest::newRow(qPrintable(QString("vmode %1 PB %2").arg(vmode).arg(levelNames[level]))) << vmode << true << level;
+        }
+    }
+}
+
+// Fixed workload: 832x600 frame, every line is one segment of the given video mode over random data
+void TestEmulator::benchmarkVideoModes()
+{
+    QFETCH(int, vmode);
+    QFETCH(bool, pb);
+    QFETCH(int, level);
+    if (level > VideoKernels_GetMaxLevel())
+        QSKIP("The kernel level is not supported by this CPU");
+
+    TestVideoBoard videoBoard;
+    CMotherboard& board = *videoBoard.GetBoard();
+    const uint32_t tasaddr = 0100000, tapaddr = 0110000, lineaddr = 0120000, dataaddr = 0130000;
+    board.SetRAMWord(0000010, tasaddr >> 2);  // VDPTAS
+    board.SetRAMWord(0000012, 0);
+    board.SetRAMWord(0000004, tapaddr >> 2);  // VDPTAP
+    board.SetRAMWord(0000006, 0);
+    for (int line = 0; line < 300; line++)
+    {
+        board.SetRAMWord(tasaddr + line * 4, lineaddr >> 2);
+        board.SetRAMWord(tasaddr + line * 4 + 2, 0);
+    }
+    board.SetRAMWord(lineaddr, dataaddr >> 2);  // One segment of 32 words for the whole line
+    board.SetRAMWord(lineaddr + 2, (uint16_t)((pb ? 0100000 : 0) | (vmode << 6)));
+    uint32_t seed = 4321;
+    for (uint32_t offset = 0; offset < 2048; offset += 2)
+        board.SetRAMWord(tapaddr + offset, GetRandomWord(&seed));
+    for (uint32_t offset = 0; offset < 208; offset += 2)
+        board.SetRAMWord(dataaddr + offset, GetRandomWord(&seed));
+
+    std::vector<uint32_t> image(832 * 600);
+    VideoKernels_SetLevel(level);
+    QBENCHMARK
+    {
+        Emulator_InvalidateScreen();
+        Emulator_PrepareScreenRGB32(image.data(), 2);
+    }
+}
+
 #endif // if !defined(QT_NO_DEBUG)
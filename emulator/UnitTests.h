@@ -15,6 +15,30 @@ private slots:
     void testPrintBinaryValue();
 };
 
+class TestEmulator : public QObject
+{
+    Q_OBJECT
+private slots:
+    void benchmarkRomBoot_data();
+    void benchmarkRomBoot();
+    void testBlockLockstep();
+    void testLazyFlags();
+    void benchmarkMemoryAccess();
+    void testNativeFIS();
+    void testEmulHLE();
+    void testEmulHLEvsROM();
+    void testSOBIdiom();
+    void testPITAdvance();
+    void testSoundBlep();
+    void testRAMDirty();
+    void testVideoScaler();
+    void testVideoKernels();
+    void testScreenBands();
+    void testScreenIncremental();
+    void benchmarkVideoModes_data();
+    void benchmarkVideoModes();
+};
+
 
 #endif // if !defined(QT_NO_DEBUG)
 
@@ -0,0 +1,536 @@
+﻿// VideoKernels.cpp
+
+#include "stdafx.h"
+#include "VideoKernels.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define VIDEOKERNELS_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// SSE2 goes when the build targets it anyway; AVX2 code is built with the function target and is chosen at run time
+#if defined(VIDEOKERNELS_X86) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define VIDEOKERNELS_HAS_SSE2
+#endif
+#if defined(VIDEOKERNELS_X86) && (defined(__GNUC__) || defined(_MSC_VER))
+#define VIDEOKERNELS_HAS_AVX2
+#endif
+#if defined(__GNUC__)
+#define VIDEOKERNELS_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define VIDEOKERNELS_TARGET_AVX2
+#endif
+
+
+//////////////////////////////////////////////////////////////////////
+// Scalar kernels
+
+template<int BITS, int WIDTH>
+static void VideoExpandScalar(uint32_t* pPixels, const uint8_t* pData, int bytes, const uint32_t* pPalette)
+{
+    const int mask = (1 << BITS) - 1;
+    for (int i = 0; i < bytes; i++)
+    {
+        int data = pData[i];
+        for (int j = 0; j < 8; j += BITS)
+        {
+            uint32_t color = pPalette[(data >> j) & mask];
+            for (int k = 0; k < WIDTH; k++)
+                *pPixels++ = color;
+        }
+    }
+}
+
+// Blend of pixels a and b by `weight` quarters of b; the rounding is per byte, except the full blue byte
+// for the half blend, as in the former fixed-ratio scalers
+static inline uint32_t VideoBlendPixel(uint32_t a, uint32_t b, int weight)
+{
+    switch (weight)
+    {
+    case 0:
+        return a;
+    case 1:
+        return ((b & 0xfcfcfcffu) >> 2) + a - ((a & 0xfcfcfcffu) >> 2);
+    case 2:
+        return ((a & 0xfefefeffu) + (b & 0xfefefeffu)) >> 1;
+    case 3:
+        return ((a & 0xfcfcfcffu) >> 2) + b - ((b & 0xfcfcfcffu) >> 2);
+    default:
+        return b;
+    }
+}
+
+static void VideoBlendRowsScalar(uint32_t* pDest, const uint32_t* pA, const uint32_t* pB, int weight, int count)
+{
+    if (weight <= 0 || weight >= 4)
+    {
+        ::memcpy(pDest, weight <= 0 ? pA : pB, count * sizeof(uint32_t));
+        return;
+    }
+    for (int x = 0; x < count; x++)
+        pDest[x] = VideoBlendPixel(pA[x], pB[x], weight);
+}
+
+static void VideoScaleRowScalar(uint32_t* pDest, const uint32_t* pSrc, int /*srcSize*/, const uint16_t* pIndex, const uint8_t* pWeight, int count)
+{
+    for (int x = 0; x < count; x++)
+    {
+        const uint32_t* pPair = pSrc + pIndex[x];
+        pDest[x] = VideoBlendPixel(pPair[0], pPair[1], pWeight[x]);
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// SSE2 kernels, 4 pixels per store
+
+#if defined(VIDEOKERNELS_HAS_SSE2)
+
+template<int BITS, int WIDTH>
+static void VideoExpandSSE2(uint32_t* pPixels, const uint8_t* pData, int bytes, const uint32_t* pPalette)
+{
+    __m128i* pDest = reinterpret_cast<__m128i*>(pPixels);
+    const int mask = (1 << BITS) - 1;
+    if (BITS == 1)  // Two colors: every lane selects by its own data bit
+    {
+        const __m128i color0 = _mm_set1_epi32((int)pPalette[0]);
+        const __m128i color1 = _mm_set1_epi32((int)pPalette[1]);
+        __m128i bits[2 * WIDTH];  // Data bit of every lane, for every store of the byte
+        for (int v = 0; v < 2 * WIDTH; v++)
+        {
+            bits[v] = _mm_setr_epi32(
+                    1 << (v * 4 / WIDTH), 1 << ((v * 4 + 1) / WIDTH),
+                    1 << ((v * 4 + 2) / WIDTH), 1 << ((v * 4 + 3) / WIDTH));
+        }
+        for (int i = 0; i < bytes; i++)
+        {
+            const __m128i data = _mm_set1_epi32(pData[i]);
+            for (int v = 0; v < 2 * WIDTH; v++)
+            {
+                __m128i select = _mm_cmpeq_epi32(_mm_and_si128(data, bits[v]), bits[v]);
+                _mm_storeu_si128(pDest++, _mm_or_si128(_mm_and_si128(select, color1), _mm_andnot_si128(select, color0)));
+            }
+        }
+    }
+    else if (WIDTH == 1)  // Four indices per store
+    {
+        for (int i = 0; i < bytes; i++)
+        {
+            int data = pData[i];
+            for (int j = 0; j < 8; j += 4 * BITS)
+            {
+                _mm_storeu_si128(pDest++, _mm_setr_epi32(
+                        (int)pPalette[(data >> j) & mask], (int)pPalette[(data >> (j + BITS)) & mask],
+                        (int)pPalette[(data >> (j + 2 * BITS)) & mask], (int)pPalette[(data >> (j + 3 * BITS)) & mask]));
+            }
+        }
+    }
+    else if (WIDTH == 2)  // Two indices per store
+    {
+        for (int i = 0; i < bytes; i++)
+        {
+            int data = pData[i];
+            for (int j = 0; j < 8; j += 2 * BITS)
+            {
+                int color0 = (int)pPalette[(data >> j) & mask];
+                int color1 = (int)pPalette[(data >> (j + BITS)) & mask];
+                _mm_storeu_si128(pDest++, _mm_setr_epi32(color0, color0, color1, color1));
+            }
+        }
+    }
+    else  // One index for one or more stores
+    {
+        for (int i = 0; i < bytes; i++)
+        {
+            int data = pData[i];
+            for (int j = 0; j < 8; j += BITS)
+            {
+                const __m128i color = _mm_set1_epi32((int)pPalette[(data >> j) & mask]);
+                for (int k = 0; k < WIDTH / 4; k++)
+                    _mm_storeu_si128(pDest++, color);
+            }
+        }
+    }
+}
+
+// 3/4 of a plus 1/4 of b, see VideoBlendPixel()
+static inline __m128i VideoBlendQuarterSSE2(__m128i a, __m128i b)
+{
+    const __m128i mask = _mm_set1_epi32((int)0xfcfcfcffu);
+    return _mm_add_epi32(_mm_srli_epi32(_mm_and_si128(b, mask), 2), _mm_sub_epi32(a, _mm_srli_epi32(_mm_and_si128(a, mask), 2)));
+}
+
+static inline __m128i VideoBlendHalfSSE2(__m128i a, __m128i b)
+{
+    const __m128i mask = _mm_set1_epi32((int)0xfefefeffu);
+    return _mm_srli_epi32(_mm_add_epi32(_mm_and_si128(a, mask), _mm_and_si128(b, mask)), 1);
+}
+
+static inline __m128i VideoSelectSSE2(__m128i select, __m128i a, __m128i b)  // b where select, otherwise a
+{
+    return _mm_or_si128(_mm_and_si128(select, b), _mm_andnot_si128(select, a));
+}
+
+static void VideoBlendRowsSSE2(uint32_t* pDest, const uint32_t* pA, const uint32_t* pB, int weight, int count)
+{
+    if (weight <= 0 || weight >= 4)
+    {
+        ::memcpy(pDest, weight <= 0 ? pA : pB, count * sizeof(uint32_t));
+        return;
+    }
+    int x = 0;
+    for (; x + 4 <= count; x += 4)
+    {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pA + x));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pB + x));
+        __m128i color;
+        if (weight == 1)
+            color = VideoBlendQuarterSSE2(a, b);
+        else if (weight == 2)
+            color = VideoBlendHalfSSE2(a, b);
+        else
+            color = VideoBlendQuarterSSE2(b, a);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pDest + x), color);
+    }
+    for (; x < count; x++)
+        pDest[x] = VideoBlendPixel(pA[x], pB[x], weight);
+}
+
+static void VideoScaleRowSSE2(uint32_t* pDest, const uint32_t* pSrc, int srcSize, const uint16_t* pIndex, const uint8_t* pWeight, int count)
+{
+    const __m128i weight1 = _mm_set1_epi32(1);
+    const __m128i weight2 = _mm_set1_epi32(2);
+    const __m128i weight3 = _mm_set1_epi32(3);
+    const __m128i weight4 = _mm_set1_epi32(4);
+    int x = 0;
+    for (; x + 4 <= count; x += 4)
+    {
+        const uint32_t* p0 = pSrc + pIndex[x];
+        const uint32_t* p1 = pSrc + pIndex[x + 1];
+        const uint32_t* p2 = pSrc + pIndex[x + 2];
+        const uint32_t* p3 = pSrc + pIndex[x + 3];
+        __m128i a = _mm_setr_epi32((int)p0[0], (int)p1[0], (int)p2[0], (int)p3[0]);
+        __m128i b = _mm_setr_epi32((int)p0[1], (int)p1[1], (int)p2[1], (int)p3[1]);
+        __m128i weight = _mm_setr_epi32(pWeight[x], pWeight[x + 1], pWeight[x + 2], pWeight[x + 3]);
+        __m128i color = a;
+        color = VideoSelectSSE2(_mm_cmpeq_epi32(weight, weight1), color, VideoBlendQuarterSSE2(a, b));
+        color = VideoSelectSSE2(_mm_cmpeq_epi32(weight, weight2), color, VideoBlendHalfSSE2(a, b));
+        color = VideoSelectSSE2(_mm_cmpeq_epi32(weight, weight3), color, VideoBlendQuarterSSE2(b, a));
+        color = VideoSelectSSE2(_mm_cmpeq_epi32(weight, weight4), color, b);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pDest + x), color);
+    }
+    VideoScaleRowScalar(pDest + x, pSrc, srcSize, pIndex + x, pWeight + x, count - x);
+}
+
+#endif  // VIDEOKERNELS_HAS_SSE2
+
+
+//////////////////////////////////////////////////////////////////////
+// AVX2 kernels, 8 pixels per store
+
+#if defined(VIDEOKERNELS_HAS_AVX2)
+
+template<int BITS, int WIDTH>
+VIDEOKERNELS_TARGET_AVX2
+static void VideoExpandAVX2(uint32_t* pPixels, const uint8_t* pData, int bytes, const uint32_t* pPalette)
+{
+    __m256i* pDest = reinterpret_cast<__m256i*>(pPixels);
+    const int mask = (1 << BITS) - 1;
+    if (WIDTH >= 8)  // One index for one or more stores
+    {
+        for (int i = 0; i < bytes; i++)
+        {
+            int data = pData[i];
+            for (int j = 0; j < 8; j += BITS)
+            {
+                const __m256i color = _mm256_set1_epi32((int)pPalette[(data >> j) & mask]);
+                for (int k = 0; k < WIDTH / 8; k++)
+                    _mm256_storeu_si256(pDest++, color);
+            }
+        }
+        return;
+    }
+
+    // Every 8 pixels take 8 / WIDTH indices: two halves for two indices,
+    // otherwise the lanes shift the data each by its own index position
+    const int vectorBits = 8 / WIDTH * BITS;  // 4, 8 or 16
+    const __m256i shifts = _mm256_setr_epi32(
+            0, 1 / WIDTH * BITS, 2 / WIDTH * BITS, 3 / WIDTH * BITS,
+            4 / WIDTH * BITS, 5 / WIDTH * BITS, 6 / WIDTH * BITS, 7 / WIDTH * BITS);
+    const __m256i masks = _mm256_set1_epi32(mask);
+    const __m256i color0 = _mm256_set1_epi32((int)pPalette[0]);
+    const __m256i color1 = _mm256_set1_epi32((int)pPalette[1]);
+    const int unitBytes = (vectorBits + 7) / 8;
+    const int units = bytes / unitBytes;
+    for (int pos = 0; pos < units * unitBytes * 8; pos += vectorBits)
+    {
+        const uint8_t* pUnit = pData + (pos >> 3);
+        int data;
+        if (vectorBits == 16)
+            data = pUnit[0] | (pUnit[1] << 8);
+        else
+            data = pUnit[0] >> (pos & 7);
+        if (WIDTH == 4)  // Two 4-pixel halves are cheaper than a lane insert
+        {
+            __m128i* pHalf = reinterpret_cast<__m128i*>(pDest++);
+            _mm_storeu_si128(pHalf, _mm_set1_epi32((int)pPalette[data & mask]));
+            _mm_storeu_si128(pHalf + 1, _mm_set1_epi32((int)pPalette[(data >> BITS) & mask]));
+            continue;
+        }
+        __m256i color;
+        __m256i index = _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32(data), shifts), masks);
+        if (BITS == 1)
+            color = _mm256_blendv_epi8(color0, color1, _mm256_cmpeq_epi32(index, masks));
+        else
+            color = _mm256_i32gather_epi32(reinterpret_cast<const int*>(pPalette), index, 4);
+        _mm256_storeu_si256(pDest++, color);
+    }
+    if (units * unitBytes < bytes)  // Odd byte tail of the 16-bit units
+    {
+        VideoExpandScalar<BITS, WIDTH>(
+            reinterpret_cast<uint32_t*>(pDest), pData + units * unitBytes, bytes - units * unitBytes, pPalette);
+    }
+}
+
+VIDEOKERNELS_TARGET_AVX2
+static inline __m256i VideoBlendQuarterAVX2(__m256i a, __m256i b)
+{
+    const __m256i mask = _mm256_set1_epi32((int)0xfcfcfcffu);
+    return _mm256_add_epi32(_mm256_srli_epi32(_mm256_and_si256(b, mask), 2), _mm256_sub_epi32(a, _mm256_srli_epi32(_mm256_and_si256(a, mask), 2)));
+}
+
+VIDEOKERNELS_TARGET_AVX2
+static inline __m256i VideoBlendHalfAVX2(__m256i a, __m256i b)
+{
+    const __m256i mask = _mm256_set1_epi32((int)0xfefefeffu);
+    return _mm256_srli_epi32(_mm256_add_epi32(_mm256_and_si256(a, mask), _mm256_and_si256(b, mask)), 1);
+}
+
+VIDEOKERNELS_TARGET_AVX2
+static void VideoBlendRowsAVX2(uint32_t* pDest, const uint32_t* pA, const uint32_t* pB, int weight, int count)
+{
+    if (weight <= 0 || weight >= 4)
+    {
+        ::memcpy(pDest, weight <= 0 ? pA : pB, count * sizeof(uint32_t));
+        return;
+    }
+    int x = 0;
+    for (; x + 8 <= count; x += 8)
+    {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pA + x));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pB + x));
+        __m256i color;
+        if (weight == 1)
+            color = VideoBlendQuarterAVX2(a, b);
+        else if (weight == 2)
+            color = VideoBlendHalfAVX2(a, b);
+        else
+            color = VideoBlendQuarterAVX2(b, a);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(pDest + x), color);
+    }
+    for (; x < count; x++)
+        pDest[x] = VideoBlendPixel(pA[x], pB[x], weight);
+}
+
+VIDEOKERNELS_TARGET_AVX2
+static void VideoScaleRowAVX2(uint32_t* pDest, const uint32_t* pSrc, int srcSize, const uint16_t* pIndex, const uint8_t* pWeight, int count)
+{
+    const int* pSrcA = reinterpret_cast<const int*>(pSrc);
+    const int* pSrcB = pSrcA + 1;
+    const __m256i weight1 = _mm256_set1_epi32(1);
+    const __m256i weight2 = _mm256_set1_epi32(2);
+    const __m256i weight3 = _mm256_set1_epi32(3);
+    const __m256i weight4 = _mm256_set1_epi32(4);
+    int x = 0;
+    for (; x + 8 <= count; x += 8)
+    {
+        __m256i index = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pIndex + x)));
+        __m256i weight = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(pWeight + x)));
+        __m256i a, b;
+        int first = pIndex[x];
+        if (pIndex[x + 7] - first < 8 && first + 9 <= srcSize)  // Upscale: all the pairs within 9 pixels, permute them
+        {
+            __m256i offset = _mm256_sub_epi32(index, _mm256_set1_epi32(first));
+            a = _mm256_permutevar8x32_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pSrcA + first)), offset);
+            b = _mm256_permutevar8x32_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pSrcB + first)), offset);
+        }
+        else
+        {
+            a = _mm256_i32gather_epi32(pSrcA, index, 4);
+            b = _mm256_i32gather_epi32(pSrcB, index, 4);
+        }
+        __m256i color = a;
+        color = _mm256_blendv_epi8(color, VideoBlendQuarterAVX2(a, b), _mm256_cmpeq_epi32(weight, weight1));
+        color = _mm256_blendv_epi8(color, VideoBlendHalfAVX2(a, b), _mm256_cmpeq_epi32(weight, weight2));
+        color = _mm256_blendv_epi8(color, VideoBlendQuarterAVX2(b, a), _mm256_cmpeq_epi32(weight, weight3));
+        color = _mm256_blendv_epi8(color, b, _mm256_cmpeq_epi32(weight, weight4));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(pDest + x), color);
+    }
+    VideoScaleRowScalar(pDest + x, pSrc, srcSize, pIndex + x, pWeight + x, count - x);
+}
+
+#endif  // VIDEOKERNELS_HAS_AVX2
+
+
+//////////////////////////////////////////////////////////////////////
+// Kernel selection
+
+#define VIDEOKERNELS_SELECT(kernel, bits, width) \
+    switch ((bits) * 100 + (width)) \
+    { \
+    case 101: return kernel<1, 1>; \
+    case 102: return kernel<1, 2>; \
+    case 201: return kernel<2, 1>; \
+    case 202: return kernel<2, 2>; \
+    case 204: return kernel<2, 4>; \
+    case 402: return kernel<4, 2>; \
+    case 404: return kernel<4, 4>; \
+    case 408: return kernel<4, 8>; \
+    case 804: return kernel<8, 4>; \
+    case 808: return kernel<8, 8>; \
+    case 816: return kernel<8, 16>; \
+    default: return nullptr; \
+    }
+
+static int m_nVideoKernelsLevel = -1;  // -1 = not chosen yet
+
+static bool VideoKernels_IsAVX2Supported()
+{
+#if defined(VIDEOKERNELS_HAS_AVX2) && defined(__GNUC__)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+#elif defined(VIDEOKERNELS_HAS_AVX2) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+    __cpuid(info, 1);
+    if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0)  // OSXSAVE, AVX
+        return false;
+    if ((_xgetbv(0) & 6) != 6)  // The OS saves XMM and YMM registers
+        return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return false;
+#endif
+}
+
+int VideoKernels_GetMaxLevel()
+{
+    if (VideoKernels_IsAVX2Supported())
+        return VIDEOKERNELS_AVX2;
+#if defined(VIDEOKERNELS_HAS_SSE2)
+    return VIDEOKERNELS_SSE2;
+#else
+    return VIDEOKERNELS_SCALAR;
+#endif
+}
+
+void VideoKernels_Init()
+{
+    if (m_nVideoKernelsLevel < 0)
+        m_nVideoKernelsLevel = VideoKernels_GetMaxLevel();
+}
+
+int VideoKernels_GetLevel()
+{
+    VideoKernels_Init();
+    return m_nVideoKernelsLevel;
+}
+
+void VideoKernels_SetLevel(int level)
+{
+    int maxLevel = VideoKernels_GetMaxLevel();
+    if (level > maxLevel)
+        level = maxLevel;
+    if (level < VIDEOKERNELS_SCALAR)
+        level = VIDEOKERNELS_SCALAR;
+    m_nVideoKernelsLevel = level;
+}
+
+VIDEOEXPANDPROC VideoKernels_GetExpandProc(int bits, int width)
+{
+    switch (VideoKernels_GetLevel())
+    {
+#if defined(VIDEOKERNELS_HAS_AVX2)
+    case VIDEOKERNELS_AVX2:
+        VIDEOKERNELS_SELECT(VideoExpandAVX2, bits, width)
+#endif
+#if defined(VIDEOKERNELS_HAS_SSE2)
+    case VIDEOKERNELS_SSE2:
+        VIDEOKERNELS_SELECT(VideoExpandSSE2, bits, width)
+#endif
+    default:
+        VIDEOKERNELS_SELECT(VideoExpandScalar, bits, width)
+    }
+}
+
+
+VIDEOBLENDROWSPROC VideoKernels_GetBlendRowsProc()
+{
+    switch (VideoKernels_GetLevel())
+    {
+#if defined(VIDEOKERNELS_HAS_AVX2)
+    case VIDEOKERNELS_AVX2:
+        return VideoBlendRowsAVX2;
+#endif
+#if defined(VIDEOKERNELS_HAS_SSE2)
+    case VIDEOKERNELS_SSE2:
+        return VideoBlendRowsSSE2;
+#endif
+    default:
+        return VideoBlendRowsScalar;
+    }
+}
+
+VIDEOSCALEROWPROC VideoKernels_GetScaleRowProc()
+{
+    switch (VideoKernels_GetLevel())
+    {
+#if defined(VIDEOKERNELS_HAS_AVX2)
+    case VIDEOKERNELS_AVX2:
+        return VideoScaleRowAVX2;
+#endif
+#if defined(VIDEOKERNELS_HAS_SSE2)
+    case VIDEOKERNELS_SSE2:
+        return VideoScaleRowSSE2;
+#endif
+    default:
+        return VideoScaleRowScalar;
+    }
+}
+
+void VideoKernels_GetScaleTaps(int srcSize, int destSize, uint16_t* pIndex, uint8_t* pWeight)
+{
+    // Coordinates in 1/destSize parts of a source pixel: the destination pixel x covers [x0, x1),
+    // the source pixel i covers [i * destSize, (i + 1) * destSize)
+    for (int x = 0; x < destSize; x++)
+    {
+        int64_t x0 = (int64_t)x * srcSize;
+        int64_t x1 = x0 + srcSize;
+        int64_t center = x0 + x1 - destSize;  // Twice the center, shifted by a half of source pixel
+        int i = (center <= 0) ? 0 : (int)(center / (2 * destSize));
+        if (i > srcSize - 1)
+            i = srcSize - 1;
+        int64_t coverA = std::min(x1, (int64_t)(i + 1) * destSize) - std::max(x0, (int64_t)i * destSize);
+        int64_t coverB = (i + 1 < srcSize) ? std::min(x1, (int64_t)(i + 2) * destSize) - std::max(x0, (int64_t)(i + 1) * destSize) : 0;
+        if (coverA < 0) coverA = 0;
+        if (coverB < 0) coverB = 0;
+        int weight = (int)((coverB * 8 + coverA + coverB) / (2 * (coverA + coverB)));  // Rounded quarters of B
+        if (i == srcSize - 1)  // The last source pixel goes as B of the previous pair
+        {
+            i--;  weight = 4;
+        }
+        pIndex[x] = (uint16_t)i;
+        pWeight[x] = (uint8_t)weight;
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
@@ -0,0 +1,40 @@
+﻿// VideoKernels.h  Pixel expansion kernels for the video renderer
+
+#pragma once
+
+//////////////////////////////////////////////////////////////////////
+
+
+// Kernel instruction set levels, see VideoKernels_SetLevel()
+#define VIDEOKERNELS_SCALAR     0
+#define VIDEOKERNELS_SSE2       1
+#define VIDEOKERNELS_AVX2       2
+
+// Expands a run of video data into RGB32 pixels. The data is a bit stream, low bits first;
+// every `bits` bits are a palette index for `width` pixels, so the run gives bytes * 8 / bits * width pixels.
+typedef void (*VIDEOEXPANDPROC)(uint32_t* pPixels, const uint8_t* pData, int bytes, const uint32_t* pPalette);
+
+// Kernel for the given bits per palette index 1/2/4/8 and pixels per index 1/2/4/8/16; nullptr for other ones
+VIDEOEXPANDPROC VideoKernels_GetExpandProc(int bits, int width);
+
+// Scaler: every destination pixel is a blend of two neighbour source pixels A and B, in quarters of B,
+// see VideoKernels_GetScaleTaps(). Blends a row of A pixels with a row of B pixels by `weight` quarters 0..4.
+typedef void (*VIDEOBLENDROWSPROC)(uint32_t* pDest, const uint32_t* pA, const uint32_t* pB, int weight, int count);
+// Scales a row of srcSize pixels: pDest[x] is a blend of pSrc[pIndex[x]] and pSrc[pIndex[x] + 1] by pWeight[x] quarters;
+// pIndex never goes down
+typedef void (*VIDEOSCALEROWPROC)(uint32_t* pDest, const uint32_t* pSrc, int srcSize, const uint16_t* pIndex, const uint8_t* pWeight, int count);
+
+VIDEOBLENDROWSPROC VideoKernels_GetBlendRowsProc();
+VIDEOSCALEROWPROC VideoKernels_GetScaleRowProc();
+
+// Scaler taps for srcSize pixels into destSize pixels: area-weighted blend of the two source pixels under
+// the destination pixel, weights rounded to quarters; pIndex[x] + 1 is always less than srcSize (srcSize >= 2)
+void VideoKernels_GetScaleTaps(int srcSize, int destSize, uint16_t* pIndex, uint8_t* pWeight);
+
+void VideoKernels_Init();  // Chooses the max level unless a level is set already
+int VideoKernels_GetMaxLevel();  // The best level for this CPU and build
+int VideoKernels_GetLevel();
+void VideoKernels_SetLevel(int level);  // Levels above the max one fall back to the max one
+
+
+//////////////////////////////////////////////////////////////////////
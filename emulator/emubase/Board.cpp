@@ -32,6 +32,8 @@ CMotherboard::CMotherboard()
     m_pFloppyCtl = new CFloppyController(this);
     m_pHardDrive = nullptr;
 
+    m_pCPUbps = static_cast<uint32_t*>(::calloc(65536 / 2 / 32, sizeof(uint32_t)));
+    m_okCPUbps = false;
     m_dwTrace = 0;
     m_SoundGenCallback = nullptr;
     m_SerialOutCallback = nullptr;
@@ -43,6 +45,17 @@ CMotherboard::CMotherboard()
     // Allocate memory
     m_nRamSizeBytes = 0;
     m_pRAM = nullptr;  // RAM allocation in SetConfiguration() method
+    ::memset(m_RAMDirty, 0xff, sizeof(m_RAMDirty));
+    m_nIOAccessCount = 0;
+    m_nChangeCount = 0;
+    m_okEmulHLE = false;
+    m_idletick = -1;
+    m_idleiocount = 0;
+    ::memset(m_devdeadline, 0, sizeof(m_devdeadline));
+    m_devnext = 0;
+    m_procticks = 0;
+    m_timertick = 3;
+    m_soundlevel = 0;
     m_pROM = static_cast<uint8_t*>(::calloc(16 * 1024, 1));
     m_pHDbuff = static_cast<uint8_t*>(::calloc(4 * 512, 1));
 
@@ -84,6 +97,7 @@ CMotherboard::~CMotherboard()
     ::free(m_pRAM);
     ::free(m_pROM);
     ::free(m_pHDbuff);
+    ::free(m_pCPUbps);
 }
 
 void CMotherboard::SetConfiguration(uint16_t conf)
@@ -97,7 +111,10 @@ void CMotherboard::SetConfiguration(uint16_t conf)
         nRamSizeKbytes = 512;
     m_nRamSizeBytes = nRamSizeKbytes * 1024;
     m_pRAM = static_cast<uint8_t*>(::calloc(m_nRamSizeBytes, 1));
+    ::memset(m_RAMDirty, 0xff, sizeof(m_RAMDirty));
     ::memset(m_pROM, 0, 16 * 1024);
+    m_pCPU->FlushDecodeCache();
+    UpdateMemoryMap();
 
     //// Pre-fill RAM with "uninitialized" values
     //uint16_t * pMemory = (uint16_t *) m_pRAM;
@@ -149,6 +166,7 @@ void CMotherboard::Reset()
 void CMotherboard::LoadROM(const uint8_t* pBuffer)
 {
     ::memcpy(m_pROM, pBuffer, 16384);
+    m_pCPU->FlushDecodeCache();
 }
 
 void CMotherboard::LoadRAMBank(int bank, const void* buffer)
@@ -156,6 +174,8 @@ void CMotherboard::LoadRAMBank(int bank, const void* buffer)
     if (bank < 0 || bank > (int)(m_nRamSizeBytes / 8192))
         return;
     memcpy(m_pRAM + bank * 8192, buffer, 8192);
+    SetRAMDirty(bank * 8192, 8192);
+    m_pCPU->FlushDecodeCache();
 }
 
 
@@ -262,6 +282,7 @@ uint16_t CMotherboard::GetHardPortWord(uint16_t port)
     if (m_pHardDrive == nullptr) return 0;
     port = (uint16_t)((port >> 1) & 7) | 0x1f0;
     uint16_t data = m_pHardDrive->ReadPort(port);
+    ScheduleHardDrive();  // Reading the last word of the sector starts the next one
     DebugLogFormat(_T("%c%06ho\tIDE GET %03hx -> 0x%04hx\n"), HU_INSTRUCTION_PC, port, data);
     return data;
 }
@@ -271,6 +292,7 @@ void CMotherboard::SetHardPortWord(uint16_t port, uint16_t data)
     port = (uint16_t)((port >> 1) & 7) | 0x1f0;
     DebugLogFormat(_T("%c%06ho\tIDE SET 0x%04hx -> %03hx\n"), HU_INSTRUCTION_PC, data, port);
     m_pHardDrive->WritePort(port, data);
+    ScheduleHardDrive();  // A command or the last word of the sector starts the timeout
 }
 
 
@@ -285,6 +307,19 @@ uint8_t CMotherboard::GetRAMByte(uint32_t offset) const
 {
     return m_pRAM[offset];
 }
+// All RAM writes go through SetRAMXxx methods, to keep CPU decoded instruction cache and RAM dirty pages coherent
+void CMotherboard::SetRAMWord(uint32_t offset, uint16_t word)
+{
+    *((uint16_t*)(m_pRAM + offset)) = word;
+    SetRAMDirty(offset);
+    m_pCPU->InvalidateInstruction(offset);
+}
+void CMotherboard::SetRAMByte(uint32_t offset, uint8_t byte)
+{
+    m_pRAM[offset] = byte;
+    SetRAMDirty(offset);
+    m_pCPU->InvalidateInstruction(offset);
+}
 void CMotherboard::SetRAMWord2(uint32_t offset, uint16_t word)
 {
     uint16_t* p = (uint16_t*)(m_pRAM + offset);
@@ -294,6 +329,8 @@ void CMotherboard::SetRAMWord2(uint32_t offset, uint16_t word)
         ((word & 0x0300) == 0 ? 0 : 0x0300) | ((word & 0x0C00) == 0 ? 0 : 0x0C00) |
         ((word & 0x3000) == 0 ? 0 : 0x3000) | ((word & 0xC000) == 0 ? 0 : 0xC000);
     *p = (word & mask) | (*p & ~mask);
+    SetRAMDirty(offset);
+    m_pCPU->InvalidateInstruction(offset);
 }
 void CMotherboard::SetRAMWord4(uint32_t offset, uint16_t word)
 {
@@ -302,6 +339,8 @@ void CMotherboard::SetRAMWord4(uint32_t offset, uint16_t word)
         ((word & 0x000F) == 0 ? 0 : 0x000F) | ((word & 0x00F0) == 0 ? 0 : 0x00F0) |
         ((word & 0x0F00) == 0 ? 0 : 0x0F00) | ((word & 0xF000) == 0 ? 0 : 0xF000);
     *p = (word & mask) | (*p & ~mask);
+    SetRAMDirty(offset);
+    m_pCPU->InvalidateInstruction(offset);
 }
 void CMotherboard::SetRAMByte2(uint32_t offset, uint8_t byte)
 {
@@ -309,11 +348,79 @@ void CMotherboard::SetRAMByte2(uint32_t offset, uint8_t byte)
         ((byte & 0x03) == 0 ? 0 : 0x03) | ((byte & 0x0C) == 0 ? 0 : 0x0C) |
         ((byte & 0x30) == 0 ? 0 : 0x30) | ((byte & 0xC0) == 0 ? 0 : 0xC0);
     m_pRAM[offset] = (byte & mask) | (m_pRAM[offset] & ~mask);
+    SetRAMDirty(offset);
+    m_pCPU->InvalidateInstruction(offset);
 }
 void CMotherboard::SetRAMByte4(uint32_t offset, uint8_t byte)
 {
     uint8_t mask = ((byte & 0x0F) == 0 ? 0 : 0x0F) | ((byte & 0xF0) == 0 ? 0 : 0xF0);
     m_pRAM[offset] = (byte & mask) | (m_pRAM[offset] & ~mask);
+    SetRAMDirty(offset);
+    m_pCPU->InvalidateInstruction(offset);
+}
+
+// RAM blocks for CPU loop idioms, see CProcessor::ExecuteSOB()
+int CMotherboard::GetRAMBlockType(uint16_t address, uint16_t size, bool okHaltMode, uint32_t* pOffset) const
+{
+    if (size == 0 || address >= 0160000 || (address & 017777) + size > 020000)
+        return -1;  // Window 7 has ports and emulated registers
+    uint32_t lastoffset;
+    int addrtype = TranslateAddress(address, okHaltMode, false, pOffset);
+    if (addrtype > ADDRTYPE_RAM4 ||
+        TranslateAddress((uint16_t)(address + size - 1), okHaltMode, false, &lastoffset) != addrtype)
+        return -1;
+    return addrtype;
+}
+uint16_t CMotherboard::CopyRAMBlock(uint32_t dstoffset, int dsttype, uint32_t srcoffset, uint32_t size, bool okByte)
+{
+    m_nChangeCount++;
+    if (dsttype == ADDRTYPE_RAM && (dstoffset <= srcoffset || dstoffset >= srcoffset + size))
+    {
+        ::memmove(m_pRAM + dstoffset, m_pRAM + srcoffset, size);
+        SetRAMDirty(dstoffset, size);
+        for (uint32_t offset = dstoffset & ~1; offset < dstoffset + size; offset += 2)
+            m_pCPU->InvalidateInstruction(offset);
+        return okByte ? m_pRAM[dstoffset + size - 1] : GetRAMWord(dstoffset + size - 2);
+    }
+
+    // Overlapped or masked: element by element, the later elements may read the written ones
+    uint16_t value = 0;
+    for (uint32_t i = 0; i < size; i += okByte ? 1 : 2)
+    {
+        if (okByte)
+        {
+            uint8_t byte = m_pRAM[srcoffset + i];
+            if (dsttype == ADDRTYPE_RAM)
+                SetRAMByte(dstoffset + i, byte);
+            else if (dsttype == ADDRTYPE_RAM2)
+                SetRAMByte2(dstoffset + i, byte);
+            else
+                SetRAMByte4(dstoffset + i, byte);
+            value = byte;
+        }
+        else
+        {
+            uint16_t word = GetRAMWord(srcoffset + i);
+            if (dsttype == ADDRTYPE_RAM)
+                SetRAMWord(dstoffset + i, word);
+            else if (dsttype == ADDRTYPE_RAM2)
+                SetRAMWord2(dstoffset + i, word);
+            else
+                SetRAMWord4(dstoffset + i, word);
+            value = word;
+        }
+    }
+    return value;
+}
+void CMotherboard::ClearRAMBlock(uint32_t offset, int addrtype, uint32_t size)
+{
+    m_nChangeCount++;
+    if (addrtype != ADDRTYPE_RAM)
+        return;  // Masked write of zero changes nothing
+    ::memset(m_pRAM + offset, 0, size);
+    SetRAMDirty(offset, size);
+    for (uint32_t wordoffset = offset & ~1; wordoffset < offset + size; wordoffset += 2)
+        m_pCPU->InvalidateInstruction(wordoffset);
 }
 
 uint16_t CMotherboard::GetROMWord(uint16_t offset) const
@@ -357,6 +464,71 @@ void CMotherboard::Tick50()  // 50 Hz timer
     UpdateInterrupts();
 }
 
+// Timer ticks are done lazily, at the timer port access and at the frame end, see SystemFrame()
+void CMotherboard::UpdateTimer(int procticks)
+{
+    if (m_timertick >= procticks)
+        return;
+    uint32_t time = (uint32_t)(m_timertick - 3) / 4;
+    uint32_t ticks = (uint32_t)(procticks - m_timertick + 3) / 4;
+    m_timertick += (int)ticks * 4;
+    AdvanceTimer(time, ticks);
+}
+
+// SNL channel gates are SND channel outputs; the runs of ticks with no output change are done at once,
+// and the sound level steps go to the band-limited synthesis with the timer tick in the frame
+void CMotherboard::AdvanceTimer(uint32_t time, uint32_t ticks)
+{
+    while (ticks > 0)
+    {
+        uint32_t run = ticks;
+        for (uint8_t channel = 0; channel < 3; channel++)
+        {
+            uint32_t change = m_snd.GetOutputChangeTicks(channel, true);
+            if (change <= run)
+                run = change - 1;
+            change = m_snl.GetOutputChangeTicks(channel, m_snd.GetOutput(channel));
+            if (change <= run)
+                run = change - 1;
+        }
+        if (run == 0)
+        {
+            TimerTick();
+            run = 1;
+        }
+        else
+        {
+            for (uint8_t channel = 0; channel < 3; channel++)
+            {
+                m_snl.Advance(channel, m_snd.GetOutput(channel), run);
+                m_snd.Advance(channel, true, run);
+            }
+        }
+
+        time += run;
+        ticks -= run;
+
+        int level = GetSoundLevel();
+        if (level != m_soundlevel)
+        {
+            m_soundblep.AddDelta(time, level - m_soundlevel);
+            m_soundlevel = level;
+        }
+    }
+}
+
+// Channel sound is on while the SNL output is low
+int CMotherboard::GetSoundLevel() const
+{
+    int level = 0;
+    for (uint8_t channel = 0; channel < 3; channel++)
+    {
+        if (!m_snl.GetOutput(channel))
+            level += 512 * 21;
+    }
+    return level;
+}
+
 void CMotherboard::TimerTick() // Timer Tick - 2 MHz
 {
     m_snd.SetGate(0, true);
@@ -372,12 +544,14 @@ void CMotherboard::TimerTick() // Timer Tick - 2 MHz
 // address = 0161010..0161026
 void CMotherboard::ProcessTimerWrite(uint16_t address, uint8_t byte)
 {
+    UpdateTimer(m_procticks);
     PIT8253& pit = (address & 020) != 0 ? m_snl : m_snd;
     pit.Write((address >> 1) & 3, byte);
 }
 // address = 0161010..0161026
 uint8_t CMotherboard::ProcessTimerRead(uint16_t address)
 {
+    UpdateTimer(m_procticks);
     PIT8253& pit = (address & 020) != 0 ? m_snl : m_snd;
     return pit.Read((address >> 1) & 3);
 }
@@ -401,6 +575,7 @@ void CMotherboard::ProcessKeyboardWrite(uint8_t byte)
         m_keyint = false;
         break;
     }
+    UpdateInterrupts();
 }
 
 void CMotherboard::UpdateKeyboardMatrix(const uint8_t matrix[8])
@@ -418,7 +593,10 @@ void CMotherboard::UpdateKeyboardMatrix(const uint8_t matrix[8])
     ::memcpy(m_keymatrix, matrix, sizeof(m_keymatrix));
 
     if (hasChanges && !m_keyint)
+    {
         m_keyint = true;
+        UpdateInterrupts();
+    }
 }
 
 void CMotherboard::ProcessMouseWrite(uint8_t byte)
@@ -460,6 +638,8 @@ void CMotherboard::MouseMove(short dx, short dy, bool btnLeft, bool btnRight)
 
 void CMotherboard::DebugTicks()
 {
+    bool okBlockMode = m_pCPU->IsBlockMode();
+    m_pCPU->SetBlockMode(false);  // Step by one instruction, the translated blocks are kept
     m_pCPU->ClearInternalTick();
 
 #if !defined(PRODUCT)
@@ -469,11 +649,82 @@ void CMotherboard::DebugTicks()
 
     m_pCPU->Execute();
 
-    UpdateInterrupts();
-
     m_pFloppyCtl->Periodic();
+
+    m_pCPU->SetBlockMode(okBlockMode);
+}
+
+void CMotherboard::SetCPUBreakpoint(uint16_t address)
+{
+    m_pCPUbps[address >> 6] |= 1u << ((address >> 1) & 31);
+    m_okCPUbps = true;
+}
+void CMotherboard::SetCPUBreakpointRange(uint16_t start, uint16_t end)
+{
+    for (uint32_t address = start & ~1; address <= end; address += 2)
+        SetCPUBreakpoint((uint16_t)address);
+}
+void CMotherboard::ClearCPUBreakpoints()
+{
+    ::memset(m_pCPUbps, 0, 65536 / 2 / 8);
+    m_okCPUbps = false;
+}
+
+
+// First CPU tick after the next 50 Hz event, or the end of the frame
+static int GetIdleTickLimit(int procticks)
+{
+    const int tick50first = 5000 * 16 + 15;
+    const int tick50second = 15000 * 16 + 15;
+    if (procticks <= tick50first)
+        return tick50first + 1;
+    if (procticks <= tick50second)
+        return tick50second + 1;
+    return 20000 * 16;
 }
 
+void CMotherboard::GetIdleState(IdleState* pState) const
+{
+    for (int regno = 0; regno < 8; regno++)
+        pState->regs[regno] = m_pCPU->GetReg(regno);
+    pState->psw = m_pCPU->GetPSW();
+    pState->cpc = m_pCPU->GetCPC();
+    pState->cpsw = m_pCPU->GetCPSW();
+    pState->keypos = m_keypos;
+    pState->changecount = m_nChangeCount;
+}
+
+// Called at the instruction boundary; returns the CPU tick to continue from.
+// A loop polling the ports without side effects repeats itself until some event changes the devices,
+// so when the loop comes back to exactly the same state we skip the whole passes up to the event.
+int CMotherboard::SkipIdleLoop(int procticks)
+{
+    bool okPortAccess = (m_nIOAccessCount != m_idleiocount);
+    m_idleiocount = m_nIOAccessCount;
+
+    if (m_idletick >= 0 && m_pCPU->GetPC() == m_idlestate.regs[7])
+    {
+        IdleState state;
+        GetIdleState(&state);
+        int looplength = procticks - m_idletick;
+        int proclimit = GetIdleTickLimit(m_idletick);
+        if (looplength <= IDLE_LOOP_MAX_TICKS && procticks < proclimit &&
+            ::memcmp(&state, &m_idlestate, sizeof(state)) == 0)
+        {
+            procticks += (proclimit - procticks) / looplength * looplength;
+        }
+        else
+            m_idlestate = state;  // Next pass is the candidate
+        m_idletick = procticks;
+    }
+    else if (okPortAccess && (m_idletick < 0 || procticks - m_idletick > IDLE_LOOP_MAX_TICKS))
+    {
+        GetIdleState(&m_idlestate);
+        m_idletick = procticks;
+    }
+
+    return procticks;
+}
 
 /*
 Каждый фрейм равен 1/25 секунды = 40 мс = 20000 тиков, 1 тик = 2 мкс.
@@ -482,90 +733,123 @@ void CMotherboard::DebugTicks()
 * программируемый таймер - на каждый 4-й тик процессора - 2 МГц
 * 2 тика 50 Гц, в 0-й и 10000-й тик фрейма
 * 625 тиков FDD - каждый 32-й тик (300 RPM = 5 оборотов в секунду)
-* 882 тиков звука (для частоты 22050 Гц)
+* звук по фронтам выходов таймера - в конце фрейма, см. SoundBlep
 */
 bool CMotherboard::SystemFrame()
 {
-    const int soundSamplesPerFrame = SOUNDSAMPLERATE / 25;
-    int soundBrasErr = 0;
-    int snl0 = 0, snl1 = 0, snl2 = 0, soundTicks = 0, snd0 = 0, snd1 = 0, snd2 = 0;//DEBUG
-
-    for (int frameticks = 0; frameticks < 20000; frameticks++)
-    {
-        for (int procticks = 0; procticks < 16; procticks++)  // CPU ticks
-        {
+    // Trace and breakpoints change between frames only, so the frame loop is chosen once per frame
 #if !defined(PRODUCT)
-            if ((m_dwTrace & TRACE_CPU) != 0 && m_pCPU->GetInternalTick() == 0)
-                TraceInstruction(m_pCPU, this, m_pCPU->GetPC() & ~1);
+    if ((m_dwTrace & TRACE_CPU) != 0)
+        return m_okCPUbps ? SystemFrameLoop<true, true>() : SystemFrameLoop<true, false>();
 #endif
+    return m_okCPUbps ? SystemFrameLoop<false, true>() : SystemFrameLoop<false, false>();
+}
 
-            m_pCPU->Execute();
+// Deadlines for the frame start; the frame tick events come at the end of the 2 us tick, CPU tick 15 of 16
+void CMotherboard::ScheduleDevices()
+{
+    m_procticks = 0;
+    m_timertick = 3;
+    m_devdeadline[DEVEVENT_TICK50] = 5000 * 16 + 15;
+    m_devdeadline[DEVEVENT_FLOPPY] = 15;
+    m_devdeadline[DEVEVENT_HARD] = (m_pHardDrive != nullptr && m_pHardDrive->GetTimeoutCount() != 0) ? 15 : DEVEVENT_NEVER;
+    m_devnext = 0;  // RunDeviceEvents() finds it
+}
 
-            UpdateInterrupts();
+// The hard drive is ticked only while it waits for its timeout; called when a port access may start one.
+// The next frame tick after the current CPU tick is the same one as for the drive ticked all the time
+void CMotherboard::ScheduleHardDrive()
+{
+    if (m_devdeadline[DEVEVENT_HARD] != DEVEVENT_NEVER || m_pHardDrive->GetTimeoutCount() == 0)
+        return;
+    m_devdeadline[DEVEVENT_HARD] = m_procticks | 15;
+    if (m_devdeadline[DEVEVENT_HARD] < m_devnext)
+        m_devnext = m_devdeadline[DEVEVENT_HARD];
+}
 
-            if (m_CPUbps != nullptr)  // Check for breakpoints
-            {
-                const uint16_t* pbps = m_CPUbps;
-                while (*pbps != 0177777) { if (m_pCPU->GetPC() == *pbps++) return false; }
-            }
+// Run the device events before the CPU tick, in the deadline order; same deadline goes in the DEVEVENT_Xxx order
+void CMotherboard::RunDeviceEvents(int procend)
+{
+    for (;;)
+    {
+        int event = 0;
+        for (int i = 1; i < DEVEVENT_COUNT; i++)
+        {
+            if (m_devdeadline[i] < m_devdeadline[event])
+                event = i;
+        }
+        if (m_devdeadline[event] >= procend)
+        {
+            m_devnext = m_devdeadline[event];
+            break;
+        }
 
-            if ((procticks & 3) == 3)  // Every 4th tick
-            {
-                TimerTick();
-                //snd0 += m_snd.GetOutput(0) ? 1 : 0;
-                //snd1 += m_snd.GetOutput(1) ? 1 : 0;
-                //snd2 += m_snd.GetOutput(2) ? 1 : 0;
-                snl0 += m_snl.GetOutput(0) ? 1 : 0;
-                snl1 += m_snl.GetOutput(1) ? 1 : 0;
-                snl2 += m_snl.GetOutput(2) ? 1 : 0;
-                soundTicks++;
-            }
+        switch (event)
+        {
+        case DEVEVENT_TICK50:  // 1/50 timer event
+            Tick50();
+            m_devdeadline[event] += 10000 * 16;
+            break;
+        case DEVEVENT_FLOPPY:  // FDD tick, every 32nd frame tick
+            m_pFloppyCtl->Periodic();
+            m_devdeadline[event] += 32 * 16;
+            break;
+        case DEVEVENT_HARD:  // Every frame tick while the drive waits for the timeout
+            m_pHardDrive->Periodic();
+            m_devdeadline[event] = (m_pHardDrive->GetTimeoutCount() != 0) ? m_devdeadline[event] + 16 : DEVEVENT_NEVER;
+            break;
         }
+    }
+}
 
-        if (frameticks % 10000 == 5000)
-            Tick50();  // 1/50 timer event
+template<bool okTrace, bool okBreakpoints>
+bool CMotherboard::SystemFrameLoop()
+{
+    const int frameProcTicks = 20000 * 16;
+    int procticks = 0;  // CPU tick in the frame
+    const bool okSkipIdle = !okTrace;  // Trace wants every tick at the instruction boundary
+    m_idletick = -1;
+    m_idleiocount = m_nIOAccessCount;
+    ScheduleDevices();
+    while (procticks < frameProcTicks)
+    {
+#if !defined(PRODUCT)
+        if (okTrace && m_pCPU->GetInternalTick() == 0)
+            TraceInstruction(m_pCPU, this, m_pCPU->GetPC() & ~1);
+#endif
 
-        if (frameticks % 32 == 0)  // FDD tick
-            m_pFloppyCtl->Periodic();
+        bool okWaiting = m_pCPU->IsWaitMode() && m_pCPU->GetInternalTick() == 0;
 
-        if (m_pHardDrive != nullptr)
-            m_pHardDrive->Periodic();
+        m_procticks = procticks;
+        m_pCPU->Execute();
 
-        soundBrasErr += soundSamplesPerFrame;
-        if (2 * soundBrasErr >= 20000)
+        if (okBreakpoints && IsCPUBreakpoint(m_pCPU->GetPC()))  // Check for breakpoints
         {
-            soundBrasErr -= 20000;
-            //DebugLogFormat(_T("SoundSNL %02d  %2d %2d %2d  %2d %2d %2d\r\n"), soundTicks, snd0, snd1, snd2, snl0, snl1, snl2);
-            uint16_t s0 = (uint16_t)((soundTicks - snl0) * 512 / soundTicks);
-            uint16_t s1 = (uint16_t)((soundTicks - snl1) * 512 / soundTicks);
-            uint16_t s2 = (uint16_t)((soundTicks - snl2) * 512 / soundTicks);
-            DoSound(s0, s1, s2);
-            soundTicks = 0; snl0 = snl1 = snl2 = 0; snd0 = snd1 = snd2 = 0;
+            UpdateTimer(procticks);
+            DoSound(m_soundblep.EndFrame((uint32_t)(m_timertick - 3) / 4));
+            return false;
         }
 
-        //if (m_ParallelOutCallback != nullptr)
-        //{
-        //    if ((m_PPIAwr & 2) != 0 && (m_PPIBrd & 0x40) != 0)
-        //    {
-        //        // Strobe set, Printer Ack set => reset Printer Ack
-        //        m_PPIBrd &= ~0x40;
-        //        // Now printer waits for a next byte
-        //    }
-        //    else if ((m_PPIAwr & 2) == 0 && (m_PPIBrd & 0x40) == 0)
-        //    {
-        //        // Strobe reset, Printer Ack reset => byte is ready, print it
-        //        (*m_ParallelOutCallback)(m_PPIBwr);
-        //        // Set Printer Acknowledge
-        //        m_PPIBrd |= 0x40;
-        //        // Now the printer waits for Strobe
-        //    }
-        //}
+        // The rest of the instruction ticks change neither PC nor interrupt signals,
+        // so the devices catch up with the whole instruction at once
+        int procend = procticks + 1 + m_pCPU->SkipInternalTicks(frameProcTicks - procticks - 1);
+        if (okSkipIdle && procend < frameProcTicks && m_pCPU->GetInternalTick() == 0)
+        {
+            if (okWaiting && m_pCPU->IsWaitMode())  // Still no interrupt, so nothing changes till the next event
+                procend = GetIdleTickLimit(procticks);
+            else
+                procend = SkipIdleLoop(procend);
+        }
+        if (m_devnext < procend)
+            RunDeviceEvents(procend);
+        procticks = procend;
     }
+    UpdateTimer(frameProcTicks);
+    DoSound(m_soundblep.EndFrame(SOUNDBLEP_FRAMETICKS));
 
     return true;
 }
 
-
 //////////////////////////////////////////////////////////////////////
 // Motherboard: memory management
 
@@ -582,6 +866,44 @@ uint16_t CMotherboard::GetRAMWordView(uint32_t offset) const
         return 0;
     return *(uint16_t*)(m_pRAM + offset);
 }
+const uint8_t* CMotherboard::GetRAMSpanView(uint32_t offset, uint32_t size) const
+{
+    if (offset >= m_nRamSizeBytes || size > m_nRamSizeBytes - offset)
+        return nullptr;
+    return m_pRAM + offset;
+}
+bool CMotherboard::IsRAMDirty(uint32_t offset, uint32_t size) const
+{
+    if (size == 0 || offset >= m_nRamSizeBytes)
+        return false;  // Nothing is written out of RAM
+    uint32_t lastpage = ((size > m_nRamSizeBytes - offset ? m_nRamSizeBytes : offset + size) - 1) >> RAMDIRTY_PAGE_SHIFT;
+    for (uint32_t page = offset >> RAMDIRTY_PAGE_SHIFT; page <= lastpage; page++)
+    {
+        if ((m_RAMDirty[page >> 5] & (1u << (page & 31))) != 0)
+            return true;
+    }
+    return false;
+}
+void CMotherboard::SetRAMDirty(uint32_t offset, uint32_t size)
+{
+    if (size == 0)
+        return;
+    for (uint32_t page = offset >> RAMDIRTY_PAGE_SHIFT; page <= (offset + size - 1) >> RAMDIRTY_PAGE_SHIFT; page++)
+        m_RAMDirty[page >> 5] |= 1u << (page & 31);
+}
+// The ROM handler of the HALT signal (ROM 001550) takes the descriptor of the latched address from the table
+// at HALT mode address 0160000 + address, filled by the OS. For a read, zero descriptor means trap to 4,
+// negative one means that the OS driver processes the read; for any other one the ROM does its time accounting
+// and returns to USER mode. Such reads are done without the HALT mode round trip.
+bool CMotherboard::IsPassiveEmulRead(uint16_t address) const
+{
+    if (!m_okEmulHLE || (m_PPIBrd & 3) != 3 || m_HR[0] != 0 || m_HR[1] != 0)
+        return false;  // Previous access is not processed yet
+    int addrtype;
+    uint16_t descriptor = GetWordView((uint16_t)(0160000 + address), true, false, &addrtype);
+    return addrtype <= ADDRTYPE_RAM4 && descriptor != 0 && (descriptor & 0100000) == 0;
+}
+
 uint16_t CMotherboard::GetWordView(uint16_t address, bool okHaltMode, bool okExec, int* pAddrType) const
 {
     uint32_t offset;
@@ -619,6 +941,10 @@ uint32_t CMotherboard::GetRAMFullAddress(uint16_t address, bool okHaltMode) cons
 
 uint16_t CMotherboard::GetWord(uint16_t address, bool okHaltMode, bool okExec)
 {
+    const MemoryWindow* pWindow = &m_MemoryMap[okHaltMode ? 1 : 0][address >> 13];
+    if (pWindow->pMemory != nullptr)  // Plain RAM or ROM
+        return *((uint16_t*)(pWindow->pMemory + (address & 017776)));
+
     uint32_t offset;
     int addrtype = TranslateAddress(address, okHaltMode, okExec, &offset);
     uint16_t res;
@@ -632,9 +958,18 @@ uint16_t CMotherboard::GetWord(uint16_t address, bool okHaltMode, bool okExec)
     case ADDRTYPE_ROM:
         return GetROMWord(offset & 0xfffe);
     case ADDRTYPE_IO:
+        m_nIOAccessCount++;
         //TODO: What to do if okExec == true ?
         return GetPortWord(address);
     case ADDRTYPE_EMUL:
+        m_nIOAccessCount++;
+        if (!okExec && IsPassiveEmulRead(address))
+        {
+            res = GetRAMWord(offset & 07776);
+            DebugLogFormat(_T("%c%06ho\tGETWORD %06ho EMUL HLE -> %06ho\n"), HU_INSTRUCTION_PC, address, res);
+            return res;
+        }
+        m_nChangeCount++;
         if ((m_PPIBrd & 1) == 1)  // EF0 inactive?
             m_HR[0] = address;
         else
@@ -645,6 +980,8 @@ uint16_t CMotherboard::GetWord(uint16_t address, bool okHaltMode, bool okExec)
         DebugLogFormat(_T("%c%06ho\tGETWORD %06ho EMUL -> %06ho\n"), HU_INSTRUCTION_PC, address, res);
         return res;
     case ADDRTYPE_DENY:
+        m_nIOAccessCount++;
+        m_nChangeCount++;
         DebugLogFormat(_T("%c%06ho\tGETWORD DENY %06ho\n"), HU_INSTRUCTION_PC, address);
         m_pCPU->MemoryError();
         return 0;
@@ -656,6 +993,10 @@ uint16_t CMotherboard::GetWord(uint16_t address, bool okHaltMode, bool okExec)
 
 uint8_t CMotherboard::GetByte(uint16_t address, bool okHaltMode)
 {
+    const MemoryWindow* pWindow = &m_MemoryMap[okHaltMode ? 1 : 0][address >> 13];
+    if (pWindow->pMemory != nullptr)  // Plain RAM or ROM
+        return pWindow->pMemory[address & 017777];
+
     uint32_t offset;
     int addrtype = TranslateAddress(address, okHaltMode, false, &offset);
     uint8_t resb;
@@ -669,9 +1010,18 @@ uint8_t CMotherboard::GetByte(uint16_t address, bool okHaltMode)
     case ADDRTYPE_ROM:
         return GetROMByte(offset & 0xffff);
     case ADDRTYPE_IO:
+        m_nIOAccessCount++;
         //TODO: What to do if okExec == true ?
         return GetPortByte(address);
     case ADDRTYPE_EMUL:
+        m_nIOAccessCount++;
+        if (IsPassiveEmulRead(address))
+        {
+            resb = GetRAMByte(offset & 07777);
+            DebugLogFormat(_T("%c%06ho\tGETBYTE %06ho EMUL HLE %03ho\n"), HU_INSTRUCTION_PC, address, resb);
+            return resb;
+        }
+        m_nChangeCount++;
         if ((m_PPIBrd & 1) == 1)  // EF0 inactive?
             m_HR[0] = address;
         else
@@ -682,6 +1032,8 @@ uint8_t CMotherboard::GetByte(uint16_t address, bool okHaltMode)
         DebugLogFormat(_T("%c%06ho\tGETBYTE %06ho EMUL %03ho\n"), HU_INSTRUCTION_PC, address, resb);
         return resb;
     case ADDRTYPE_DENY:
+        m_nIOAccessCount++;
+        m_nChangeCount++;
         DebugLogFormat(_T("%c%06ho\tGETBYTE DENY (%06ho)\n"), HU_INSTRUCTION_PC, address);
         m_pCPU->MemoryError();
         return 0;
@@ -694,6 +1046,7 @@ uint8_t CMotherboard::GetByte(uint16_t address, bool okHaltMode)
 void CMotherboard::SetWord(uint16_t address, bool okHaltMode, uint16_t word, bool isRMW)
 {
     address &= ~1;
+    m_nChangeCount++;
 
     uint32_t offset;
     int addrtype = TranslateAddress(address, okHaltMode, false, &offset);
@@ -714,12 +1067,14 @@ void CMotherboard::SetWord(uint16_t address, bool okHaltMode, uint16_t word, boo
         //m_pCPU->MemoryError();
         return;
     case ADDRTYPE_IO:
+        m_nIOAccessCount++;
         SetPortWord(address, word);
         return;
     case ADDRTYPE_EMUL:
+        m_nIOAccessCount++;
         DebugLogFormat(_T("%c%06ho\tSETWORD %06ho -> (%06ho) EMUL\n"), HU_INSTRUCTION_PC, word, address);
         SetRAMWord(offset & 07777, word);
-        if (!isRMW)
+        if (!isRMW || (m_PPIBrd & 1) == 1)  // Read of RMW not latched, see IsPassiveEmulRead()
         {
             if ((m_PPIBrd & 1) == 1)  // EF0 inactive?
                 m_HR[0] = address;
@@ -730,6 +1085,7 @@ void CMotherboard::SetWord(uint16_t address, bool okHaltMode, uint16_t word, boo
         m_pCPU->SetHALTPin(true);
         return;
     case ADDRTYPE_DENY:
+        m_nIOAccessCount++;
         DebugLogFormat(_T("%c%06ho\tSETWORD DENY (%06ho)\n"), HU_INSTRUCTION_PC, address);
         m_pCPU->MemoryError();
         return;
@@ -740,6 +1096,7 @@ void CMotherboard::SetWord(uint16_t address, bool okHaltMode, uint16_t word, boo
 
 void CMotherboard::SetByte(uint16_t address, bool okHaltMode, uint8_t byte, bool isRMW)
 {
+    m_nChangeCount++;
     uint32_t offset;
     int addrtype = TranslateAddress(address, okHaltMode, false, &offset);
 
@@ -759,12 +1116,14 @@ void CMotherboard::SetByte(uint16_t address, bool okHaltMode, uint8_t byte, bool
         //m_pCPU->MemoryError();
         return;
     case ADDRTYPE_IO:
+        m_nIOAccessCount++;
         SetPortByte(address, byte);
         return;
     case ADDRTYPE_EMUL:
+        m_nIOAccessCount++;
         DebugLogFormat(_T("%c%06ho\tSETBYTE %03o -> (%06ho) EMUL\n"), HU_INSTRUCTION_PC, byte, address);
         SetRAMByte(offset & 07777, byte);
-        if (!isRMW)
+        if (!isRMW || (m_PPIBrd & 1) == 1)  // Read of RMW not latched, see IsPassiveEmulRead()
         {
             if ((m_PPIBrd & 1) == 1)  // EF0 inactive?
                 m_HR[0] = address;
@@ -775,6 +1134,7 @@ void CMotherboard::SetByte(uint16_t address, bool okHaltMode, uint8_t byte, bool
         m_pCPU->SetHALTPin(true);
         return;
     case ADDRTYPE_DENY:
+        m_nIOAccessCount++;
         DebugLogFormat(_T("%c%06ho\tSETBYTE DENY (%06ho)\n"), HU_INSTRUCTION_PC, address);
         m_pCPU->MemoryError();
         return;
@@ -783,8 +1143,57 @@ void CMotherboard::SetByte(uint16_t address, bool okHaltMode, uint8_t byte, bool
     ASSERT(false);  // If we are here - then addrtype has invalid value
 }
 
+// Fill the address translation table from HR/UR; windows with I/O ports, denied or partly missing memory
+// are left to TranslateAddress()
+void CMotherboard::UpdateMemoryMap()
+{
+    for (int mode = 0; mode < 2; mode++)
+    {
+        const uint16_t* pMemRegs = (mode == 0) ? m_UR : m_HR;
+        for (int memregno = 0; memregno < 8; memregno++)
+        {
+            MemoryWindow* pWindow = &m_MemoryMap[mode][memregno];
+            pWindow->pMemory = nullptr;
+            pWindow->offset = 0;
+            pWindow->addrtype = ADDRTYPE_DENY;
+
+            if (memregno == 7)  // 160000-177777: I/O ports, emulated registers
+                continue;
+            // 000000-037777 in HALT mode: ROM, so HR0/HR1 are free to latch EMUL addresses
+            if (mode == 1 && memregno < 2)
+            {
+                pWindow->offset = memregno * 020000;
+                pWindow->pMemory = m_pROM + pWindow->offset;
+                pWindow->addrtype = ADDRTYPE_ROM;
+                continue;
+            }
+
+            uint16_t memreg = pMemRegs[memregno];
+            if (memreg & 8)  // Запрет доступа к ОЗУ
+                continue;
+            uint32_t offset = ((uint32_t)(memreg & 037760)) << 8;
+            if (offset + 020000 > m_nRamSizeBytes)
+                continue;
+            pWindow->offset = offset;
+            pWindow->pMemory = m_pRAM + offset;
+            uint16_t maskmode = memreg & 3;
+            if (maskmode == 0)
+                pWindow->addrtype = ADDRTYPE_RAM;
+            else
+                pWindow->addrtype = (maskmode & 2) == 0 ? ADDRTYPE_RAM2 : ADDRTYPE_RAM4;
+        }
+    }
+}
+
 int CMotherboard::TranslateAddress(uint16_t address, bool okHaltMode, bool /*okExec*/, uint32_t* pOffset) const
 {
+    const MemoryWindow* pWindow = &m_MemoryMap[okHaltMode ? 1 : 0][address >> 13];
+    if (pWindow->pMemory != nullptr)
+    {
+        *pOffset = pWindow->offset + (address & 017777);
+        return pWindow->addrtype;
+    }
+
     if (okHaltMode && address < 040000)
     {
         *pOffset = address;
@@ -865,10 +1274,12 @@ uint16_t CMotherboard::GetPortWord(uint16_t address)
         return resb;
 
     case 0161010: case 0161012: case 0161014: case 0161016:
+        m_nChangeCount++;  // Counter value changes in time
         resb = ProcessTimerRead(address);
         DebugLogFormat(_T("%c%06ho\tGETPORT %06ho SND -> 0x%02hx\n"), HU_INSTRUCTION_PC, address, (uint16_t)resb);
         return resb;
     case 0161020: case 0161022: case 0161024: case 0161026:
+        m_nChangeCount++;
         resb = ProcessTimerRead(address);
         DebugLogFormat(_T("%c%06ho\tGETPORT %06ho SNL -> 0x%02hx\n"), HU_INSTRUCTION_PC, address, (uint16_t)resb);
         return resb;
@@ -888,6 +1299,7 @@ uint16_t CMotherboard::GetPortWord(uint16_t address)
         return m_PPIC;
 
     case 0161040:
+        m_nChangeCount++;
         if (m_HDbuffdir)  // Buffer in write mode
             result = 0;
         else
@@ -919,12 +1331,15 @@ uint16_t CMotherboard::GetPortWord(uint16_t address)
         return m_hdcnum >> 8;
     case 0161054:  // HD.SDH
         DebugLogFormat(_T("%c%06ho\tGETPORT %06ho HD.SDH\n"), HU_INSTRUCTION_PC, address);
+        m_nChangeCount++;
         m_HDbuffdir = true;  // Обращение к HD.SDH переводит буфер в режим записи
         return m_hdsdh;
     case 0161056:  // HD.CSR
         DebugLogFormat(_T("%c%06ho\tGETPORT %06ho HD.CSR\n"), HU_INSTRUCTION_PC, address);
+        m_nChangeCount++;
         m_HDbuffdir = false;  // Обращение к HD.CSR переводит буфер в режим чтения
         m_hdint = false;
+        UpdateInterrupts();
         return 0x41;
 
     case 0161060:  // DLBUF
@@ -948,8 +1363,12 @@ uint16_t CMotherboard::GetPortWord(uint16_t address)
         DebugLogFormat(_T("%c%06ho\tGETPORT %06ho FD.CSR -> 0x%02hx\n"), HU_INSTRUCTION_PC, address, (uint16_t)resb);
         return resb;
     case 0161072:  // FD.BUF
+        m_nChangeCount++;
         if ((m_hdsdh & 010) == 0)
+        {
             resb = m_pFloppyCtl->FifoRead();
+            UpdateInterrupts();
+        }
         else
             resb = 0;
         DebugLogFormat(_T("%c%06ho\tGETPORT %06ho FD.BUF -> 0x%02hx\n"), HU_INSTRUCTION_PC, address, (uint16_t)resb);
@@ -959,6 +1378,7 @@ uint16_t CMotherboard::GetPortWord(uint16_t address)
         return 0;
 
     case 0161120: case 0161122: case 0161124: case 0161126: case 0161130: case 0161132: case 0161134: case 0161136:
+        m_nChangeCount++;
         result = GetHardPortWord(address);
         //DebugLogFormat(_T("%c%06ho\tGETPORT %06ho IDE %03hx -> 0x%04hx\n"), HU_INSTRUCTION_PC, address, (uint16_t)((address >> 1) & 7) | 0x1f0, result);
         return result;
@@ -996,6 +1416,7 @@ uint16_t CMotherboard::GetPortWord(uint16_t address)
     case 0161450: case 0161451: case 0161452: case 0161453: case 0161454: case 0161455: case 0161456: case 0161457:
     case 0161460: case 0161461: case 0161462: case 0161463: case 0161464: case 0161465: case 0161466: case 0161467:
     case 0161470: case 0161471: case 0161472: case 0161473: case 0161474: case 0161475: case 0161476: case 0161477:
+        m_nChangeCount++;  // Real time
         result = ProcessRtcRead(address);
         DebugLogFormat(_T("%c%06ho\tGETPORT %06ho RTC -> %06ho\n"), HU_INSTRUCTION_PC, address, result);
         return result;
@@ -1005,6 +1426,7 @@ uint16_t CMotherboard::GetPortWord(uint16_t address)
         // "Неиспользуемые" регистры в диапазоне 161000-161776 при запросе отдают младший байт адреса
         if (address >= 0161000 && address < 0162000)
             return address & 0x00ff;
+        m_nChangeCount++;
         m_pCPU->MemoryError();
         return 0;
     }
@@ -1160,6 +1582,7 @@ void CMotherboard::SetPortWord(uint16_t address, uint16_t word)
         m_PPIC = word & 0xff;
         m_PPIBrd = (m_PPIBrd & ~8) | ((m_PPIC & 4) == 0 ? 0 : 8);  // PC2(IHLT) -> PB3
         m_pCPU->SetVIRQ((m_PPIC & 010) == 0);
+        UpdateHALTPin();
         break;
     case 0161036:  // PPIP -- Parallel port mode control
         DebugLogFormat(_T("%c%06ho\tSETPORT %06ho -> (%06ho) PPIP\n"), HU_INSTRUCTION_PC, word, address);
@@ -1209,7 +1632,10 @@ void CMotherboard::SetPortWord(uint16_t address, uint16_t word)
         m_HDbuffdir = false;  // Обращение к HD.CSR переводит буфер в режим чтения
         //NOTE: Контроллер винчестера не реализован, но он должен отдать сигнал на прерывание в ответ на команду RESTORE
         if (word == 020)  // RESTORE
+        {
             m_hdint = true;
+            UpdateInterrupts();
+        }
         break;
 
     case 0161060:  // DLBUF
@@ -1232,14 +1658,20 @@ void CMotherboard::SetPortWord(uint16_t address, uint16_t word)
     case 0161072:  // FD.BUF
         DebugLogFormat(_T("%c%06ho\tSETPORT %06ho -> (%06ho) FD.BUF\n"), HU_INSTRUCTION_PC, word, address);
         if ((m_hdsdh & 010) == 0)
+        {
             m_pFloppyCtl->FifoWrite(word & 0xff);
+            UpdateInterrupts();
+        }
         break;
     case 0161076:  // FD.CNT
         DebugLogFormat(_T("%c%06ho\tSETPORT %06ho -> (%06ho) FD.CNT\n"), HU_INSTRUCTION_PC, word, address);
         m_nHDbuff = (word & 3);
         m_nHDbuffpos = 0;
         if (word & 020) // reset floppy controller
+        {
             m_pFloppyCtl->Reset();
+            UpdateInterrupts();
+        }
         break;
 
     case 0161120: case 0161122: case 0161124: case 0161126: case 0161130: case 0161132: case 0161134: case 0161136:
@@ -1255,8 +1687,12 @@ void CMotherboard::SetPortWord(uint16_t address, uint16_t word)
                 m_pCPU->MemoryError();  // Запись HR в режиме USER запрещена
             int chunk = (address >> 1) & 7;
             m_HR[chunk] = word;
+            UpdateMemoryMap();
             if (m_pCPU->IsHaltMode() && (chunk == 0 || chunk == 1))  // Запись HR0 или HR1 в режиме HALT
+            {
                 m_PPIBrd |= 3;  // Снимаем EF0 и EF1
+                UpdateHALTPin();
+            }
             break;
         }
 
@@ -1266,6 +1702,7 @@ void CMotherboard::SetPortWord(uint16_t address, uint16_t word)
             DebugLogFormat(_T("%c%06ho\tSETPORT UR %06ho -> (%06ho)\n"), HU_INSTRUCTION_PC, word, address);
             int chunk = (address >> 1) & 7;
             m_UR[chunk] = word;
+            UpdateMemoryMap();
             break;
         }
 
@@ -1319,11 +1756,12 @@ void CMotherboard::ProcessPICWrite(bool a, uint8_t byte)
         {
             //NOTE: Мы знаем что для Союз-Неон ICW2 = 000
             m_PICflags = 0;  // READY now
+            UpdateInterrupts();  // Latch the lines that are already active
         }
         else if (mode == 0)  // READY - set mask
         {
             m_PICMR = byte;
-            UpdateInterrupts();
+            UpdateHALTPin();
         }
     }
 }
@@ -1377,10 +1815,17 @@ void CMotherboard::SetPICInterrupt(int signal, bool set)
     }
 }
 
+// Device interrupt lines are levels; call on every change of the floppy, HDD or keyboard interrupt flag
 void CMotherboard::UpdateInterrupts()
 {
     SetPICInterrupt(1, m_pFloppyCtl->CheckInterrupt() || m_hdint);
     SetPICInterrupt(4, m_keyint);
+    UpdateHALTPin();
+}
+
+// Call on every change of PICRR, PICMR or PPIB
+void CMotherboard::UpdateHALTPin()
+{
     bool ioint = ((m_PICRR & ~m_PICMR) != 0);
     m_PPIBrd = (m_PPIBrd & ~4) | (ioint ? 4 : 0);  // Update PB2(IOINT) signal
     m_pCPU->SetHALTPin((m_PPIBrd & 11) != 11 || ioint);  // EF0 EF1, IHLT or IOINT
@@ -1575,6 +2020,7 @@ void CMotherboard::LoadFromImage(const uint8_t* pImage)
     pwImage += sizeof(m_HR) / 2;
     memcpy(m_UR, pwImage, sizeof(m_UR));  // 32 bytes
     pwImage += 8 / 2;  // RESERVED
+    UpdateMemoryMap();
     // HDD controller
     m_hdsdh = *pwImage++;
     m_hdscnt = (uint8_t) * pwImage++;
@@ -1617,6 +2063,7 @@ void CMotherboard::LoadFromImage(const uint8_t* pImage)
     // CPU status
     const uint8_t* pImageCPU = pImage + 432;
     m_pCPU->LoadFromImage(pImageCPU);
+    UpdateInterrupts();
     // HD buffers 2K
     const uint8_t* pImageBuffer2K = pImage + 512;
     memcpy(m_pHDbuff, pImageBuffer2K, 2048);
@@ -1626,19 +2073,22 @@ void CMotherboard::LoadFromImage(const uint8_t* pImage)
     // RAM
     const uint8_t* pImageRam = pImage + 20480;
     memcpy(m_pRAM, pImageRam, m_nRamSizeBytes);
+    ::memset(m_RAMDirty, 0xff, sizeof(m_RAMDirty));
+
+    m_pCPU->FlushDecodeCache();
 }
 
 
 //////////////////////////////////////////////////////////////////////
 
-void CMotherboard::DoSound(uint16_t s0, uint16_t s1, uint16_t s2)
+void CMotherboard::DoSound(int count)
 {
     if (m_SoundGenCallback == nullptr)
         return;
 
-    uint16_t sound = (s0 + s1 + s2) * 21;
-
-    (*m_SoundGenCallback)(sound, sound);
+    const uint16_t* samples = m_soundblep.GetSamples();
+    for (int i = 0; i < count; i++)
+        (*m_SoundGenCallback)(samples[i], samples[i]);
 }
 
 void CMotherboard::SetSoundGenCallback(SOUNDGENCALLBACK callback)
@@ -1653,6 +2103,12 @@ void CMotherboard::SetSoundGenCallback(SOUNDGENCALLBACK callback)
     }
 }
 
+void CMotherboard::SetSoundSampleRate(int rate)
+{
+    m_soundblep.SetSampleRate(rate);
+    m_soundlevel = 0;
+}
+
 void CMotherboard::SetSerialOutCallback(SERIALOUTCALLBACK outcallback)
 {
     m_SerialOutCallback = outcallback;
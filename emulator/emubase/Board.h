@@ -48,6 +48,13 @@ enum NeonConfiguration
 #define FLOPPY_FSM_WAITFORTERM1 2
 #define FLOPPY_FSM_WAITFORTERM2 3
 
+// Device events of SystemFrame(), in the order of processing at the same CPU tick
+#define DEVEVENT_TICK50     0   // 50 Hz timer
+#define DEVEVENT_FLOPPY     1   // Floppy controller periodic work
+#define DEVEVENT_HARD       2   // IDE hard drive periodic work
+#define DEVEVENT_COUNT      3
+#define DEVEVENT_NEVER      0x7fffffff  // No event for the device
+
 // Trace flags
 #define TRACE_NONE         0  // Turn off all tracing
 #define TRACE_FLOPPY    0100  // Trace floppies
@@ -65,6 +72,9 @@ enum NeonConfiguration
 #define PIC_MODE_MASK    255  // Mask for mode bits, usage: (m_PICflags & PIC_MODE_MASK)
 #define PIC_CMD_POLL     256  // Flag for Poll Command
 
+// Idle loop detection
+#define IDLE_LOOP_MAX_TICKS  1024  // Max length of the polling loop, in CPU ticks
+
 
 //////////////////////////////////////////////////////////////////////
 // Special key codes
@@ -81,6 +91,11 @@ typedef void (CALLBACK* PARALLELOUTCALLBACK)(uint8_t byte);
 
 //////////////////////////////////////////////////////////////////////
 
+#define RAMDIRTY_PAGE_SHIFT 8   // RAM write tracking for the video renderer by 256-byte pages, see IsRAMDirty()
+#define RAMDIRTY_SIZE       (4096 * 1024 / 256 / 32)  // Bitmap words for the max RAM size
+
+#define PIT_NEVER   0xffffffffu  // No output change, see PIT8253::GetOutputChangeTicks()
+
 struct PIT8253_chan
 {
     uint8_t     control;    // Control byte
@@ -107,12 +122,41 @@ public:
     void        SetGate(uint8_t chan, bool gate);
     void        Tick();
     bool        GetOutput(uint8_t chan) const;
+    uint32_t    GetOutputChangeTicks(uint8_t channel, bool gate) const;
+    void        Advance(uint8_t channel, bool gate, uint32_t ticks);
 private:
     void        Tick(uint8_t channel);
 };
 
 //////////////////////////////////////////////////////////////////////
 
+#define SOUNDBLEP_FRAMETICKS    80000   // Timer ticks in the frame, 2 MHz
+#define SOUNDBLEP_MAXRATE       96000   // Max output sample rate
+#define SOUNDBLEP_WIDTH         16      // Band-limited step length, samples
+#define SOUNDBLEP_PHASES        32      // Band-limited step sub-sample positions
+#define SOUNDBLEP_BITS          14      // Band-limited step fixed point precision
+
+// Band-limited synthesis of the level steps: the steps add up in the buffer, the frame end integrates the buffer
+class SoundBlep
+{
+    int         m_rate;         // Output sample rate, a multiple of 25
+    int         m_framesamples; // Output samples in the frame
+    int32_t     m_level;        // Integrator of the buffer
+    int32_t     m_kernel[SOUNDBLEP_PHASES][SOUNDBLEP_WIDTH];
+    int32_t     m_buffer[SOUNDBLEP_MAXRATE / 25 + SOUNDBLEP_WIDTH];
+    uint16_t    m_samples[SOUNDBLEP_MAXRATE / 25];
+public:
+    SoundBlep();
+    void        SetSampleRate(int rate);
+    int         GetSampleRate() const { return m_rate; }
+    void        Clear();
+    void        AddDelta(uint32_t time, int delta);  // Level step at the timer tick in the frame
+    int         EndFrame(uint32_t time);  // Render the samples up to the timer tick in the frame, returns the count
+    const uint16_t* GetSamples() const { return m_samples; }
+};
+
+//////////////////////////////////////////////////////////////////////
+
 // Soyuz-Neon computer
 class CMotherboard
 {
@@ -133,21 +177,59 @@ private:  // Memory
     uint16_t    m_UR[8];
     uint32_t    m_nRamSizeBytes;  // Actual RAM size
     uint8_t*    m_pHDbuff;  // HD buffers, 2K
+    uint32_t    m_nIOAccessCount;  // Counter of I/O, emulated registers and denied memory accesses
+    uint32_t    m_nChangeCount;  // Counter of memory writes and port reads with side effects
+    bool        m_okEmulHLE;  // Serve passive reads of the emulated registers in USER mode, see IsPassiveEmulRead()
+    // Address translation for 8 KB window, see UpdateMemoryMap()
+    struct MemoryWindow
+    {
+        uint8_t*    pMemory;    // Window start in RAM or ROM, nullptr when TranslateAddress() does the work
+        uint32_t    offset;     // Window start offset in RAM or ROM
+        int         addrtype;   // ADDRTYPE_RAM, ADDRTYPE_RAM2, ADDRTYPE_RAM4 or ADDRTYPE_ROM
+    };
+    MemoryWindow m_MemoryMap[2][8];  // Windows for USER mode [0] and HALT mode [1]
+    void        UpdateMemoryMap();  // Call on every change of HR/UR or RAM
+    uint32_t    m_RAMDirty[RAMDIRTY_SIZE];  // RAM pages written since ClearRAMDirty(), one bit per page
+    void        SetRAMDirty(uint32_t offset)
+    {
+        uint32_t page = offset >> RAMDIRTY_PAGE_SHIFT;
+        m_RAMDirty[page >> 5] |= 1u << (page & 31);
+    }
+    void        SetRAMDirty(uint32_t offset, uint32_t size);
 public:  // Memory access
     uint16_t    GetRAMWord(uint32_t offset) const;
     uint8_t     GetRAMByte(uint32_t offset) const;
-    void        SetRAMWord(uint32_t offset, uint16_t word) { *((uint16_t*)(m_pRAM + offset)) = word; }
+    void        SetRAMWord(uint32_t offset, uint16_t word);
     void        SetRAMWord2(uint32_t offset, uint16_t word);
     void        SetRAMWord4(uint32_t offset, uint16_t word);
-    void        SetRAMByte(uint32_t offset, uint8_t byte) { m_pRAM[offset] = byte; }
+    void        SetRAMByte(uint32_t offset, uint8_t byte);
     void        SetRAMByte2(uint32_t offset, uint8_t byte);
     void        SetRAMByte4(uint32_t offset, uint8_t byte);
     uint16_t    GetROMWord(uint16_t offset) const;
     uint8_t     GetROMByte(uint16_t offset) const;
     uint32_t    GetRamSizeBytes() const { return m_nRamSizeBytes; }
+    // Memory type for address..address+size-1 when it is RAM inside one 8 KB window, otherwise -1
+    int         GetRAMBlockType(uint16_t address, uint16_t size, bool okHaltMode, uint32_t* pOffset) const;
+    // Copy forward word by word or byte by byte, as MOV(B) (R1)+,(R2)+ loop does; returns the last value
+    uint16_t    CopyRAMBlock(uint32_t dstoffset, int dsttype, uint32_t srcoffset, uint32_t size, bool okByte);
+    // Write zeroes as CLR(B) (R1)+ loop does
+    void        ClearRAMBlock(uint32_t offset, int addrtype, uint32_t size);
+    uint32_t    GetIOAccessCount() const { return m_nIOAccessCount; }
+public:  // Emulated registers 0174000..0177677
+    void        SetEmulHLE(bool okEmulHLE) { m_okEmulHLE = okEmulHLE; }
+    bool        IsEmulHLE() const { return m_okEmulHLE; }
+    // Check if the ROM would do nothing but the HALT mode round trip on USER mode read of the register
+    bool        IsPassiveEmulRead(uint16_t address) const;
 public:  // Debug
     void        DebugTicks();  // One Debug CPU tick -- use for debug step or debug breakpoint
-    void        SetCPUBreakpoints(const uint16_t* bps) { m_CPUbps = bps; } // Set CPU breakpoint list
+    void        SetCPUBreakpoint(uint16_t address);  // Stop SystemFrame() before the instruction at the address
+    void        SetCPUBreakpointRange(uint16_t start, uint16_t end);  // Breakpoint at every word of start..end
+    void        ClearCPUBreakpoints();
+    bool        HasCPUBreakpoints() const { return m_okCPUbps; }
+    bool        IsCPUBreakpoint(uint16_t address) const
+    {
+        return (m_pCPUbps[address >> 6] & (1u << ((address >> 1) & 31))) != 0;
+    }
     uint32_t    GetTrace() const { return m_dwTrace; }
     void        SetTrace(uint32_t dwTrace);
     void        LoadRAMBank(int bank, const void* buffer);
@@ -158,6 +240,7 @@ public:  // System control
     void        Reset();  // Reset computer
     void        Tick50();           // Tick 50 Hz
     void        TimerTick();        // Timer Tick
+    void        UpdateTimer(int procticks);  // Timer ticks before the CPU tick in the frame
     void        ResetDevices();     // INIT signal
     bool        SystemFrame();  // Do one frame -- use for normal run
     void        UpdateKeyboardMatrix(const uint8_t matrix[8]);
@@ -186,6 +269,8 @@ public:  // IDE HDD
     void        SetHardPortWord(uint16_t port, uint16_t data);  // To use from CMotherboard only
 public:  // Callbacks
     void        SetSoundGenCallback(SOUNDGENCALLBACK callback);
+    void        SetSoundSampleRate(int rate);  // Output sample rate for the sound callback, a multiple of 25
+    int         GetSoundSampleRate() const { return m_soundblep.GetSampleRate(); }
     void        SetSerialOutCallback(SERIALOUTCALLBACK outcallback);
     void        SetParallelOutCallback(PARALLELOUTCALLBACK outcallback);
 public:  // Memory
@@ -204,6 +289,11 @@ public:  // Memory
     // Read word from memory for video renderer and debugger
     uint8_t GetRAMByteView(uint32_t offset) const;
     uint16_t GetRAMWordView(uint32_t offset) const;
+    // Read-only RAM span for video renderer; nullptr when the span is not all in RAM
+    const uint8_t* GetRAMSpanView(uint32_t offset, uint32_t size) const;
+    // RAM write tracking for video renderer: any write to the span since the last ClearRAMDirty()
+    bool IsRAMDirty(uint32_t offset, uint32_t size) const;
+    void ClearRAMDirty() { ::memset(m_RAMDirty, 0, sizeof(m_RAMDirty)); }
     uint16_t GetWordView(uint16_t address, bool okHaltMode, bool okExec, int* pAddrType) const;
     uint32_t GetRAMFullAddress(uint16_t address, bool okHaltMode) const;
     // Read word from port for debugger
@@ -249,16 +339,45 @@ private:
     void        ProcessPICWrite(bool a, uint8_t byte);
     uint8_t     ProcessPICRead(bool a);
     void        SetPICInterrupt(int signal, bool set = true);  // Set/reset PIC interrupt signal 0..7
-    void        UpdateInterrupts();
+    void        UpdateInterrupts();  // Device interrupt lines to PIC, then UpdateHALTPin()
+    void        UpdateHALTPin();  // PB2(IOINT) and the CPU HALT signal
     uint8_t     ProcessRtcRead(uint16_t address) const;
     void        ProcessRtcWrite(uint16_t address, uint8_t byte);
     void        ProcessTimerWrite(uint16_t address, uint8_t byte);
     uint8_t     ProcessTimerRead(uint16_t address);
     void        ProcessKeyboardWrite(uint8_t byte);
     void        ProcessMouseWrite(uint8_t byte);
-    void        DoSound(uint16_t s0, uint16_t s1, uint16_t s2);
+    void        DoSound(int count);
+    // SystemFrame() body, with the trace and breakpoint checks compiled in only when needed
+    template<bool okTrace, bool okBreakpoints> bool SystemFrameLoop();
+private:  // Idle loop detection, see SystemFrame()
+    struct IdleState
+    {
+        uint16_t    regs[8];
+        uint16_t    psw, cpc, cpsw;
+        uint16_t    keypos;
+        uint32_t    changecount;
+    };
+    IdleState   m_idlestate;    // Machine state at the start of the polling loop candidate
+    int         m_idletick;     // CPU tick in the frame for m_idlestate, -1 = no candidate
+    uint32_t    m_idleiocount;  // I/O access counter at the previous instruction boundary
+    void        GetIdleState(IdleState* pState) const;
+    int         SkipIdleLoop(int procticks);
+private:  // Device scheduler, see SystemFrame()
+    int         m_devdeadline[DEVEVENT_COUNT];  // CPU tick in the frame of the next device event
+    int         m_devnext;          // Nearest device deadline
+    int         m_procticks;        // CPU tick in the frame of the current instruction
+    int         m_timertick;        // CPU tick in the frame of the next timer tick, every 4th CPU tick
+    int         m_soundlevel;       // Sound level by the SNL channel outputs
+    SoundBlep   m_soundblep;        // Sound level steps of the frame
+    void        ScheduleDevices();
+    void        ScheduleHardDrive();
+    void        RunDeviceEvents(int procend);
+    void        AdvanceTimer(uint32_t time, uint32_t ticks);
+    int         GetSoundLevel() const;
 private:
-    const uint16_t* m_CPUbps;  // CPU breakpoint list, ends with 177777 value
+    uint32_t*   m_pCPUbps;  // CPU breakpoint bitmap, one bit per word address
+    bool        m_okCPUbps;  // Any CPU breakpoint set
     uint32_t    m_dwTrace;  // Trace flags
 private:
     SOUNDGENCALLBACK m_SoundGenCallback;
@@ -19,7 +19,7 @@ NEONBTL. If not, see <http://www.gnu.org/licenses/>. */
 //////////////////////////////////////////////////////////////////////
 
 
-#define SOUNDSAMPLERATE  22050
+#define SOUNDSAMPLERATE  44100  // Default sound output sample rate, see CMotherboard::SetSoundSampleRate()
 
 
 //////////////////////////////////////////////////////////////////////
@@ -209,6 +209,8 @@ public:
     void WritePort(uint16_t port, uint16_t data);
     // Rotate disk
     void Periodic();
+    // Periodic() calls till the next event, 0 = no event, Periodic() does nothing
+    int GetTimeoutCount() const { return m_timeoutcount; }
 
 private:
     uint32_t CalculateOffset() const;  // Calculate sector offset in the HDD image
@@ -12,6 +12,9 @@ NEONBTL. If not, see <http://www.gnu.org/licenses/>. */
 
 #include "stdafx.h"
 #include "Processor.h"
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 
 // Timings ///////////////////////////////////////////////////////////
@@ -169,6 +172,7 @@ uint16_t SOB_LAST_TIMING = 0x000E;  // last iteration of SOB
 uint16_t BR_TIMING = 0x001C;
 uint16_t MARK_TIMING = 0x0030;
 uint16_t RESET_TIMING = 1000;
+uint16_t FIS_TIMING = 0x0080;  // Native FIS, the ROM routine takes 1000..1800 ticks
 
 static uint16_t GetInstructionTiming12x12(const uint16_t timings[12][12], uint16_t instruction)
 {
@@ -192,137 +196,295 @@ static uint16_t GetInstructionTiming12x12(const uint16_t timings[12][12], uint16
     return timings[methsrc][methdst];
 }
 
+// Timing for two-operand instruction, or 0 for other instructions
+static uint16_t GetInstructionTiming(uint16_t instruction)
+{
+    switch (instruction & 0170000)
+    {
+    case 0010000:  // MOV
+        return GetInstructionTiming12x12(MOV_TIMING, instruction);
+    case 0110000: case 0140000: case 0150000:  // MOVB, BICB, BISB
+        return GetInstructionTiming12x12(MOVB_TIMING, instruction);
+    case 0020000: case 0030000:  // CMP, BIT
+        return GetInstructionTiming12x12(BIT_TIMING, instruction);
+    case 0120000: case 0130000:  // CMPB, BITB
+        return GetInstructionTiming12x12(BITB_TIMING, instruction);
+    case 0040000: case 0050000: case 0060000: case 0160000:  // BIC, BIS, ADD, SUB
+        return GetInstructionTiming12x12(ADD_TIMING, instruction);
+    default:
+        return 0;
+    }
+}
+
 
 //////////////////////////////////////////////////////////////////////
 
 
-CProcessor::ExecuteMethodRef* CProcessor::m_pExecuteMethodMap = nullptr;
-
-#define RegisterMethodOpc(/*uint16_t*/ opcode, /*CProcessor::ExecuteMethodRef*/ methodref) \
-    { m_pExecuteMethodMap[opcode] = (methodref); }
-
-#define RegisterMethodRef(/*uint16_t*/ opstart, /*uint16_t*/ opend, /*CProcessor::ExecuteMethodRef*/ methodref) \
-    { \
-        for (uint32_t opcode = (opstart); opcode <= (opend); opcode++) \
-            m_pExecuteMethodMap[opcode] = (methodref); \
-    }
-
-void CProcessor::Init()
-{
-    ASSERT(m_pExecuteMethodMap == nullptr);
-    m_pExecuteMethodMap = static_cast<CProcessor::ExecuteMethodRef*>(::calloc(65536, sizeof(CProcessor::ExecuteMethodRef)));
-
-    // Сначала заполняем таблицу ссылками на метод ExecuteUNKNOWN, выполняющий TRAP 10
-    RegisterMethodRef( 0000000, 0177777, &CProcessor::ExecuteUNKNOWN )
-
-    RegisterMethodOpc( 0000000, &CProcessor::ExecuteHALT )
-    RegisterMethodOpc( 0000001, &CProcessor::ExecuteWAIT )
-    RegisterMethodOpc( 0000002, &CProcessor::ExecuteRTI )
-    RegisterMethodOpc( 0000003, &CProcessor::ExecuteBPT )
-    RegisterMethodOpc( 0000004, &CProcessor::ExecuteIOT )
-    RegisterMethodOpc( 0000005, &CProcessor::ExecuteRESET )
-    RegisterMethodOpc( 0000006, &CProcessor::ExecuteRTT )
-
-    RegisterMethodRef( 0000010, 0000013, &CProcessor::ExecuteRUN )
-    RegisterMethodRef( 0000014, 0000017, &CProcessor::ExecuteSTEP )
-    RegisterMethodOpc( 0000020,          &CProcessor::ExecuteRSEL)
-    RegisterMethodOpc( 0000021,          &CProcessor::ExecuteMFUS)
-    RegisterMethodRef( 0000022, 0000023, &CProcessor::ExecuteRCPC)
-    RegisterMethodRef( 0000024, 0000027, &CProcessor::ExecuteRCPS)
-    RegisterMethodOpc( 0000030,          &CProcessor::ExecuteRSEL)
-    RegisterMethodOpc( 0000031,          &CProcessor::ExecuteMTUS)
-    RegisterMethodRef( 0000032, 0000033, &CProcessor::ExecuteWCPC)
-    RegisterMethodRef( 0000034, 0000037, &CProcessor::ExecuteWCPS)
-
-    RegisterMethodRef( 0000100, 0000177, &CProcessor::ExecuteJMP)
-    RegisterMethodRef( 0000200, 0000207, &CProcessor::ExecuteRTS)  // RTS / RETURN
-
-    RegisterMethodRef( 0000240, 0000257, &CProcessor::ExecuteCCC)
-
-    RegisterMethodRef( 0000260, 0000277, &CProcessor::ExecuteSCC)
-
-    RegisterMethodRef( 0000300, 0000377, &CProcessor::ExecuteSWAB)
-
-    RegisterMethodRef( 0000400, 0000777, &CProcessor::ExecuteBR)
-    RegisterMethodRef( 0001000, 0001377, &CProcessor::ExecuteBNE)
-    RegisterMethodRef( 0001400, 0001777, &CProcessor::ExecuteBEQ)
-    RegisterMethodRef( 0002000, 0002377, &CProcessor::ExecuteBGE)
-    RegisterMethodRef( 0002400, 0002777, &CProcessor::ExecuteBLT)
-    RegisterMethodRef( 0003000, 0003377, &CProcessor::ExecuteBGT)
-    RegisterMethodRef( 0003400, 0003777, &CProcessor::ExecuteBLE)
-
-    RegisterMethodRef( 0004000, 0004777, &CProcessor::ExecuteJSR)  // JSR / CALL
-
-    RegisterMethodRef( 0005000, 0005077, &CProcessor::ExecuteCLR)
-    RegisterMethodRef( 0005100, 0005177, &CProcessor::ExecuteCOM)
-    RegisterMethodRef( 0005200, 0005277, &CProcessor::ExecuteINC)
-    RegisterMethodRef( 0005300, 0005377, &CProcessor::ExecuteDEC)
-    RegisterMethodRef( 0005400, 0005477, &CProcessor::ExecuteNEG)
-    RegisterMethodRef( 0005500, 0005577, &CProcessor::ExecuteADC)
-    RegisterMethodRef( 0005600, 0005677, &CProcessor::ExecuteSBC)
-    RegisterMethodRef( 0005700, 0005777, &CProcessor::ExecuteTST)
-    RegisterMethodRef( 0006000, 0006077, &CProcessor::ExecuteROR)
-    RegisterMethodRef( 0006100, 0006177, &CProcessor::ExecuteROL)
-    RegisterMethodRef( 0006200, 0006277, &CProcessor::ExecuteASR)
-    RegisterMethodRef( 0006300, 0006377, &CProcessor::ExecuteASL)
-
-    RegisterMethodRef( 0006400, 0006477, &CProcessor::ExecuteMARK)
-    RegisterMethodRef( 0006700, 0006777, &CProcessor::ExecuteSXT)
-
-    RegisterMethodRef( 0010000, 0017777, &CProcessor::ExecuteMOV)
-    RegisterMethodRef( 0020000, 0027777, &CProcessor::ExecuteCMP)
-    RegisterMethodRef( 0030000, 0037777, &CProcessor::ExecuteBIT)
-    RegisterMethodRef( 0040000, 0047777, &CProcessor::ExecuteBIC)
-    RegisterMethodRef( 0050000, 0057777, &CProcessor::ExecuteBIS)
-    RegisterMethodRef( 0060000, 0067777, &CProcessor::ExecuteADD)
-
-    RegisterMethodRef( 0070000, 0070777, &CProcessor::ExecuteMUL)
-    RegisterMethodRef( 0071000, 0071777, &CProcessor::ExecuteDIV)
-    RegisterMethodRef( 0072000, 0072777, &CProcessor::ExecuteASH)
-    RegisterMethodRef( 0073000, 0073777, &CProcessor::ExecuteASHC)
-    RegisterMethodRef( 0074000, 0074777, &CProcessor::ExecuteXOR)
-    RegisterMethodRef( 0075000, 0075037, &CProcessor::ExecuteFIS)
-    RegisterMethodRef( 0077000, 0077777, &CProcessor::ExecuteSOB)
-
-    RegisterMethodRef( 0100000, 0100377, &CProcessor::ExecuteBPL)
-    RegisterMethodRef( 0100400, 0100777, &CProcessor::ExecuteBMI)
-    RegisterMethodRef( 0101000, 0101377, &CProcessor::ExecuteBHI)
-    RegisterMethodRef( 0101400, 0101777, &CProcessor::ExecuteBLOS)
-    RegisterMethodRef( 0102000, 0102377, &CProcessor::ExecuteBVC)
-    RegisterMethodRef( 0102400, 0102777, &CProcessor::ExecuteBVS)
-    RegisterMethodRef( 0103000, 0103377, &CProcessor::ExecuteBHIS)  // BCC
-    RegisterMethodRef( 0103400, 0103777, &CProcessor::ExecuteBLO)   // BCS
-
-    RegisterMethodRef( 0104000, 0104377, &CProcessor::ExecuteEMT)
-    RegisterMethodRef( 0104400, 0104777, &CProcessor::ExecuteTRAP)
-
-    RegisterMethodRef( 0105000, 0105077, &CProcessor::ExecuteCLRB)
-    RegisterMethodRef( 0105100, 0105177, &CProcessor::ExecuteCOMB)
-    RegisterMethodRef( 0105200, 0105277, &CProcessor::ExecuteINCB)
-    RegisterMethodRef( 0105300, 0105377, &CProcessor::ExecuteDECB)
-    RegisterMethodRef( 0105400, 0105477, &CProcessor::ExecuteNEGB)
-    RegisterMethodRef( 0105500, 0105577, &CProcessor::ExecuteADCB)
-    RegisterMethodRef( 0105600, 0105677, &CProcessor::ExecuteSBCB)
-    RegisterMethodRef( 0105700, 0105777, &CProcessor::ExecuteTSTB)
-    RegisterMethodRef( 0106000, 0106077, &CProcessor::ExecuteRORB)
-    RegisterMethodRef( 0106100, 0106177, &CProcessor::ExecuteROLB)
-    RegisterMethodRef( 0106200, 0106277, &CProcessor::ExecuteASRB)
-    RegisterMethodRef( 0106300, 0106377, &CProcessor::ExecuteASLB)
-
-    RegisterMethodRef( 0106400, 0106477, &CProcessor::ExecuteMTPS)
-    RegisterMethodRef( 0106700, 0106777, &CProcessor::ExecuteMFPS)
-
-    RegisterMethodRef( 0110000, 0117777, &CProcessor::ExecuteMOVB)
-    RegisterMethodRef( 0120000, 0127777, &CProcessor::ExecuteCMPB)
-    RegisterMethodRef( 0130000, 0137777, &CProcessor::ExecuteBITB)
-    RegisterMethodRef( 0140000, 0147777, &CProcessor::ExecuteBICB)
-    RegisterMethodRef( 0150000, 0157777, &CProcessor::ExecuteBISB)
-    RegisterMethodRef( 0160000, 0167777, &CProcessor::ExecuteSUB)
-}
-
-void CProcessor::Done()
-{
-    ::free(m_pExecuteMethodMap);  m_pExecuteMethodMap = nullptr;
+// Opcode classes: plain ones index the m_ExecuteMethods table, then classes with
+// handlers instantiated by destination mode, then by source and destination modes
+enum OpcodeClass
+{
+    OPCLASS_UNKNOWN = 0,
+    OPCLASS_HALT, OPCLASS_WAIT, OPCLASS_RTI, OPCLASS_BPT, OPCLASS_IOT, OPCLASS_RESET, OPCLASS_RTT,
+    OPCLASS_RUN, OPCLASS_STEP, OPCLASS_RSEL, OPCLASS_MFUS, OPCLASS_RCPC, OPCLASS_RCPS,
+    OPCLASS_MTUS, OPCLASS_WCPC, OPCLASS_WCPS,
+    OPCLASS_JMP, OPCLASS_RTS, OPCLASS_CCC, OPCLASS_SCC,
+    OPCLASS_BR, OPCLASS_BNE, OPCLASS_BEQ, OPCLASS_BGE, OPCLASS_BLT, OPCLASS_BGT, OPCLASS_BLE,
+    OPCLASS_JSR, OPCLASS_MARK,
+    OPCLASS_MUL, OPCLASS_DIV, OPCLASS_ASH, OPCLASS_ASHC, OPCLASS_FIS, OPCLASS_SOB,
+    OPCLASS_BPL, OPCLASS_BMI, OPCLASS_BHI, OPCLASS_BLOS, OPCLASS_BVC, OPCLASS_BVS, OPCLASS_BHIS, OPCLASS_BLO,
+    OPCLASS_EMT, OPCLASS_TRAP,
+    OPCLASS_COUNT,
+    // Handlers by destination mode, see m_ExecuteMethodsD
+    OPCLASS_SWAB = OPCLASS_COUNT,
+    OPCLASS_CLR, OPCLASS_COM, OPCLASS_INC, OPCLASS_DEC, OPCLASS_NEG, OPCLASS_ADC, OPCLASS_SBC, OPCLASS_TST,
+    OPCLASS_ROR, OPCLASS_ROL, OPCLASS_ASR, OPCLASS_ASL,
+    OPCLASS_SXT, OPCLASS_XOR,
+    OPCLASS_CLRB, OPCLASS_COMB, OPCLASS_INCB, OPCLASS_DECB, OPCLASS_NEGB, OPCLASS_ADCB, OPCLASS_SBCB, OPCLASS_TSTB,
+    OPCLASS_RORB, OPCLASS_ROLB, OPCLASS_ASRB, OPCLASS_ASLB,
+    OPCLASS_MTPS, OPCLASS_MFPS,
+    OPCLASS_COUNT_D,
+    // Handlers by source and destination modes, see m_ExecuteMethodsSD
+    OPCLASS_MOV = OPCLASS_COUNT_D,
+    OPCLASS_CMP, OPCLASS_BIT, OPCLASS_BIC, OPCLASS_BIS, OPCLASS_ADD,
+    OPCLASS_MOVB, OPCLASS_CMPB, OPCLASS_BITB, OPCLASS_BICB, OPCLASS_BISB, OPCLASS_SUB,
+    OPCLASS_COUNT_SD,
+    // Blocks of 64 opcodes with mixed classes, resolved by the second-level table
+    OPCLASS_SPLIT = 0xf0
+};
+
+const CProcessor::ExecuteMethodRef CProcessor::m_ExecuteMethods[] =
+{
+    &CProcessor::ExecuteUNKNOWN,
+    &CProcessor::ExecuteHALT, &CProcessor::ExecuteWAIT, &CProcessor::ExecuteRTI, &CProcessor::ExecuteBPT,
+    &CProcessor::ExecuteIOT, &CProcessor::ExecuteRESET, &CProcessor::ExecuteRTT,
+    &CProcessor::ExecuteRUN, &CProcessor::ExecuteSTEP, &CProcessor::ExecuteRSEL, &CProcessor::ExecuteMFUS,
+    &CProcessor::ExecuteRCPC, &CProcessor::ExecuteRCPS,
+    &CProcessor::ExecuteMTUS, &CProcessor::ExecuteWCPC, &CProcessor::ExecuteWCPS,
+    &CProcessor::ExecuteJMP, &CProcessor::ExecuteRTS, &CProcessor::ExecuteCCC, &CProcessor::ExecuteSCC,
+    &CProcessor::ExecuteBR, &CProcessor::ExecuteBNE, &CProcessor::ExecuteBEQ, &CProcessor::ExecuteBGE,
+    &CProcessor::ExecuteBLT, &CProcessor::ExecuteBGT, &CProcessor::ExecuteBLE,
+    &CProcessor::ExecuteJSR, &CProcessor::ExecuteMARK,
+    &CProcessor::ExecuteMUL, &CProcessor::ExecuteDIV, &CProcessor::ExecuteASH, &CProcessor::ExecuteASHC,
+    &CProcessor::ExecuteFIS, &CProcessor::ExecuteSOB,
+    &CProcessor::ExecuteBPL, &CProcessor::ExecuteBMI, &CProcessor::ExecuteBHI, &CProcessor::ExecuteBLOS,
+    &CProcessor::ExecuteBVC, &CProcessor::ExecuteBVS, &CProcessor::ExecuteBHIS, &CProcessor::ExecuteBLO,
+    &CProcessor::ExecuteEMT, &CProcessor::ExecuteTRAP,
+};
+
+#define EXECUTE_D(name) \
+    { &CProcessor::name<0>, &CProcessor::name<1>, &CProcessor::name<2>, &CProcessor::name<3>, \
+      &CProcessor::name<4>, &CProcessor::name<5>, &CProcessor::name<6>, &CProcessor::name<7> }
+#define EXECUTE_S(name, s) \
+    &CProcessor::name<s, 0>, &CProcessor::name<s, 1>, &CProcessor::name<s, 2>, &CProcessor::name<s, 3>, \
+    &CProcessor::name<s, 4>, &CProcessor::name<s, 5>, &CProcessor::name<s, 6>, &CProcessor::name<s, 7>
+#define EXECUTE_SD(name) \
+    { EXECUTE_S(name, 0), EXECUTE_S(name, 1), EXECUTE_S(name, 2), EXECUTE_S(name, 3), \
+      EXECUTE_S(name, 4), EXECUTE_S(name, 5), EXECUTE_S(name, 6), EXECUTE_S(name, 7) }
+
+// Handlers by opcode class and destination mode
+const CProcessor::ExecuteMethodRef CProcessor::m_ExecuteMethodsD[][8] =
+{
+    EXECUTE_D(ExecuteSWAB),
+    EXECUTE_D(ExecuteCLR), EXECUTE_D(ExecuteCOM), EXECUTE_D(ExecuteINC), EXECUTE_D(ExecuteDEC),
+    EXECUTE_D(ExecuteNEG), EXECUTE_D(ExecuteADC), EXECUTE_D(ExecuteSBC), EXECUTE_D(ExecuteTST),
+    EXECUTE_D(ExecuteROR), EXECUTE_D(ExecuteROL), EXECUTE_D(ExecuteASR), EXECUTE_D(ExecuteASL),
+    EXECUTE_D(ExecuteSXT), EXECUTE_D(ExecuteXOR),
+    EXECUTE_D(ExecuteCLRB), EXECUTE_D(ExecuteCOMB), EXECUTE_D(ExecuteINCB), EXECUTE_D(ExecuteDECB),
+    EXECUTE_D(ExecuteNEGB), EXECUTE_D(ExecuteADCB), EXECUTE_D(ExecuteSBCB), EXECUTE_D(ExecuteTSTB),
+    EXECUTE_D(ExecuteRORB), EXECUTE_D(ExecuteROLB), EXECUTE_D(ExecuteASRB), EXECUTE_D(ExecuteASLB),
+    EXECUTE_D(ExecuteMTPS), EXECUTE_D(ExecuteMFPS),
+};
+// Handlers by opcode class, source mode and destination mode
+const CProcessor::ExecuteMethodRef CProcessor::m_ExecuteMethodsSD[][64] =
+{
+    EXECUTE_SD(ExecuteMOV), EXECUTE_SD(ExecuteCMP), EXECUTE_SD(ExecuteBIT),
+    EXECUTE_SD(ExecuteBIC), EXECUTE_SD(ExecuteBIS), EXECUTE_SD(ExecuteADD),
+    EXECUTE_SD(ExecuteMOVB), EXECUTE_SD(ExecuteCMPB), EXECUTE_SD(ExecuteBITB),
+    EXECUTE_SD(ExecuteBICB), EXECUTE_SD(ExecuteBISB), EXECUTE_SD(ExecuteSUB),
+};
+
+#undef EXECUTE_D
+#undef EXECUTE_S
+#undef EXECUTE_SD
+
+struct OpcodeRange
+{
+    uint16_t opstart, opend;
+    uint8_t  opclass;
+};
+
+// Opcode map; opcodes not listed here are ExecuteUNKNOWN, that is TRAP 10
+static constexpr OpcodeRange OpcodeRanges[] =
+{
+    { 0000000, 0000000, OPCLASS_HALT },
+    { 0000001, 0000001, OPCLASS_WAIT },
+    { 0000002, 0000002, OPCLASS_RTI },
+    { 0000003, 0000003, OPCLASS_BPT },
+    { 0000004, 0000004, OPCLASS_IOT },
+    { 0000005, 0000005, OPCLASS_RESET },
+    { 0000006, 0000006, OPCLASS_RTT },
+
+    { 0000010, 0000013, OPCLASS_RUN },
+    { 0000014, 0000017, OPCLASS_STEP },
+    { 0000020, 0000020, OPCLASS_RSEL },
+    { 0000021, 0000021, OPCLASS_MFUS },
+    { 0000022, 0000023, OPCLASS_RCPC },
+    { 0000024, 0000027, OPCLASS_RCPS },
+    { 0000030, 0000030, OPCLASS_RSEL },
+    { 0000031, 0000031, OPCLASS_MTUS },
+    { 0000032, 0000033, OPCLASS_WCPC },
+    { 0000034, 0000037, OPCLASS_WCPS },
+
+    { 0000100, 0000177, OPCLASS_JMP },
+    { 0000200, 0000207, OPCLASS_RTS },  // RTS / RETURN
+
+    { 0000240, 0000257, OPCLASS_CCC },
+
+    { 0000260, 0000277, OPCLASS_SCC },
+
+    { 0000300, 0000377, OPCLASS_SWAB },
+
+    { 0000400, 0000777, OPCLASS_BR },
+    { 0001000, 0001377, OPCLASS_BNE },
+    { 0001400, 0001777, OPCLASS_BEQ },
+    { 0002000, 0002377, OPCLASS_BGE },
+    { 0002400, 0002777, OPCLASS_BLT },
+    { 0003000, 0003377, OPCLASS_BGT },
+    { 0003400, 0003777, OPCLASS_BLE },
+
+    { 0004000, 0004777, OPCLASS_JSR },  // JSR / CALL
+
+    { 0005000, 0005077, OPCLASS_CLR },
+    { 0005100, 0005177, OPCLASS_COM },
+    { 0005200, 0005277, OPCLASS_INC },
+    { 0005300, 0005377, OPCLASS_DEC },
+    { 0005400, 0005477, OPCLASS_NEG },
+    { 0005500, 0005577, OPCLASS_ADC },
+    { 0005600, 0005677, OPCLASS_SBC },
+    { 0005700, 0005777, OPCLASS_TST },
+    { 0006000, 0006077, OPCLASS_ROR },
+    { 0006100, 0006177, OPCLASS_ROL },
+    { 0006200, 0006277, OPCLASS_ASR },
+    { 0006300, 0006377, OPCLASS_ASL },
+
+    { 0006400, 0006477, OPCLASS_MARK },
+    { 0006700, 0006777, OPCLASS_SXT },
+
+    { 0010000, 0017777, OPCLASS_MOV },
+    { 0020000, 0027777, OPCLASS_CMP },
+    { 0030000, 0037777, OPCLASS_BIT },
+    { 0040000, 0047777, OPCLASS_BIC },
+    { 0050000, 0057777, OPCLASS_BIS },
+    { 0060000, 0067777, OPCLASS_ADD },
+
+    { 0070000, 0070777, OPCLASS_MUL },
+    { 0071000, 0071777, OPCLASS_DIV },
+    { 0072000, 0072777, OPCLASS_ASH },
+    { 0073000, 0073777, OPCLASS_ASHC },
+    { 0074000, 0074777, OPCLASS_XOR },
+    { 0075000, 0075037, OPCLASS_FIS },
+    { 0077000, 0077777, OPCLASS_SOB },
+
+    { 0100000, 0100377, OPCLASS_BPL },
+    { 0100400, 0100777, OPCLASS_BMI },
+    { 0101000, 0101377, OPCLASS_BHI },
+    { 0101400, 0101777, OPCLASS_BLOS },
+    { 0102000, 0102377, OPCLASS_BVC },
+    { 0102400, 0102777, OPCLASS_BVS },
+    { 0103000, 0103377, OPCLASS_BHIS },  // BCC
+    { 0103400, 0103777, OPCLASS_BLO },   // BCS
+
+    { 0104000, 0104377, OPCLASS_EMT },
+    { 0104400, 0104777, OPCLASS_TRAP },
+
+    { 0105000, 0105077, OPCLASS_CLRB },
+    { 0105100, 0105177, OPCLASS_COMB },
+    { 0105200, 0105277, OPCLASS_INCB },
+    { 0105300, 0105377, OPCLASS_DECB },
+    { 0105400, 0105477, OPCLASS_NEGB },
+    { 0105500, 0105577, OPCLASS_ADCB },
+    { 0105600, 0105677, OPCLASS_SBCB },
+    { 0105700, 0105777, OPCLASS_TSTB },
+    { 0106000, 0106077, OPCLASS_RORB },
+    { 0106100, 0106177, OPCLASS_ROLB },
+    { 0106200, 0106277, OPCLASS_ASRB },
+    { 0106300, 0106377, OPCLASS_ASLB },
+
+    { 0106400, 0106477, OPCLASS_MTPS },
+    { 0106700, 0106777, OPCLASS_MFPS },
+
+    { 0110000, 0117777, OPCLASS_MOVB },
+    { 0120000, 0127777, OPCLASS_CMPB },
+    { 0130000, 0137777, OPCLASS_BITB },
+    { 0140000, 0147777, OPCLASS_BICB },
+    { 0150000, 0157777, OPCLASS_BISB },
+    { 0160000, 0167777, OPCLASS_SUB },
+};
+
+static constexpr uint8_t FindOpcodeClass(uint16_t opcode, size_t index = 0)
+{
+    return (index >= sizeof(OpcodeRanges) / sizeof(OpcodeRanges[0])) ? (uint8_t)OPCLASS_UNKNOWN :
+           (opcode >= OpcodeRanges[index].opstart && opcode <= OpcodeRanges[index].opend) ? OpcodeRanges[index].opclass :
+           FindOpcodeClass(opcode, index + 1);
+}
+
+// Class for the block of 64 opcodes; the blocks with several classes inside go to the second-level table
+static constexpr uint8_t FindBlockClass(uint16_t block)
+{
+    return (block == 00000) ? (uint8_t)(OPCLASS_SPLIT + 0) :  // 0000000-0000077: HALT..WCPS
+           (block == 00002) ? (uint8_t)(OPCLASS_SPLIT + 1) :  // 0000200-0000277: RTS, CCC, SCC
+           (block == 00750) ? (uint8_t)(OPCLASS_SPLIT + 2) :  // 0075000-0075077: FIS
+           FindOpcodeClass((uint16_t)(block << 6));
+}
+
+#define OPCLASS_REPEAT4(f, b)   f(b), f((b) + 1), f((b) + 2), f((b) + 3)
+#define OPCLASS_REPEAT16(f, b)  OPCLASS_REPEAT4(f, b), OPCLASS_REPEAT4(f, (b) + 4), OPCLASS_REPEAT4(f, (b) + 8), OPCLASS_REPEAT4(f, (b) + 12)
+#define OPCLASS_REPEAT64(f, b)  OPCLASS_REPEAT16(f, b), OPCLASS_REPEAT16(f, (b) + 16), OPCLASS_REPEAT16(f, (b) + 32), OPCLASS_REPEAT16(f, (b) + 48)
+#define OPCLASS_REPEAT256(f, b) OPCLASS_REPEAT64(f, b), OPCLASS_REPEAT64(f, (b) + 64), OPCLASS_REPEAT64(f, (b) + 128), OPCLASS_REPEAT64(f, (b) + 192)
+
+// Opcode class by opcode bits 15..6, built at compile time
+const uint8_t CProcessor::m_OpcodeClassMap[1024] =
+{
+    OPCLASS_REPEAT256(FindBlockClass, 0),   OPCLASS_REPEAT256(FindBlockClass, 256),
+    OPCLASS_REPEAT256(FindBlockClass, 512), OPCLASS_REPEAT256(FindBlockClass, 768)
+};
+// Opcode class by opcode bits 5..0, for the split blocks
+const uint8_t CProcessor::m_OpcodeClassMap2[3][64] =
+{
+    { OPCLASS_REPEAT64(FindOpcodeClass, 0000000) },
+    { OPCLASS_REPEAT64(FindOpcodeClass, 0000200) },
+    { OPCLASS_REPEAT64(FindOpcodeClass, 0075000) },
+};
+
+#undef OPCLASS_REPEAT4
+#undef OPCLASS_REPEAT16
+#undef OPCLASS_REPEAT64
+#undef OPCLASS_REPEAT256
+
+uint8_t CProcessor::GetOpcodeClass(uint16_t instruction)
+{
+    uint8_t opclass = m_OpcodeClassMap[instruction >> 6];
+    if (opclass >= OPCLASS_SPLIT)
+        opclass = m_OpcodeClassMap2[opclass - OPCLASS_SPLIT][instruction & 077];
+    return opclass;
+}
+
+CProcessor::ExecuteMethodRef CProcessor::GetExecuteMethod(uint16_t instruction)
+{
+    static_assert(sizeof(m_ExecuteMethods) / sizeof(m_ExecuteMethods[0]) == OPCLASS_COUNT,
+            "m_ExecuteMethods does not match OpcodeClass enum");
+    static_assert(sizeof(m_ExecuteMethodsD) / sizeof(m_ExecuteMethodsD[0]) == OPCLASS_COUNT_D - OPCLASS_COUNT,
+            "m_ExecuteMethodsD does not match OpcodeClass enum");
+    static_assert(sizeof(m_ExecuteMethodsSD) / sizeof(m_ExecuteMethodsSD[0]) == OPCLASS_COUNT_SD - OPCLASS_COUNT_D,
+            "m_ExecuteMethodsSD does not match OpcodeClass enum");
+
+    uint8_t opclass = GetOpcodeClass(instruction);
+    if (opclass >= OPCLASS_COUNT_D)  // Mode bits: source 11..9, destination 5..3
+        return m_ExecuteMethodsSD[opclass - OPCLASS_COUNT_D][((instruction >> 6) & 070) | ((instruction >> 3) & 7)];
+    if (opclass >= OPCLASS_COUNT)
+        return m_ExecuteMethodsD[opclass - OPCLASS_COUNT][(instruction >> 3) & 7];
+    return m_ExecuteMethods[opclass];
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -341,16 +503,52 @@ CProcessor::CProcessor(CMotherboard* pBoard)
     m_waitmode = false;
     m_stepmode = false;
     m_buserror = false;
-    m_STRTrq = m_RPLYrq = m_RSVDrq = m_TBITrq = m_ACLOrq = m_HALTrq = m_EVNTrq = false;
-    m_ILLGrq = m_FIS_rq = m_BPT_rq = m_IOT_rq = m_EMT_rq = m_TRAPrq = m_VIRQrq = false;
+    m_flagsop = LAZY_NONE;
+    m_flagsres = m_flagsa = m_flagsb = 0;
+    m_okLazyFlags = true;
+    m_okNativeFIS = false;
+    m_intrq = 0;
     m_ACLOreset = m_EVNTreset = false;
     m_DCLOpin = m_ACLOpin = true;
-    m_haltpin = false;
 
     m_instruction = m_instructionpc = 0;
+    m_instrtiming = 0;
     m_regsrc = m_methsrc = 0;
     m_regdest = m_methdest = 0;
     m_addrsrc = m_addrdest = 0;
+
+    m_okBlockMode = false;
+    m_pBlockCache = static_cast<TranslatedBlock*>(::calloc(BLOCK_CACHE_SIZE, sizeof(TranslatedBlock)));
+    m_pCodePageGen = static_cast<uint32_t*>(::calloc(BLOCK_PAGE_COUNT, sizeof(uint32_t)));
+
+    m_pDecodeCache = static_cast<DecodedInstruction*>(::calloc(DECODE_CACHE_SIZE, sizeof(DecodedInstruction)));
+    FlushDecodeCache();  // Flushes the block cache as well
+    ::memset(&m_decodeTemp, 0, sizeof(m_decodeTemp));
+    m_decodeTemp.tag = DECODE_TAG_INVALID;
+    m_instrmethod = nullptr;
+}
+
+CProcessor::~CProcessor()
+{
+    ::free(m_pDecodeCache);
+    ::free(m_pBlockCache);
+    ::free(m_pCodePageGen);
+}
+
+void CProcessor::FlushDecodeCache()
+{
+    for (int i = 0; i < DECODE_CACHE_SIZE; i++)
+        m_pDecodeCache[i].tag = DECODE_TAG_INVALID;
+    FlushBlockCache();
+}
+
+void CProcessor::FlushBlockCache()
+{
+    for (int i = 0; i < BLOCK_CACHE_SIZE; i++)
+    {
+        m_pBlockCache[i].tag = DECODE_TAG_INVALID;
+        m_pBlockCache[i].length = 0;
+    }
 }
 
 void CProcessor::Execute()
@@ -367,11 +565,34 @@ void CProcessor::Execute()
         CommandExecution();
 }
 
+// Interrupt vectors by INTRQ_Xxx bit number, 0xffff = vector depends on state
+static const uint16_t IntrqVectors[16] =
+{
+    0xffff,  0xffff,  0000100, 0170,    0000024, 0000014, 0000010, 0000004,  // -, VIRQ, EVNT, HALT signal, ACLO, T-bit, RSVD, ILLG
+    0xffff,  0010,    0000034, 0000030, 0000020, 0000014, 0170,    0,        // RPLY, FIS, TRAP, EMT, IOT, BPT, HALT, STRT
+};
+// Requests processed in HALT mode
+#define INTRQ_HALTMODE  (INTRQ_STRT | INTRQ_HALT | INTRQ_FIS | INTRQ_HALTPIN | INTRQ_VIRQ)
+
+// Number of the highest bit set, the mask should be non-zero
+static inline int GetHighestBit(uint16_t mask)
+{
+#if defined(__GNUC__)
+    return 31 - __builtin_clz(mask);
+#elif defined(_MSC_VER)
+    unsigned long index;
+    _BitScanReverse(&index, mask);
+    return (int)index;
+#else
+    int bit = 15;
+    while ((mask & (1 << bit)) == 0) bit--;
+    return bit;
+#endif
+}
+
 bool CProcessor::InterruptProcessing()
 {
-    uint16_t intrVector = 0xFFFF;
     bool currMode = ((m_psw & 0400) != 0);  // Current processor mode: true = HALT mode, false = USER mode
-    bool intrMode = false;  // true = HALT mode interrupt, false = USER mode interrupt
 
     if (m_stepmode)
     {
@@ -380,44 +601,35 @@ bool CProcessor::InterruptProcessing()
     }
 
     m_ACLOreset = m_EVNTreset = false;
-    m_TBITrq = (m_psw & 020) != 0;  // T-bit
+    if (m_psw & PSW_T)  // T-bit
+        m_intrq |= INTRQ_TBIT;
+    else
+        m_intrq &= ~INTRQ_TBIT;
 
-    if (m_STRTrq)
-    {
-        intrVector = 0; intrMode = true;
-        m_STRTrq = false;
-    }
-    else if (m_HALTrq)  // HALT command
-    {
-        intrVector = 0170;  intrMode = true;
-        m_HALTrq = false;
-    }
-    else if (m_BPT_rq)  // BPT command
-    {
-        intrVector = 0000014;  intrMode = false;
-        m_BPT_rq = false;
-    }
-    else if (m_IOT_rq)  // IOT command
-    {
-        intrVector = 0000020;  intrMode = false;
-        m_IOT_rq = false;
-    }
-    else if (m_EMT_rq)  // EMT command
-    {
-        intrVector = 0000030;  intrMode = false;
-        m_EMT_rq = false;
-    }
-    else if (m_TRAPrq)  // TRAP command
-    {
-        intrVector = 0000034;  intrMode = false;
-        m_TRAPrq = false;
-    }
-    else if (m_FIS_rq)  // FIS commands -- Floating point Instruction Set
-    {
-        intrVector = 0010;  intrMode = true;
-        m_FIS_rq = false;
-    }
-    else if (m_RPLYrq)  // Зависание, priority 1
+    // Requests allowed in the current processor state
+    uint16_t intrqmask = (uint16_t)~(INTRQ_TBIT | INTRQ_LEVELS);
+    if (!m_waitmode)
+        intrqmask |= INTRQ_TBIT;
+    if ((m_psw & 0600) != 0600)
+        intrqmask |= INTRQ_ACLO;
+    if ((m_psw & 0400) != 0400)
+        intrqmask |= INTRQ_HALTPIN;
+    if ((m_psw & 0200) != 0200)
+        intrqmask |= INTRQ_EVNT | INTRQ_VIRQ;
+    uint16_t intrq = m_intrq & intrqmask;
+    if (intrq == 0)
+        return false;  // Nothing to process
+
+    UpdateFlags();
+
+    int intrbitno = GetHighestBit(intrq);
+    uint16_t intrbit = (uint16_t)(1 << intrbitno);
+    uint16_t intrVector = IntrqVectors[intrbitno];
+    bool intrMode = (intrbit & INTRQ_HALTMODE) != 0;  // true = HALT mode interrupt, false = USER mode interrupt
+    if ((intrbit & INTRQ_LEVELS) == 0)
+        m_intrq &= ~intrbit;
+
+    if (intrbit == INTRQ_RPLY)  // Зависание, priority 1
     {
         if (m_buserror)
         {
@@ -432,38 +644,12 @@ bool CProcessor::InterruptProcessing()
             intrVector = 0000004; intrMode = false;
         }
         m_buserror = true;
-        m_RPLYrq = false;
-    }
-    else if (m_ILLGrq)
-    {
-        intrVector = 000004;  intrMode = false;
-        m_ILLGrq = false;
-    }
-    else if (m_RSVDrq)  // Reserved command, priority 2
-    {
-        intrVector = 000010;  intrMode = false;
-        m_RSVDrq = false;
-    }
-    else if (m_TBITrq && (!m_waitmode))  // T-bit, priority 3
-    {
-        intrVector = 000014;  intrMode = false;
-        m_TBITrq = false;
     }
-    else if (m_ACLOrq && (m_psw & 0600) != 0600)  // ACLO, priority 4
-    {
-        intrVector = 000024;  intrMode = false;
+    else if (intrbit == INTRQ_ACLO)  // ACLO, priority 4
         m_ACLOreset = true;
-    }
-    else if (m_haltpin && (m_psw & 0400) != 0400)  // HALT signal in USER mode, priority 5
-    {
-        intrVector = 0170;  intrMode = true;
-    }
-    else if (m_EVNTrq && (m_psw & 0200) != 0200)  // EVNT signal, priority 6
-    {
-        intrVector = 0000100;  intrMode = false;
+    else if (intrbit == INTRQ_EVNT)  // EVNT signal, priority 6
         m_EVNTreset = true;
-    }
-    else if (m_VIRQrq && (m_psw & 0200) != 0200)  // VIRQ, priority 7
+    else if (intrbit == INTRQ_VIRQ)  // VIRQ, priority 7
     {
         //NOTE: Special case just for PK11/16
 
@@ -472,77 +658,75 @@ bool CProcessor::InterruptProcessing()
         SetWord(GetSP(), GetCPSW());
         SetSP(GetSP() - 2);
         SetWord(GetSP(), GetCPC());
-        if (m_RPLYrq) return true;
+        if (m_intrq & INTRQ_RPLY) return true;
 
         m_internalTick += 54;
 
-        intrVector = 0000274;  intrMode = true;
+        intrVector = 0000274;
     }
 
-    if (intrVector != 0xFFFF)
+    m_internalTick += EMT_TIMING;  //ANYTHING UNKNOWN WILL CAUSE EXCEPTION (EMT)
+
+    m_waitmode = false;
+
+    if (intrMode)  // HALT mode interrupt
     {
-        m_internalTick += EMT_TIMING;  //ANYTHING UNKNOWN WILL CAUSE EXCEPTION (EMT)
+        uint16_t selVector = m_pBoard->GetSelRegister() & 0x0ff00;
+        intrVector |= selVector;
+        // Save PC/PSW to CPC/CPSW
+        m_savepc = GetPC();
+        m_savepsw = GetPSW();
+        m_psw |= 0400;
+        SetHALT(true);
+        uint16_t new_pc = GetWord(intrVector);
+        uint16_t new_psw = GetWord(intrVector + 2);
+        if (m_intrq & INTRQ_RPLY) return true;
 
-        m_waitmode = false;
+        //DebugLogFormat(_T("%c%06ho\tCPU HALT INT vector=%06ho PC=%06ho PSW=%06ho\r\n"), currMode ? _T('H') : _T('U'), GetInstructionPC(), intrVector, new_pc, new_psw);
+        SetPSW(new_psw);
+        SetPC(new_pc);
+    }
+    else  // USER mode interrupt
+    {
+        SetHALT(false);
+        // Save PC/PSW to stack
+        SetSP(GetSP() - 2);
+        SetWord(GetSP(), GetCPSW());
+        SetSP(GetSP() - 2);
+        if (m_intrq & INTRQ_RPLY) return true;
+        SetWord(GetSP(), GetCPC());
+        if (m_intrq & INTRQ_RPLY) return true;
 
-        if (intrMode)  // HALT mode interrupt
-        {
-            uint16_t selVector = m_pBoard->GetSelRegister() & 0x0ff00;
-            intrVector |= selVector;
-            // Save PC/PSW to CPC/CPSW
-            m_savepc = GetPC();
-            m_savepsw = GetPSW();
-            m_psw |= 0400;
-            SetHALT(true);
-            uint16_t new_pc = GetWord(intrVector);
-            uint16_t new_psw = GetWord(intrVector + 2);
-            if (m_RPLYrq) return true;
-
-            //DebugLogFormat(_T("%c%06ho\tCPU HALT INT vector=%06ho PC=%06ho PSW=%06ho\r\n"), currMode ? _T('H') : _T('U'), GetInstructionPC(), intrVector, new_pc, new_psw);
-            SetPSW(new_psw);
-            SetPC(new_pc);
-        }
-        else  // USER mode interrupt
-        {
-            SetHALT(false);
-            // Save PC/PSW to stack
-            SetSP(GetSP() - 2);
-            SetWord(GetSP(), GetCPSW());
-            SetSP(GetSP() - 2);
-            if (m_RPLYrq) return true;
-            SetWord(GetSP(), GetCPC());
-            if (m_RPLYrq) return true;
-
-            if (m_ACLOreset) m_ACLOrq = false;
-            if (m_EVNTreset) m_EVNTrq = false;
-            uint16_t new_pc = GetWord(intrVector);
-            uint16_t new_psw = GetWord(intrVector + 2);
-            if (m_RPLYrq) return true;
-
-            //DebugLogFormat(_T("%c%06ho\tCPU USER INT vector=%06ho PC=%06ho PSW=%06ho\r\n"), currMode ? _T('H') : _T('U'), GetInstructionPC(), intrVector, new_pc, new_psw);
-            SetLPSW((uint8_t)(new_psw & 0xff));
-            SetPC(new_pc);
-        }
+        if (m_ACLOreset) m_intrq &= ~INTRQ_ACLO;
+        if (m_EVNTreset) m_intrq &= ~INTRQ_EVNT;
+        uint16_t new_pc = GetWord(intrVector);
+        uint16_t new_psw = GetWord(intrVector + 2);
+        if (m_intrq & INTRQ_RPLY) return true;
 
-        return true;
+        //DebugLogFormat(_T("%c%06ho\tCPU USER INT vector=%06ho PC=%06ho PSW=%06ho\r\n"), currMode ? _T('H') : _T('U'), GetInstructionPC(), intrVector, new_pc, new_psw);
+        SetLPSW((uint8_t)(new_psw & 0xff));
+        SetPC(new_pc);
     }
 
-    return false;
+    return true;
 }
 
 void CProcessor::CommandExecution()
 {
     if (!m_waitmode)
     {
+        if (m_okBlockMode && BlockExecution())
+            return;
+
         m_instructionpc = m_R[7];  // Store address of the current instruction
         FetchInstruction();  // Read next instruction from memory
-        if (!m_RPLYrq)
+        if ((m_intrq & INTRQ_RPLY) == 0)
         {
             m_buserror = false;
             TranslateInstruction();  // Execute next instruction
         }
     }
-    if (m_HALTrq || m_BPT_rq || m_IOT_rq || m_EMT_rq || m_TRAPrq || m_FIS_rq)
+    if (m_intrq & INTRQ_COMMANDS)
         InterruptProcessing();
 }
 
@@ -550,7 +734,7 @@ void CProcessor::TickEVNT()
 {
     if (m_okStopped) return;  // Processor is stopped - nothing to do
 
-    m_EVNTrq = true;
+    m_intrq |= INTRQ_EVNT;
 }
 
 void CProcessor::SetDCLOPin(bool value)
@@ -564,8 +748,7 @@ void CProcessor::SetDCLOPin(bool value)
         m_buserror = false;
         m_waitmode = false;
         m_internalTick = 0;
-        m_RPLYrq = m_RSVDrq = m_TBITrq = m_ACLOrq = m_HALTrq = m_EVNTrq = false;
-        m_ILLGrq = m_FIS_rq = m_BPT_rq = m_IOT_rq = m_EMT_rq = m_TRAPrq = m_VIRQrq = false;
+        m_intrq &= INTRQ_STRT | INTRQ_HALTPIN;
         m_ACLOreset = m_EVNTreset = false;
         m_pBoard->ResetDevices();
     }
@@ -581,23 +764,22 @@ void CProcessor::SetACLOPin(bool value)
         m_stepmode = false;
         m_waitmode = false;
         m_buserror = false;
-        m_RPLYrq = m_RSVDrq = m_TBITrq = m_ACLOrq = m_HALTrq = m_EVNTrq = false;
-        m_ILLGrq = m_FIS_rq = m_BPT_rq = m_IOT_rq = m_EMT_rq = m_TRAPrq = m_VIRQrq = false;
+        m_intrq &= INTRQ_STRT | INTRQ_HALTPIN;
         m_ACLOreset = m_EVNTreset = false;
 
         // "Turn On" interrupt processing
-        m_STRTrq = true;
+        m_intrq |= INTRQ_STRT;
     }
     if (!m_okStopped && !m_DCLOpin && !m_ACLOpin && value)
     {
-        m_ACLOrq = true;
+        m_intrq |= INTRQ_ACLO;
     }
     m_ACLOpin = value;
 }
 
 void CProcessor::MemoryError()
 {
-    m_RPLYrq = true;
+    m_intrq |= INTRQ_RPLY;
 }
 
 
@@ -609,28 +791,204 @@ void CProcessor::FetchInstruction()
     uint16_t pc = GetPC();
     //ASSERT((pc & 1) == 0); // it have to be word aligned
 
-    m_instruction = GetWordExec(pc);
+    uint32_t offset;
+    int addrtype = m_pBoard->TranslateAddress(pc, IsHaltMode(), true, &offset);
+    DecodedInstruction* pEntry;
+    if (addrtype == ADDRTYPE_RAM || addrtype == ADDRTYPE_RAM2 || addrtype == ADDRTYPE_RAM4)
+    {
+        uint32_t tag = offset & ~1;
+        pEntry = m_pDecodeCache + ((tag >> 1) & (DECODE_CACHE_SIZE - 1));
+        if (pEntry->tag != tag)
+        {
+            DecodeInstruction(pEntry, m_pBoard->GetRAMWord(tag));
+            pEntry->tag = tag;
+        }
+    }
+    else if (addrtype == ADDRTYPE_ROM)
+    {
+        uint32_t tag = (offset & 0xfffe) | DECODE_TAG_ROM;
+        pEntry = m_pDecodeCache + ((tag >> 1) & (DECODE_CACHE_SIZE - 1));
+        if (pEntry->tag != tag)
+        {
+            DecodeInstruction(pEntry, m_pBoard->GetROMWord(offset & 0xfffe));
+            pEntry->tag = tag;
+        }
+    }
+    else  // I/O, emulated registers or denied memory -- read through the bus, do not cache
+    {
+        pEntry = &m_decodeTemp;
+        DecodeInstruction(pEntry, GetWordExec(pc));
+    }
+
+    SetInstruction(pEntry);
+
     SetPC(GetPC() + 2);
 }
 
-void CProcessor::TranslateInstruction()
+inline void CProcessor::SetInstruction(const DecodedInstruction* pEntry)
+{
+    m_instruction = pEntry->instruction;
+    m_instrtiming = pEntry->timing;
+    m_regdest  = pEntry->regdest;
+    m_methdest = pEntry->methdest;
+    m_regsrc   = pEntry->regsrc;
+    m_methsrc  = pEntry->methsrc;
+    m_instrmethod = pEntry->methodref;
+}
+
+void CProcessor::DecodeInstruction(DecodedInstruction* pEntry, uint16_t instruction)
 {
+    pEntry->instruction = instruction;
     // Prepare values to help decode the command
-    m_regdest  = GetDigit(m_instruction, 0);
-    m_methdest = GetDigit(m_instruction, 1);
-    m_regsrc   = GetDigit(m_instruction, 2);
-    m_methsrc  = GetDigit(m_instruction, 3);
+    pEntry->regdest  = GetDigit(instruction, 0);
+    pEntry->methdest = GetDigit(instruction, 1);
+    pEntry->regsrc   = GetDigit(instruction, 2);
+    pEntry->methsrc  = GetDigit(instruction, 3);
+    pEntry->timing = GetInstructionTiming(instruction);
+    // Find command implementation using the opcode class tables
+    pEntry->methodref = GetExecuteMethod(instruction);
+}
+
+void CProcessor::TranslateInstruction()
+{
+    (this->*m_instrmethod)();  // Call command implementation method
+}
+
+// Number of index or immediate words following the instruction for the operand
+static uint16_t GetOperandWords(uint8_t meth, uint8_t reg)
+{
+    return (meth >= 6 || (reg == 7 && (meth == 2 || meth == 3))) ? 1 : 0;
+}
 
-    // Find command implementation using the command map
-    ExecuteMethodRef methodref = m_pExecuteMethodMap[m_instruction];
-    (this->*methodref)();  // Call command implementation method
+bool CProcessor::BlockExecution()
+{
+    uint16_t pc = GetPC();
+    if (pc >= 0160000)
+        return false;
+    uint32_t offset, tag;
+    int addrtype = m_pBoard->TranslateAddress(pc, IsHaltMode(), true, &offset);
+    if (addrtype == ADDRTYPE_RAM || addrtype == ADDRTYPE_RAM2 || addrtype == ADDRTYPE_RAM4)
+        tag = offset & ~1;
+    else if (addrtype == ADDRTYPE_ROM)
+        tag = (offset & 0xfffe) | DECODE_TAG_ROM;
+    else
+        return false;
+
+    TranslatedBlock* pBlock = m_pBlockCache + ((tag >> 1) & (BLOCK_CACHE_SIZE - 1));
+    if (pBlock->tag != tag || pBlock->pc[0] != pc ||
+        (pBlock->length > 0 && (m_pCodePageGen[pBlock->page[0]] != pBlock->pagegen[0] ||
+                m_pCodePageGen[pBlock->page[1]] != pBlock->pagegen[1])))
+    {
+        pBlock->tag = tag;
+        pBlock->pc[0] = pc;
+        pBlock->hits = 0;
+        pBlock->length = 0;
+    }
+    if (pBlock->length == 0)
+    {
+        if (++pBlock->hits < BLOCK_HOT_COUNT)
+            return false;
+        TranslateBlock(pBlock, pc, tag);
+    }
+    if (pBlock->length < 2)
+        return false;  // Single instruction, leave it to the interpreter
+
+    // Run the instructions back to back, summing up their ticks
+    uint32_t ticks = 0;
+    uint32_t iocount = m_pBoard->GetIOAccessCount();
+    int index = 0;
+    for (;;)
+    {
+        m_internalTick = 0;  // As at the instruction boundary in Execute()
+        m_instructionpc = pBlock->pc[index];
+        SetInstruction(pBlock->instrs + index);
+        SetPC(m_instructionpc + 2);
+        m_buserror = false;
+        (this->*m_instrmethod)();
+        if (m_intrq & INTRQ_COMMANDS)
+            InterruptProcessing();
+        ticks += m_internalTick + 1u;
+
+        if (++index >= pBlock->length)
+            break;
+        // Back to the interpreter after jump, WAIT, device access or code change
+        if (GetPC() != pBlock->pc[index] || m_waitmode || iocount != m_pBoard->GetIOAccessCount() ||
+            m_pCodePageGen[pBlock->page[0]] != pBlock->pagegen[0] ||
+            m_pCodePageGen[pBlock->page[1]] != pBlock->pagegen[1])
+            break;
+        // Instruction boundary, the same way as in Execute()
+        m_internalTick = 0;
+        if (InterruptProcessing())
+        {
+            ticks += m_internalTick + 1u;
+            break;
+        }
+    }
+    m_internalTick = (uint16_t)(ticks - 1);
+
+    return true;
+}
+
+void CProcessor::TranslateBlock(TranslatedBlock* pBlock, uint16_t pc, uint32_t tag)
+{
+    bool okROM = (tag & DECODE_TAG_ROM) != 0;
+    uint32_t offset = tag & ~DECODE_TAG_ROM;
+    uint32_t lastoffset = offset;
+    uint16_t pcend = (pc | 017777) + 1;  // The block does not leave 8 KB memory window
+    int length = 0;
+    while (length < BLOCK_MAX_LENGTH)
+    {
+        uint16_t instruction = okROM ? m_pBoard->GetROMWord((uint16_t)offset) : m_pBoard->GetRAMWord(offset);
+        DecodedInstruction* pEntry = pBlock->instrs + length;
+        DecodeInstruction(pEntry, instruction);
+        pEntry->tag = okROM ? (offset | DECODE_TAG_ROM) : offset;
+        pBlock->pc[length] = pc;
+        length++;
+        lastoffset = offset;
+
+        // The block ends on control transfer; anything else changing PC is caught at run time
+        uint8_t opclass = GetOpcodeClass(instruction);
+        uint16_t size = 2;
+        bool okEnd = true;
+        if (opclass >= OPCLASS_COUNT_D)  // Two-operand
+        {
+            size += 2 * (GetOperandWords(pEntry->methsrc, pEntry->regsrc) + GetOperandWords(pEntry->methdest, pEntry->regdest));
+            okEnd = (pEntry->methdest == 0 && pEntry->regdest == 7);
+        }
+        else if (opclass >= OPCLASS_COUNT ||
+                opclass == OPCLASS_MUL || opclass == OPCLASS_DIV || opclass == OPCLASS_ASH || opclass == OPCLASS_ASHC)
+        {
+            size += 2 * GetOperandWords(pEntry->methdest, pEntry->regdest);
+            okEnd = (pEntry->methdest == 0 && pEntry->regdest == 7) ||
+                    (opclass < OPCLASS_COUNT && (pEntry->regsrc | 1) == 7);
+        }
+        else if (opclass == OPCLASS_CCC || opclass == OPCLASS_SCC)
+            okEnd = false;
+        if (okEnd)
+            break;
+
+        pc += size;  offset += size;
+        if (pc >= pcend)
+            break;
+    }
+    pBlock->length = (uint16_t)length;
+
+    // Mark the code pages and remember their generations
+    uint32_t firstpage = okROM ? BLOCK_PAGE_ROMBASE + ((tag & 0xffff) >> BLOCK_PAGE_SHIFT) : tag >> BLOCK_PAGE_SHIFT;
+    uint32_t lastpage = firstpage + ((lastoffset >> BLOCK_PAGE_SHIFT) - ((tag & ~DECODE_TAG_ROM) >> BLOCK_PAGE_SHIFT));
+    pBlock->page[0] = firstpage;
+    pBlock->page[1] = lastpage;
+    m_pCodePageGen[firstpage] |= 1;
+    m_pCodePageGen[lastpage] |= 1;
+    pBlock->pagegen[0] = m_pCodePageGen[firstpage];
+    pBlock->pagegen[1] = m_pCodePageGen[lastpage];
 }
 
 void CProcessor::ExecuteUNKNOWN ()  // Нет такой инструкции - просто вызывается TRAP 10
 {
     DebugLogFormat(_T("%06ho\tCPU Unknown opcode %06ho\r\n"), GetInstructionPC(), m_instruction);
 
-    m_RSVDrq = true;
+    m_intrq |= INTRQ_RSVD;
 }
 
 
@@ -644,11 +1002,11 @@ void CProcessor::ExecuteWAIT ()  // WAIT - Wait for an interrupt
 void CProcessor::ExecuteSTEP()  // ШАГ
 {
     if ((m_psw & PSW_HALT) == 0)  // Эта команда выполняется только в режиме HALT
-        m_RSVDrq = true;
+        m_intrq |= INTRQ_RSVD;
     else
     {
         SetPC(m_savepc);        // СК <- КРСК
-        SetPSW(m_savepsw);      // РСП(8:0) <- КРСП(8:0)
+        SetPSW(GetCPSW());      // РСП(8:0) <- КРСП(8:0)
         m_stepmode = true;
     }
 }
@@ -656,41 +1014,325 @@ void CProcessor::ExecuteSTEP()  // ШАГ
 void CProcessor::ExecuteRSEL()  // RSEL / ЧПТ - Чтение безадресного регистра
 {
     if ((m_psw & PSW_HALT) == 0)  // Эта команда выполняется только в режиме HALT
-        m_RSVDrq = true;
+        m_intrq |= INTRQ_RSVD;
     else
     {
         SetReg(0, m_pBoard->GetSelRegister());  // R0 <- (SEL)
     }
 }
 
+// Native FIS: transliteration of the PK11 ROM routine at 006076..007020, see ExecuteFIS().
+// Every step keeps the C flag the way the ROM code does, so the results are bit-exact.
+
+static void FisAsl(uint16_t& r, bool& c)  // ASL
+{
+    c = (r & 0100000) != 0;
+    r = (uint16_t)(r << 1);
+}
+static void FisAsr(uint16_t& r, bool& c)  // ASR
+{
+    c = (r & 1) != 0;
+    r = (uint16_t)((r >> 1) | (r & 0100000));
+}
+static void FisRol(uint16_t& r, bool& c)  // ROL
+{
+    bool carry = (r & 0100000) != 0;
+    r = (uint16_t)((r << 1) | (c ? 1 : 0));
+    c = carry;
+}
+static void FisRor(uint16_t& r, bool& c)  // ROR
+{
+    bool carry = (r & 1) != 0;
+    r = (uint16_t)((r >> 1) | (c ? 0100000 : 0));
+    c = carry;
+}
+static void FisRorb(uint16_t& r, bool& c)  // RORB
+{
+    bool carry = (r & 1) != 0;
+    r = (uint16_t)((r & 0177400) | ((r & 0377) >> 1) | (c ? 0200 : 0));
+    c = carry;
+}
+static void FisAdc(uint16_t& r, bool& c)  // ADC
+{
+    if (!c) return;
+    c = (r == 0177777);
+    r++;
+}
+static void FisAdcb(uint16_t& r, bool& c)  // ADCB
+{
+    if (!c) return;
+    c = ((r & 0377) == 0377);
+    r = (uint16_t)((r & 0177400) | ((r + 1) & 0377));
+}
+static void FisAdd(uint16_t src, uint16_t& r, bool& c)  // ADD
+{
+    uint32_t sum = (uint32_t)r + src;
+    c = sum > 0177777;
+    r = (uint16_t)sum;
+}
+static void FisNeg(uint16_t& r, bool& c)  // NEG
+{
+    r = (uint16_t)(0 - r);
+    c = (r != 0);
+}
+static void FisAshc(uint16_t& hi, uint16_t& lo, int count, bool& c)  // ASHC, count -32..31
+{
+    int32_t dst = (int32_t)(((uint32_t)hi << 16) | lo);
+    c = false;
+    for (; count > 0; count--)
+    {
+        c = (dst & (int32_t)0x80000000L) != 0;
+        dst = (int32_t)((uint32_t)dst << 1);
+    }
+    for (; count < 0; count++)
+    {
+        c = (dst & 1) != 0;
+        dst >>= 1;
+    }
+    hi = (uint16_t)((uint32_t)dst >> 16);
+    lo = (uint16_t)dst;
+}
+static void FisMul(uint16_t& hi, uint16_t& lo, uint16_t src)  // MUL src,hi; lo is hi|1
+{
+    int32_t res = (int16_t)hi * (int16_t)src;
+    hi = (uint16_t)((uint32_t)res >> 16);
+    lo = (uint16_t)res;
+}
+static bool FisDiv(uint16_t& hi, uint16_t& lo, uint16_t src)  // DIV src,hi; returns N flag
+{
+    int32_t longsrc = (int32_t)(((uint32_t)hi << 16) | lo);
+    int32_t src2 = (int16_t)src;
+    if (src2 == 0 || (longsrc == (int32_t)020000000000 && src2 == -1))
+        return false;  // Registers unchanged, N cleared
+    int32_t res = longsrc / src2;
+    if (res > 32767 || res < -32768)
+        return false;
+    lo = (uint16_t)(longsrc % src2);
+    hi = (uint16_t)res;
+    return res < 0;
+}
+
+// op: 0 = FADD, 1 = FSUB, 2 = FMUL, 3 = FDIV; A <- A op B, B is the first operand in the block
+static void CalculateFIS(int op, uint16_t ahi, uint16_t alo, uint16_t bhi, uint16_t blo, uint16_t* pHi, uint16_t* pLo)
+{
+    uint16_t r0, r1, r2 = bhi, r3 = blo, r4 = ahi, r5 = alo;
+    uint16_t sign, exponent;
+    bool c = false;
+    bool okRound = true;
+    *pHi = *pLo = 0;  // Zero result, also on overflow and underflow
+
+    if (op < 2)  // FADD, FSUB: 006620
+    {
+        if (op == 1)
+            r2 ^= 0100000;
+        r1 = (uint16_t)(op << 3);
+        FisAsl(r5, c);  FisRol(r4, c);  FisRol(r1, c);
+        sign = r1;
+        FisAsl(r3, c);  FisRol(r2, c);  FisAdc(r1, c);
+        r0 = r2 >> 8;  r2 = 0400 | (r2 & 0377);  // Exponent and mantissa of B
+        if (r1 & 1)  // Signs differ
+        {
+            FisNeg(r3, c);  FisAdc(r2, c);  FisNeg(r2, c);
+        }
+        r1 = r4 >> 8;  r4 = 0400 | (r4 & 0377);  // Exponent and mantissa of A
+        r1 = (uint16_t)(r1 - r0);
+        bool okSum = true;
+        if ((r1 & 0100000) == 0)
+        {
+            r0 = (uint16_t)(r0 + r1);
+            if (r1 > 32)  // B is too small, the result is A
+            {
+                r3 = r5;  r2 = r4;
+                okSum = false;
+            }
+            else
+            {
+                FisAshc(r2, r3, -(int)r1, c);
+                FisAdc(r5, c);
+                FisAdd(r5, r3, c);  FisAdc(r2, c);  FisAdd(r4, r2, c);
+            }
+        }
+        else if (r1 >= 0177746)
+        {
+            FisAshc(r4, r5, (int16_t)r1, c);
+            FisAdc(r2, c);
+            FisAdd(r5, r3, c);  FisAdc(r2, c);  FisAdd(r4, r2, c);
+        }
+        // else A is too small, the result is B
+        if (okSum && (r2 & 0100000))
+        {
+            FisNeg(r3, c);  FisAdc(r2, c);  FisNeg(r2, c);
+            sign = (uint16_t)~sign;
+        }
+        exponent = r0;
+        if ((r2 & 01400) == 0)  // Normalize to the left, no rounding
+        {
+            okRound = false;
+            exponent--;
+            if ((r2 & 0200) == 0)
+            {
+                if ((r2 & 0377) == 0 && r3 == 0)
+                    return;
+                do
+                {
+                    exponent--;
+                    FisAsl(r3, c);
+                    bool carry = (r2 & 0200) != 0;
+                    r2 = (uint16_t)((r2 & 0177400) | (((r2 << 1) | (c ? 1 : 0)) & 0377));
+                    c = carry;
+                }
+                while ((r2 & 0200) == 0);
+            }
+        }
+    }
+    else if (op == 2)  // FMUL: 006222
+    {
+        FisAsl(r2, c);  r0 = r2;  FisRol(r4, c);
+        r1 = r4;  FisAdcb(r1, c);
+        sign = r1;
+        r0 &= 0177400;  c = false;  FisRor(r3, c);
+        r2 &= ~r0;  c = true;  FisRorb(r2, c);
+        r0 >>= 8;
+        if (r0 == 0)
+            return;
+        r1 &= 0177400;  c = false;  FisRor(r5, c);
+        r4 &= ~r1;  c = true;  FisRorb(r4, c);
+        r1 >>= 8;
+        if (r1 == 0)
+            return;
+        exponent = (uint16_t)(r0 + r1 - 0201);
+        r0 = r5;  r5 = r3;  r3 = r0;
+        FisMul(r0, r1, r5);
+        r1 = r4;
+        uint16_t hi = r1;
+        FisMul(hi, r1, r2);
+        FisAsl(r0, c);  FisAsl(r0, c);  FisRor(r1, c);  FisRor(r0, c);
+        FisMul(r2, r3, r3);
+        FisMul(r4, r5, r5);
+        FisAdd(r5, r3, c);  FisAdc(r2, c);  FisAdd(r4, r2, c);
+        FisAdd(r0, r3, c);  FisAdc(r2, c);  FisAdd(r1, r2, c);
+        FisAshc(r2, r3, -5, c);
+    }
+    else  // FDIV: 006232
+    {
+        FisAsl(r2, c);  r0 = r2;  FisRol(r4, c);
+        r1 = r4;  FisAdcb(r1, c);
+        sign = r1;
+        r0 &= 0177400;  r2 &= ~r0;  c = true;  FisRorb(r2, c);
+        r1 &= 0177400;  r4 &= ~r1;  c = true;  FisRorb(r4, c);
+        r0 >>= 8;
+        if (r0 == 0)
+            return;
+        r1 >>= 8;
+        if (r1 == 0)
+            return;
+        exponent = (uint16_t)(r1 - r0 + 0200);
+        FisAshc(r2, r3, 7, c);
+        FisRor(r3, c);
+        FisDiv(r4, r5, r2);
+        r0 = (uint16_t)(r4 << 1);
+        FisMul(r0, r1, r3);
+        r0 = (uint16_t)(r0 - r5);
+        FisAsr(r0, c);  FisRor(r1, c);
+        r2 = (uint16_t)(0 - r2);
+        r2 = FisDiv(r0, r1, r2) ? 0177777 : 0;
+        r3 = r0;
+        FisAsl(r1, c);  FisRol(r3, c);
+        r2 = (uint16_t)(r2 + r4);
+    }
+
+    if (okRound)  // 006476
+    {
+        FisAsr(r2, c);  FisRor(r3, c);
+        if (r2 & 0400)
+        {
+            exponent++;
+            FisAsr(r2, c);  FisRor(r3, c);
+        }
+        for (;;)
+        {
+            FisAdc(r3, c);  FisAdcb(r2, c);
+            if (!c)
+                break;
+            exponent++;
+            FisAsr(r2, c);  FisRor(r3, c);
+        }
+    }
+
+    // 006524: pack the sign, the exponent and the mantissa
+    if (exponent & 0177400)
+        return;  // Overflow or underflow, the ROM returns zero
+    r2 = (uint16_t)((r2 & 0177400) | ((r2 << 1) & 0377));
+    r2 |= (uint16_t)(exponent << 8);
+    r2 = (uint16_t)((r2 >> 1) | ((sign & 1) << 15));
+    *pHi = r2;
+    *pLo = r3;
+}
+
 void CProcessor::ExecuteFIS()  // Floating point instruction set: FADD, FSUB, FMUL, FDIV
 {
     if (m_pBoard->GetSelRegister() & 0200)  // bit 7 set?
-        m_RSVDrq = true;  // Программа эмуляции FIS отсутствует, прерывание по резервному коду
-    else
-        m_FIS_rq = true;  // Прерывание обработки FIS
+        m_intrq |= INTRQ_RSVD;  // Программа эмуляции FIS отсутствует, прерывание по резервному коду
+    else if (!m_okNativeFIS || !ExecuteFISNative())
+        m_intrq |= INTRQ_FIS;  // Прерывание обработки FIS
+}
+
+// Does the same as the ROM routine for HALT vector 010, except the HALT mode registers and stack.
+// The operand block at (R): B hi, B lo, A hi, A lo; A <- A op B, R <- R + 4, NZVC from the result.
+bool CProcessor::ExecuteFISNative()
+{
+    uint8_t reg = m_instruction & 7;
+    if ((m_psw & PSW_HALT) != 0 || reg == 7)
+        return false;
+    uint16_t address = GetReg(reg);
+    if (address & 1)
+        return false;
+    // Operands outside of RAM: let the ROM routine do the bus error processing
+    for (uint16_t i = 0; i < 8; i += 2)
+    {
+        uint32_t offset;
+        if (m_pBoard->TranslateAddress((uint16_t)(address + i), false, false, &offset) > ADDRTYPE_RAM4)
+            return false;
+    }
+
+    uint16_t bhi = m_pBoard->GetWord(address, false);
+    uint16_t blo = m_pBoard->GetWord((uint16_t)(address + 2), false);
+    uint16_t ahi = m_pBoard->GetWord((uint16_t)(address + 4), false);
+    uint16_t alo = m_pBoard->GetWord((uint16_t)(address + 6), false);
+    uint16_t reshi, reslo;
+    CalculateFIS((m_instruction >> 3) & 3, ahi, alo, bhi, blo, &reshi, &reslo);
+    m_pBoard->SetWord((uint16_t)(address + 6), false, reslo);
+    m_pBoard->SetWord((uint16_t)(address + 4), false, reshi);
+    SetReg(reg, (uint16_t)(address + 4));
+
+    uint8_t new_psw = GetLPSW() & 0xF0;
+    if (reshi & 0100000) new_psw |= PSW_N;
+    if (reshi == 0) new_psw |= PSW_Z;
+    SetLPSW(new_psw);
+    m_internalTick = FIS_TIMING;
+    return true;
 }
 
 void CProcessor::ExecuteRUN()  // ПУСК / START
 {
     if ((m_psw & PSW_HALT) == 0)  // Эта команда выполняется только в режиме HALT
-        m_RSVDrq = true;
+        m_intrq |= INTRQ_RSVD;
     else
     {
         SetPC(m_savepc);        // СК <- КРСК
-        SetPSW(m_savepsw);      // РСП(8:0) <- КРСП(8:0)
+        SetPSW(GetCPSW());      // РСП(8:0) <- КРСП(8:0)
     }
 }
 
 void CProcessor::ExecuteHALT ()  // HALT - Останов
 {
-    m_HALTrq = true;
+    m_intrq |= INTRQ_HALT;
 }
 
 void CProcessor::ExecuteRCPC()  // ЧКСК - Чтение регистра копии счётчика команд
 {
     if ((m_psw & PSW_HALT) == 0)  // Эта команда выполняется только в режиме HALT
-        m_RSVDrq = true;
+        m_intrq |= INTRQ_RSVD;
     else
     {
         SetReg(0, m_savepc);        // R0 <- КРСК
@@ -700,17 +1342,17 @@ void CProcessor::ExecuteRCPC()  // ЧКСК - Чтение регистра ко
 void CProcessor::ExecuteRCPS()  // ЧКСП - Чтение регистра копии слова состояния процессора
 {
     if ((m_psw & PSW_HALT) == 0)  // Эта команда выполняется только в режиме HALT
-        m_RSVDrq = true;
+        m_intrq |= INTRQ_RSVD;
     else
     {
-        SetReg(0, m_savepsw);       // R0 <- КРСП
+        SetReg(0, GetCPSW());       // R0 <- КРСП
         m_internalTick = NOP_TIMING;
     }
 }
 void CProcessor::ExecuteWCPC()  // ЗКСК - Запись регистра копии счётчика команд
 {
     if ((m_psw & PSW_HALT) == 0)  // Эта команда выполняется только в режиме HALT
-        m_RSVDrq = true;
+        m_intrq |= INTRQ_RSVD;
     else
     {
         m_savepc = GetReg(0);       // КРСК <- R0
@@ -720,10 +1362,10 @@ void CProcessor::ExecuteWCPC()  // ЗКСК - Запись регистра ко
 void CProcessor::ExecuteWCPS()  // ЗКСП - Запись регистра копии слова состояния процессора
 {
     if ((m_psw & PSW_HALT) == 0)  // Эта команда выполняется только в режиме HALT
-        m_RSVDrq = true;
+        m_intrq |= INTRQ_RSVD;
     else
     {
-        m_savepsw = GetReg(0);      // КРСП <- R0
+        SetCPSW(GetReg(0));         // КРСП <- R0
         m_internalTick = NOP_TIMING;
     }
 }
@@ -732,7 +1374,7 @@ void CProcessor::ExecuteMFUS ()  // ЧЧП, move from user space - Чтение
 {
     if ((m_psw & PSW_HALT) == 0)  // Эта команда выполняется только в режиме HALT
     {
-        m_RSVDrq = true;
+        m_intrq |= INTRQ_RSVD;
         return;
     }
 
@@ -742,7 +1384,7 @@ void CProcessor::ExecuteMFUS ()  // ЧЧП, move from user space - Чтение
     uint16_t word = GetWord(addr);  // Read in USER mode
     SetHALT(true);
     SetReg(5, addr + 2);
-    if (!m_RPLYrq) SetReg(0, word);
+    if ((m_intrq & INTRQ_RPLY) == 0) SetReg(0, word);
 
     m_internalTick = MOV_TIMING[0][2] - 1;
 }
@@ -751,7 +1393,7 @@ void CProcessor::ExecuteMTUS()  // ЗЧП, move to user space - Запись в
 {
     if ((m_psw & PSW_HALT) == 0)  // Эта команда выполняется только в режиме HALT
     {
-        m_RSVDrq = true;
+        m_intrq |= INTRQ_RSVD;
         return;
     }
 
@@ -769,11 +1411,11 @@ void CProcessor::ExecuteRTI()  // RTI - Return from Interrupt - Возврат 
     uint16_t word;
     word = GetWord(GetSP());
     SetSP( GetSP() + 2 );
-    if (m_RPLYrq) return;
+    if (m_intrq & INTRQ_RPLY) return;
     SetPC(word);  // Pop PC
     word = GetWord ( GetSP() );  // Pop PSW --- saving HALT
     SetSP( GetSP() + 2 );
-    if (m_RPLYrq) return;
+    if (m_intrq & INTRQ_RPLY) return;
     if (GetPC() < 0160000)
         SetLPSW((uint8_t)(word & 0xff));
     else
@@ -786,11 +1428,11 @@ void CProcessor::ExecuteRTT ()  // RTT - Return from Trace Trap -- Возвра
     uint16_t word;
     word = GetWord(GetSP());
     SetSP( GetSP() + 2 );
-    if (m_RPLYrq) return;
+    if (m_intrq & INTRQ_RPLY) return;
     SetPC(word);  // Pop PC
     word = GetWord ( GetSP() );  // Pop PSW --- saving HALT
     SetSP( GetSP() + 2 );
-    if (m_RPLYrq) return;
+    if (m_intrq & INTRQ_RPLY) return;
     if (GetPC() < 0160000)
         SetLPSW((uint8_t)(word & 0xff));
     else
@@ -803,19 +1445,19 @@ void CProcessor::ExecuteRTT ()  // RTT - Return from Trace Trap -- Возвра
 
 void CProcessor::ExecuteBPT ()  // BPT - Breakpoint
 {
-    m_BPT_rq = true;
+    m_intrq |= INTRQ_BPT;
     m_internalTick = BPT_TIMING;
 }
 
 void CProcessor::ExecuteIOT ()  // IOT - I/O trap
 {
-    m_IOT_rq = true;
+    m_intrq |= INTRQ_IOT;
     m_internalTick = EMT_TIMING;
 }
 
 void CProcessor::ExecuteRESET ()  // Reset input/output devices -- Сброс внешних устройств
 {
-    m_EVNTrq = false;
+    m_intrq &= ~INTRQ_EVNT;
     m_pBoard->ResetDevices();  // INIT signal
 
     m_internalTick = RESET_TIMING;
@@ -827,7 +1469,7 @@ void CProcessor::ExecuteRTS ()  // RTS - return from subroutine - Возврат
     SetPC(GetReg(m_regdest));
     word = GetWord(GetSP());
     SetSP(GetSP() + 2);
-    if (m_RPLYrq) return;
+    if (m_intrq & INTRQ_RPLY) return;
     SetReg(m_regdest, word);
     m_internalTick = RTS_TIMING;
 }
@@ -847,811 +1489,817 @@ void CProcessor::ExecuteJMP ()  // JMP - jump: PC = &d (a-mode > 0)
 {
     if (m_methdest == 0)  // Неправильный метод адресации
     {
-        m_ILLGrq = true;
+        m_intrq |= INTRQ_ILLG;
         m_internalTick = EMT_TIMING;
     }
     else
     {
         uint16_t word;
         word = GetWordAddr(m_methdest, m_regdest);
-        if (m_RPLYrq) return;
+        if (m_intrq & INTRQ_RPLY) return;
         SetPC(word);
         m_internalTick = JMP_TIMING[m_methdest - 1];
     }
 }
 
+template<uint8_t methdest>
 void CProcessor::ExecuteSWAB ()
 {
     uint16_t ea = 0;
     uint16_t dst;
     uint8_t new_psw = GetLPSW() & 0xF0;
 
-    if (m_methdest)
+    if (methdest)
     {
-        ea = GetWordAddr(m_methdest, m_regdest);
-        if (m_RPLYrq) return;
+        ea = GetWordAddr<methdest>(m_regdest);
+        if (m_intrq & INTRQ_RPLY) return;
         dst = GetWord(ea);
-        if (m_RPLYrq) return;
+        if (m_intrq & INTRQ_RPLY) return;
     }
     else
         dst = GetReg(m_regdest);
 
     dst = ((dst >> 8) & 0377) | (dst << 8);
 
-    if (m_methdest)
+    if (methdest)
         SetWordRMW(ea, dst);  // RMW write
     else
         SetReg(m_regdest, dst);
 
-    if (m_RPLYrq) return;
+    if (m_intrq & INTRQ_RPLY) return;
 
     if ((dst & 0200) != 0) new_psw |= PSW_N;
     if ((uint8_t)(dst & 0xff) == 0) new_psw |= PSW_Z;
     SetLPSW(new_psw);
-    m_internalTick = MOV_TIMING[m_methdest][m_methdest] - 1;
+    m_internalTick = MOV_TIMING[methdest][methdest] - 1;
 }
 
+template<uint8_t methdest>
 void CProcessor::ExecuteCLR ()  // CLR
 {
     uint16_t dst_addr;
 
-    if (m_methdest)
+    if (methdest)
     {
-        dst_addr = GetWordAddr(m_methdest, m_regdest);
-        if (m_RPLYrq) return;
+        dst_addr = GetWordAddr<methdest>(m_regdest);
+        if (m_intrq & INTRQ_RPLY) return;
         SetWord(dst_addr, 0);
-        if (m_RPLYrq) return;
+        if (m_intrq & INTRQ_RPLY) return;
     }
     else
         SetReg(m_regdest, 0);
 
-    SetLPSW((GetLPSW() & 0xF0) | PSW_Z);
-    m_internalTick = CLR_TIMING[m_methdest];
+    SetResultFlags(LAZY_TST, 0);
+    m_internalTick = CLR_TIMING[methdest];
 }
 
+template<uint8_t methdest>
 void CProcessor::ExecuteCLRB ()  // CLRB
 {
     uint16_t dst_addr;
 
-    if (m_methdest)
+    if (methdest)
     {
-        dst_addr = GetByteAddr(m_methdest, m_regdest);
-        if (m_RPLYrq) return;
+        dst_addr = GetByteAddr<methdest>(m_regdest);
+        if (m_intrq & INTRQ_RPLY) return;
         GetByte(dst_addr);  // RMW read
-        if (m_RPLYrq) return;
+        if (m_intrq & INTRQ_RPLY) return;
         SetByteRMW(dst_addr, 0);  // RMW write
-        if (m_RPLYrq) return;
+        if (m_intrq & INTRQ_RPLY) return;
     }
     else
         SetLReg(m_regdest, 0);
 
-    SetLPSW((GetLPSW() & 0xF0) | PSW_Z);
-    m_internalTick = CLR_TIMING[m_methdest];
+    SetResultFlags(LAZY_TST, 0);
+    m_internalTick = CLR_TIMING[methdest];
 }
 
+template<uint8_t methdest>
 void CProcessor::ExecuteCOM()  // COM
 {
     uint16_t ea = 0;
     uint8_t new_psw = GetLPSW() & 0xF0;
     uint16_t dst;
 
-    if (m_methdest)
+    if (methdest)
     {
-        ea = GetWordAddr(m_methdest, m_regdest);
-        if (m_RPLYrq) return;
+        ea = GetWordAddr<methdest>(m_regdest);
+        if (m_intrq & INTRQ_RPLY) return;
         dst = GetWord(ea);  // RMW read
-        if (m_RPLYrq) return;
+        if (m_intrq & INTRQ_RPLY) return;
     }
     else
         dst = GetReg(m_regdest);
 
     dst = ~dst;
 
-    if (m_methdest)
+    if (methdest)
         SetWordRMW(ea, dst);  // RMW write
     else
         SetReg(m_regdest, dst);
-    if (m_RPLYrq) return;
+    if (m_intrq & INTRQ_RPLY) return;
 
     if (dst & 0100000) new_psw |= PSW_N;
     if (dst == 0) new_psw |= PSW_Z;
     new_psw |= PSW_C;
     SetLPSW(new_psw);
-    m_internalTick = CLR_TIMING[m_methdest];
+    m_internalTick = CLR_TIMING[methdest];
 }
+template<uint8_t methdest>
 void CProcessor::ExecuteCOMB()  // COM
 {
     uint16_t ea = 0;
     uint8_t new_psw = GetLPSW() & 0xF0;
     uint8_t dst;
 
-    if (m_methdest)
+    if (methdest)
     {
-        ea = GetByteAddr(m_methdest, m_regdest);
-        if (m_RPLYrq) return;
+        ea = GetByteAddr<methdest>(m_regdest);
+        if (m_intrq & INTRQ_RPLY) return;
         dst = GetByte(ea);  // RMW read
-        if (m_RPLYrq) return;
+        if (m_intrq & INTRQ_RPLY) return;
     }
     else
         dst = GetLReg(m_regdest);
 
     dst = ~dst;
 
-    if (m_methdest)
+    if (methdest)
         SetByteRMW(ea, dst);  // RMW write
     else
         SetLReg(m_regdest, dst);
-    if (m_RPLYrq) return;
+    if (m_intrq & INTRQ_RPLY) return;
 
     if (dst & 0200) new_psw |= PSW_N;
     if (dst == 0) new_psw |= PSW_Z;
     new_psw |= PSW_C;
     SetLPSW(new_psw);
-    m_internalTick = CLR_TIMING[m_methdest];
+    m_internalTick = CLR_TIMING[methdest];
 }
 
+template<uint8_t methdest>
 void CProcessor::ExecuteINC()  // INC - Инкремент
 {
     uint16_t ea = 0;
-    uint8_t new_psw = GetLPSW() & 0xF1;
     uint16_t dst;
 
-    if (m_methdest)
+    if (methdest)
     {
-        ea = GetWordAddr(m_methdest, m_regdest);
-        if (m_RPLYrq) return;
+        ea = GetWordAddr<methdest>(m_regdest);
+        if (m_intrq & INTRQ_RPLY) return;
         dst = GetWord(ea);
-        if (m_RPLYrq) return;
+        if (m_intrq & INTRQ_RPLY) return;
     }
     else
         dst = GetReg(m_regdest);
 
     dst = dst + 1;
 
-    if (m_methdest)
+    if (methdest)
         SetWordRMW(ea, dst);  // RMW write
     else
         SetReg(m_regdest, dst);
-    if (m_RPLYrq) return;
+    if (m_intrq & INTRQ_RPLY) return;
 
-    if (dst & 0100000) new_psw |= PSW_N;
-    if (dst == 0) new_psw |= PSW_Z;
-    if (dst == 0100000) new_psw |= PSW_V;
-    SetLPSW(new_psw);
-    m_internalTick = CLR_TIMING[m_methdest];
+    SetResultFlags(LAZY_INC, dst);
+    m_internalTick = CLR_TIMING[methdest];
 }
+template<uint8_t methdest>
 void CProcessor::ExecuteINCB()  // INCB - Инкремент
 {
     uint16_t ea = 0;
-    uint8_t new_psw = GetLPSW() & 0xF1;
     uint8_t dst;
 
-    if (m_methdest)
+    if (methdest)
     {
-        ea = GetByteAddr(m_methdest, m_regdest);
-        if (m_RPLYrq) return;
+        ea = GetByteAddr<methdest>(m_regdest);
+        if (m_intrq & INTRQ_RPLY) return;
         dst = GetByte(ea);  // RMW read
-        if (m_RPLYrq) return;
+        if (m_intrq & INTRQ_RPLY) return;
     }
     else
         dst = GetLReg(m_regdest);
 
     dst = dst + 1;
 
-    if (m_methdest)
+    if (methdest)
         SetByteRMW(ea, dst);  // RMW write
     else
         SetLReg(m_regdest, dst);
-    if (m_RPLYrq) return;
+    if (m_intrq & INTRQ_RPLY) return;
 
-    if (dst & 0200) new_psw |= PSW_N;
-    if (dst == 0) new_psw |= PSW_Z;
-    if (dst == 0200) new_psw |= PSW_V;
-    SetLPSW(new_psw);
-    m_internalTick = CLR_TIMING[m_methdest];
+    SetResultFlags(LAZY_INC, (uint16_t)(dst << 8));
+    m_internalTick = CLR_TIMING[methdest];
 }
 
+template<uint8_t methdest>
 void CProcessor::ExecuteDEC()  // DEC - Декремент
 {
     uint16_t ea = 0;
-    uint8_t new_psw = GetLPSW() & 0xF1;
     uint16_t dst;
 
-    if (m_methdest)
+    if (methdest)
     {
-        ea = GetWordAddr(m_methdest, m_regdest);
-        if (m_RPLYrq) return;
+        ea = GetWordAddr<methdest>(m_regdest);
+        if (m_intrq & INTRQ_RPLY) return;
         dst = GetWord(ea);  // RMW read
-        if (m_RPLYrq) return;
+        if (m_intrq & INTRQ_RPLY) return;
     }
     else
         dst = GetReg(m_regdest);
 
     dst = dst - 1;
 
-    if (m_methdest)
+    if (methdest)
         SetWordRMW(ea, dst);  // RMW write
     else
         SetReg(m_regdest, dst);
-    if (m_RPLYrq) return;
+    if (m_intrq & INTRQ_RPLY) return;
 
-    if (dst & 0100000) new_psw |= PSW_N;
-    if (dst == 0) new_psw |= PSW_Z;
-    if (dst == 077777) new_psw |= PSW_V;
-    SetLPSW(new_psw);
-    m_internalTick = CLR_TIMING[m_methdest];
+    SetResultFlags(LAZY_DEC, dst, (uint16_t)(dst + 1));
+    m_internalTick = CLR_TIMING[methdest];
 }
 
+template<uint8_t methdest>
 void CProcessor::ExecuteDECB()  // DECB - Декремент
 {
     uint16_t ea = 0;
-    uint8_t new_psw = GetLPSW() & 0xF1;
     uint8_t dst;
 
-    if (m_methdest)
+    if (methdest)
     {
-        ea = GetByteAddr(m_methdest, m_regdest);
-        if (m_RPLYrq) return;
+        ea = GetByteAddr<methdest>(m_regdest);
+        if (m_intrq & INTRQ_RPLY) return;
         dst = GetByte(ea);  // RMW read
-        if (m_RPLYrq) return;
+        if (m_intrq & INTRQ_RPLY) return;
     }
     else
         dst = GetLReg(m_regdest);
 
     dst = dst - 1;
 
-    if (m_methdest)
+    if (methdest)
         SetByteRMW(ea, dst);  // RMW write
     else
         SetLReg(m_regdest, dst);
-    if (m_RPLYrq) return;
+    if (m_intrq & INTRQ_RPLY) return;
 
-    if (dst & 0200) new_psw |= PSW_N;
-    if (dst == 0) new_psw |= PSW_Z;
-    if (dst == 0177) new_psw |= PSW_V;
-    SetLPSW(new_psw);
-    m_internalTick = CLR_TIMING[m_methdest];
+    SetResultFlags(LAZY_DEC, (uint16_t)(dst << 8), (uint16_t)((uint8_t)(dst + 1) << 8));
+    m_internalTick = CLR_TIMING[methdest];
 }
 
+template<uint8_t methdest>
 void CProcessor::ExecuteNEG()
 {
     uint16_t ea = 0;
     uint8_t new_psw = GetLPSW() & 0xF0;
     uint16_t dst;
 
-    if (m_methdest)
+    if (methdest)
     {
-        ea = GetWordAddr(m_methdest, m_regdest);
-        if (m_RPLYrq) return;
+        ea = GetWordAddr<methdest>(m_regdest);
+        if (m_intrq & INTRQ_RPLY) return;
         dst = GetWord(ea);  // RMW read
-        if (m_RPLYrq) return;
+        if (m_intrq & INTRQ_RPLY) return;
     }
     else
         dst = GetReg(m_regdest);
 
     dst = 0 - dst;
 
-    if (m_methdest)
+    if (methdest)
         SetWordRMW(ea, dst);  // RMW write
     else
         SetReg(m_regdest, dst);
-    if (m_RPLYrq) return;
+    if (m_intrq & INTRQ_RPLY) return;
 
     if (dst & 0100000) new_psw |= PSW_N;
     if (dst == 0) new_psw |= PSW_Z;
     if (dst == 0100000) new_psw |= PSW_V;
     if (dst != 0) new_psw |= PSW_C;
     SetLPSW(new_psw);
-    m_internalTick = CLR_TIMING[m_methdest];
+    m_internalTick = CLR_TIMING[methdest];
 }
 
+template<uint8_t methdest>
 void CProcessor::ExecuteNEGB()
 {
     uint16_t ea = 0;
     uint8_t new_psw = GetLPSW() & 0xF0;
     uint8_t dst;
 
-    if (m_methdest)
+    if (methdest)
     {
-        ea = GetByteAddr(m_methdest, m_regdest);
-        if (m_RPLYrq) return;
+        ea = GetByteAddr<methdest>(m_regdest);
+        if (m_intrq & INTRQ_RPLY) return;
         dst = GetByte(ea);  // RMW read
-        if (m_RPLYrq) return;
+        if (m_intrq & INTRQ_RPLY) return;
     }
     else
         dst = GetLReg(m_regdest);
 
     dst = 0 - dst ;
 
-    if (m_methdest)
+    if (methdest)
         SetByteRMW(ea, dst);  // RMW write
     else
         SetLReg(m_regdest, dst);
-    if (m_RPLYrq) return;
+    if (m_intrq & INTRQ_RPLY) return;
 
     if (dst & 0200) new_psw |= PSW_N;
     if (dst == 0) new_psw |= PSW_Z;
     if (dst == 0200) new_psw |= PSW_V;
     if (dst != 0) new_psw |= PSW_C;
     SetLPSW(new_psw);
-    m_internalTick = CLR_TIMING[m_methdest];
+    m_internalTick = CLR_TIMING[methdest];
 }
 
+template<uint8_t methdest>
 void CProcessor::ExecuteADC()
 {
     uint16_t ea = 0;
     uint8_t new_psw = GetLPSW() & 0xF0;
     uint16_t dst;
 
-    if (m_methdest)
+    if (methdest)
     {
-        ea = GetWordAddr(m_methdest, m_regdest);
-        if (m_RPLYrq) return;
+        ea = GetWordAddr<methdest>(m_regdest);
+        if (m_intrq & INTRQ_RPLY) return;
         dst = GetWord(ea);  // RMW read
-        if (m_RPLYrq) return;
+        if (m_intrq & INTRQ_RPLY) return;
     }
     else
         dst = GetReg(m_regdest);
 
     dst = dst + (GetC() ? 1 : 0);
 
-    if (m_methdest)
+    if (methdest)
         SetWordRMW(ea, dst);  // RMW write
     else
         SetReg(m_regdest, dst);
-    if (m_RPLYrq) return;
+    if (m_intrq & INTRQ_RPLY) return;
 
     if (dst & 0100000) new_psw |= PSW_N;
     if (dst == 0) new_psw |= PSW_Z;
     if ((dst == 0100000) && GetC()) new_psw |= PSW_V;
     if ((dst == 0) && GetC()) new_psw |= PSW_C;
     SetLPSW(new_psw);
-    m_internalTick = CLR_TIMING[m_methdest];
+    m_internalTick = CLR_TIMING[methdest];
 }
 
+template<uint8_t methdest>
 void CProcessor::ExecuteADCB()  // ADCB
 {
     uint16_t ea = 0;
     uint8_t new_psw = GetLPSW() & 0xF0;
     uint8_t dst;
 
-    if (m_methdest)
+    if (methdest)
     {
-        ea = GetByteAddr(m_methdest, m_regdest);
-        if (m_RPLYrq) return;
+        ea = GetByteAddr<methdest>(m_regdest);
+        if (m_intrq & INTRQ_RPLY) return;
         dst = GetByte(ea);  // RMW read
-        if (m_RPLYrq) return;
+        if (m_intrq & INTRQ_RPLY) return;
     }
     else
         dst = GetLReg(m_regdest);
 
     dst = dst + (GetC() ? 1 : 0);
 
-    if (m_methdest)
+    if (methdest)
         SetByteRMW(ea, dst);  // RMW write
     else
         SetLReg(m_regdest, dst);
-    if (m_RPLYrq) return;
+    if (m_intrq & INTRQ_RPLY) return;
 
     if (dst & 0200) new_psw |= PSW_N;
     if (dst == 0) new_psw |= PSW_Z;
     if ((dst == 0200) && GetC()) new_psw |= PSW_V;
     if ((dst == 0) && GetC()) new_psw |= PSW_C;
     SetLPSW(new_psw);
-    m_internalTick = CLR_TIMING[m_methdest];
+    m_internalTick = CLR_TIMING[methdest];
 }
 
+template<uint8_t methdest>
 void CProcessor::ExecuteSBC()
 {
     uint16_t ea = 0;
     uint8_t new_psw = GetLPSW() & 0xF0;
     uint16_t dst;
 
-    if (m_methdest)
+    if (methdest)
     {
-        ea = GetWordAddr(m_methdest, m_regdest);
-        if (m_RPLYrq) return;
+        ea = GetWordAddr<methdest>(m_regdest);
+        if (m_intrq & INTRQ_RPLY) return;
         dst = GetWord(ea);  // RMW read
-        if (m_RPLYrq) return;
+        if (m_intrq & INTRQ_RPLY) return;
     }
     else
         dst = GetReg(m_regdest);
 
     dst = dst - (GetC() ? 1 : 0);
 
-    if (m_methdest)
+    if (methdest)
         SetWordRMW(ea, dst);  // RMW write
     else
         SetReg(m_regdest, dst);
-    if (m_RPLYrq) return;
+    if (m_intrq & INTRQ_RPLY) return;
 
     if (dst & 0100000) new_psw |= PSW_N;
     if (dst == 0) new_psw |= PSW_Z;
     if ((dst == 077777) && GetC()) new_psw |= PSW_V;
     if ((dst == 0177777) && GetC()) new_psw |= PSW_C;
     SetLPSW(new_psw);
-    m_internalTick = CLR_TIMING[m_methdest];
+    m_internalTick = CLR_TIMING[methdest];
 }
 
+template<uint8_t methdest>
 void CProcessor::ExecuteSBCB()
 {
     uint16_t ea = 0;
     uint8_t new_psw = GetLPSW() & 0xF0;
     uint8_t dst;
 
-    if (m_methdest)
+    if (methdest)
     {
-        ea = GetByteAddr(m_methdest, m_regdest);
-        if (m_RPLYrq) return;
+        ea = GetByteAddr<methdest>(m_regdest);
+        if (m_intrq & INTRQ_RPLY) return;
         dst = GetByte(ea);  // RMW read
-        if (m_RPLYrq) return;
+        if (m_intrq & INTRQ_RPLY) return;
     }
     else
         dst = GetLReg(m_regdest);
 
     dst = dst - (GetC() ? 1 : 0);
 
-    if (m_methdest)
+    if (methdest)
         SetByteRMW(ea, dst);  // RMW write
     else
         SetLReg(m_regdest, dst);
-    if (m_RPLYrq) return;
+    if (m_intrq & INTRQ_RPLY) return;
 
     if (dst & 0200) new_psw |= PSW_N;
     if (dst == 0) new_psw |= PSW_Z;
     if ((dst == 0177) && GetC()) new_psw |= PSW_V;
     if ((dst == 0377) && GetC()) new_psw |= PSW_C;
     SetLPSW(new_psw);
-    m_internalTick = CLR_TIMING[m_methdest];
+    m_internalTick = CLR_TIMING[methdest];
 }
 
+template<uint8_t methdest>
 void CProcessor::ExecuteTST()  // TST
 {
-    uint8_t new_psw = GetLPSW() & 0xF0;
     uint16_t dst;
 
-    if (m_methdest)
+    if (methdest)
     {
-        uint16_t ea = GetWordAddr(m_methdest, m_regdest);
-        if (m_RPLYrq) return;
+        uint16_t ea = GetWordAddr<methdest>(m_regdest);
+        if (m_intrq & INTRQ_RPLY) return;
         dst = GetWord(ea);
-        if (m_RPLYrq) return;
+        if (m_intrq & INTRQ_RPLY) return;
     }
     else
         dst = GetReg(m_regdest);
 
-    if (dst & 0100000) new_psw |= PSW_N;
-    if (dst == 0) new_psw |= PSW_Z;
-    SetLPSW(new_psw);
-    m_internalTick = TST_TIMING[m_methdest];
+    SetResultFlags(LAZY_TST, dst);
+    m_internalTick = TST_TIMING[methdest];
 }
 
+template<uint8_t methdest>
 void CProcessor::ExecuteTSTB()  // TSTB
 {
-    uint8_t new_psw = GetLPSW() & 0xF0;
     uint8_t dst;
 
-    if (m_methdest)
+    if (methdest)
     {
-        uint16_t ea = GetByteAddr(m_methdest, m_regdest);
-        if (m_RPLYrq) return;
+        uint16_t ea = GetByteAddr<methdest>(m_regdest);
+        if (m_intrq & INTRQ_RPLY) return;
         dst = GetByte(ea);
-        if (m_RPLYrq) return;
+        if (m_intrq & INTRQ_RPLY) return;
     }
     else
         dst = GetLReg(m_regdest);
 
-    if (dst & 0200) new_psw |= PSW_N;
-    if (dst == 0) new_psw |= PSW_Z;
-    SetLPSW(new_psw);
-    m_internalTick = TST_TIMING[m_methdest];
+    SetResultFlags(LAZY_TST, (uint16_t)(dst << 8));
+    m_internalTick = TST_TIMING[methdest];
 }
 
+template<uint8_t methdest>
 void CProcessor::ExecuteROR()  // ROR
 {
     uint16_t ea = 0;
     uint8_t new_psw = GetLPSW() & 0xF0;
     uint16_t src;
 
-    if (m_methdest)
+    if (methdest)
     {
-        ea = GetWordAddr(m_methdest, m_regdest);
-        if (m_RPLYrq) return;
+        ea = GetWordAddr<methdest>(m_regdest);
+        if (m_intrq & INTRQ_RPLY) return;
         src = GetWord(ea);  // RMW read
-        if (m_RPLYrq) return;
+        if (m_intrq & INTRQ_RPLY) return;
     }
     else
         src = GetReg(m_regdest);
 
     uint16_t dst = (src >> 1) | (GetC() ? 0100000 : 0);
 
-    if (m_methdest)
+    if (methdest)
         SetWordRMW(ea, dst);  // RMW write
     else
         SetReg(m_regdest, dst);
-    if (m_RPLYrq) return;
+    if (m_intrq & INTRQ_RPLY) return;
 
     if (dst & 0100000) new_psw |= PSW_N;
     if (dst == 0) new_psw |= PSW_Z;
     if (src & 1) new_psw |= PSW_C;
     if (((new_psw & PSW_N) != 0) != ((new_psw & PSW_C) != 0)) new_psw |= PSW_V;
     SetLPSW(new_psw);
-    m_internalTick = CLR_TIMING[m_methdest];
+    m_internalTick = CLR_TIMING[methdest];
 }
 
+template<uint8_t methdest>
 void CProcessor::ExecuteRORB()  // RORB
 {
     uint16_t ea = 0;
     uint8_t new_psw = GetLPSW() & 0xF0;
     uint8_t src;
 
-    if (m_methdest)
+    if (methdest)
     {
-        ea = GetByteAddr(m_methdest, m_regdest);
-        if (m_RPLYrq) return;
+        ea = GetByteAddr<methdest>(m_regdest);
+        if (m_intrq & INTRQ_RPLY) return;
         src = GetByte(ea);  // RMW read
-        if (m_RPLYrq) return;
+        if (m_intrq & INTRQ_RPLY) return;
     }
     else
         src = GetLReg(m_regdest);
 
     uint8_t dst = (src >> 1) | (GetC() ? 0200 : 0);
 
-    if (m_methdest)
+    if (methdest)
         SetByteRMW(ea, dst);  // RMW write
     else
         SetLReg(m_regdest, dst);
-    if (m_RPLYrq) return;
+    if (m_intrq & INTRQ_RPLY) return;
 
     if (dst & 0200) new_psw |= PSW_N;
     if (dst == 0) new_psw |= PSW_Z;
     if (src & 1) new_psw |= PSW_C;
     if (((new_psw & PSW_N) != 0) != ((new_psw & PSW_C) != 0)) new_psw |= PSW_V;
     SetLPSW(new_psw);
-    m_internalTick = CLR_TIMING[m_methdest];
+    m_internalTick = CLR_TIMING[methdest];
 }
 
+template<uint8_t methdest>
 void CProcessor::ExecuteROL()  // ROL
 {
     uint16_t ea = 0;
     uint8_t new_psw = GetLPSW() & 0xF0;
     uint16_t src, dst;
 
-    if (m_methdest)
+    if (methdest)
     {
-        ea = GetWordAddr((uint8_t)m_methdest, (uint8_t)m_regdest);
-        if (m_RPLYrq) return;
+        ea = GetWordAddr<methdest>(m_regdest);
+        if (m_intrq & INTRQ_RPLY) return;
         src = GetWord(ea);  // RMW read
-        if (m_RPLYrq) return;
+        if (m_intrq & INTRQ_RPLY) return;
     }
     else
         src = GetReg(m_regdest);
 
     dst = (src << 1) | (GetC() ? 1 : 0);
 
-    if (m_methdest)
+    if (methdest)
         SetWordRMW(ea, dst);  // RMW write
     else
         SetReg(m_regdest, dst);
-    if (m_RPLYrq) return;
+    if (m_intrq & INTRQ_RPLY) return;
 
     if (dst & 0100000) new_psw |= PSW_N;
     if (dst == 0) new_psw |= PSW_Z;
     if (src & 0100000) new_psw |= PSW_C;
     if (((new_psw & PSW_N) != 0) != ((new_psw & PSW_C) != 0)) new_psw |= PSW_V;
     SetLPSW(new_psw);
-    m_internalTick = CLR_TIMING[m_methdest];
+    m_internalTick = CLR_TIMING[methdest];
 }
 
+template<uint8_t methdest>
 void CProcessor::ExecuteROLB()  // ROLB
 {
     uint16_t ea = 0;
     uint8_t new_psw = GetLPSW() & 0xF0;
     uint8_t src, dst;
 
-    if (m_methdest)
+    if (methdest)
     {
-        ea = GetByteAddr(m_methdest, m_regdest);
-        if (m_RPLYrq) return;
+        ea = GetByteAddr<methdest>(m_regdest);
+        if (m_intrq & INTRQ_RPLY) return;
         src = GetByte(ea);  // RMW read
-        if (m_RPLYrq) return;
+        if (m_intrq & INTRQ_RPLY) return;
     }
     else
         src = GetLReg(m_regdest);
 
     dst = (src << 1) | (GetC() ? 1 : 0);
 
-    if (m_methdest)
+    if (methdest)
         SetByteRMW(ea, dst);  // RMW write
     else
         SetLReg(m_regdest, dst);
-    if (m_RPLYrq) return;
+    if (m_intrq & INTRQ_RPLY) return;
 
     if (dst & 0200) new_psw |= PSW_N;
     if (dst == 0) new_psw |= PSW_Z;
     if (src & 0200) new_psw |= PSW_C;
     if (((new_psw & PSW_N) != 0) != ((new_psw & PSW_C) != 0)) new_psw |= PSW_V;
     SetLPSW(new_psw);
-    m_internalTick = CLR_TIMING[m_methdest];
+    m_internalTick = CLR_TIMING[methdest];
 }
 
+template<uint8_t methdest>
 void CProcessor::ExecuteASR()  // ASR
 {
     uint16_t ea = 0;
     uint8_t new_psw = GetLPSW() & 0xF0;
     uint16_t src, dst;
 
-    if (m_methdest)
+    if (methdest)
     {
-        ea = GetWordAddr(m_methdest, m_regdest);
-        if (m_RPLYrq) return;
+        ea = GetWordAddr<methdest>(m_regdest);
+        if (m_intrq & INTRQ_RPLY) return;
         src = GetWord(ea);  // RMW read
-        if (m_RPLYrq) return;
+        if (m_intrq & INTRQ_RPLY) return;
     }
     else
         src = GetReg(m_regdest);
 
     dst = (src >> 1) | (src & 0100000);
 
-    if (m_methdest)
+    if (methdest)
         SetWordRMW(ea, dst);  // RMW write
     else
         SetReg(m_regdest, dst);
-    if (m_RPLYrq) return;
+    if (m_intrq & INTRQ_RPLY) return;
 
     if (dst & 0100000) new_psw |= PSW_N;
     if (dst == 0) new_psw |= PSW_Z;
     if (src & 1) new_psw |= PSW_C;
     if (((new_psw & PSW_N) != 0) != ((new_psw & PSW_C) != 0)) new_psw |= PSW_V;
     SetLPSW(new_psw);
-    m_internalTick = CLR_TIMING[m_methdest];
+    m_internalTick = CLR_TIMING[methdest];
 }
 
+template<uint8_t methdest>
 void CProcessor::ExecuteASRB()  // ASRB
 {
     uint16_t ea = 0;
     uint8_t new_psw = GetLPSW() & 0xF0;
     uint8_t src, dst;
 
-    if (m_methdest)
+    if (methdest)
     {
-        ea = GetByteAddr(m_methdest, m_regdest);
-        if (m_RPLYrq) return;
+        ea = GetByteAddr<methdest>(m_regdest);
+        if (m_intrq & INTRQ_RPLY) return;
         src = GetByte(ea);  // RMW read
-        if (m_RPLYrq) return;
+        if (m_intrq & INTRQ_RPLY) return;
     }
     else
         src = GetLReg(m_regdest);
 
     dst = (src >> 1) | (src & 0200);
 
-    if (m_methdest)
+    if (methdest)
         SetByteRMW(ea, dst);  // RMW write
     else
         SetLReg(m_regdest, dst);
-    if (m_RPLYrq) return;
+    if (m_intrq & INTRQ_RPLY) return;
 
     if (dst & 0200) new_psw |= PSW_N;
     if (dst == 0) new_psw |= PSW_Z;
     if (src & 1) new_psw |= PSW_C;
     if (((new_psw & PSW_N) != 0) != ((new_psw & PSW_C) != 0)) new_psw |= PSW_V;
     SetLPSW(new_psw);
-    m_internalTick = CLR_TIMING[m_methdest];
+    m_internalTick = CLR_TIMING[methdest];
 }
 
+template<uint8_t methdest>
 void CProcessor::ExecuteASL()  // ASL
 {
     uint16_t ea = 0;
     uint8_t new_psw = GetLPSW() & 0xF0;
     uint16_t src, dst;
 
-    if (m_methdest)
+    if (methdest)
     {
-        ea = GetWordAddr(m_methdest, m_regdest);
-        if (m_RPLYrq) return;
+        ea = GetWordAddr<methdest>(m_regdest);
+        if (m_intrq & INTRQ_RPLY) return;
         src = GetWord(ea);  // RMW write
-        if (m_RPLYrq) return;
+        if (m_intrq & INTRQ_RPLY) return;
     }
     else
         src = GetReg(m_regdest);
 
     dst = src << 1;
 
-    if (m_methdest)
+    if (methdest)
         SetWordRMW(ea, dst);  // RMW write
     else
         SetReg(m_regdest, dst);
-    if (m_RPLYrq) return;
+    if (m_intrq & INTRQ_RPLY) return;
 
     if (dst & 0100000) new_psw |= PSW_N;
     if (dst == 0) new_psw |= PSW_Z;
     if (src & 0100000) new_psw |= PSW_C;
     if (((new_psw & PSW_N) != 0) != ((new_psw & PSW_C) != 0)) new_psw |= PSW_V;
     SetLPSW(new_psw);
-    m_internalTick = CLR_TIMING[m_methdest];
+    m_internalTick = CLR_TIMING[methdest];
 }
 
+template<uint8_t methdest>
 void CProcessor::ExecuteASLB()  // ASLB
 {
     uint16_t ea = 0;
     uint8_t new_psw = GetLPSW() & 0xF0;
     uint8_t src, dst;
 
-    if (m_methdest)
+    if (methdest)
     {
-        ea = GetByteAddr(m_methdest, m_regdest);
-        if (m_RPLYrq) return;
+        ea = GetByteAddr<methdest>(m_regdest);
+        if (m_intrq & INTRQ_RPLY) return;
         src = GetByte(ea);  // RMW read
-        if (m_RPLYrq) return;
+        if (m_intrq & INTRQ_RPLY) return;
     }
     else
         src = GetLReg(m_regdest);
 
     dst = src << 1;
 
-    if (m_methdest)
+    if (methdest)
         SetByteRMW(ea, dst);  // RMW write
     else
         SetLReg(m_regdest, dst);
-    if (m_RPLYrq) return;
+    if (m_intrq & INTRQ_RPLY) return;
 
     if (dst & 0200) new_psw |= PSW_N;
     if (dst == 0) new_psw |= PSW_Z;
     if (src & 0200) new_psw |= PSW_C;
     if (((new_psw & PSW_N) != 0) != ((new_psw & PSW_C) != 0)) new_psw |= PSW_V;
     SetLPSW(new_psw);
-    m_internalTick = CLR_TIMING[m_methdest];
+    m_internalTick = CLR_TIMING[methdest];
 }
 
+template<uint8_t methdest>
 void CProcessor::ExecuteSXT ()  // SXT - sign-extend
 {
     uint8_t new_psw = GetLPSW() & 0xF9;
-    if (m_methdest)
+    if (methdest)
     {
-        uint16_t ea = GetWordAddr(m_methdest, m_regdest);
-        if (m_RPLYrq) return;
+        uint16_t ea = GetWordAddr<methdest>(m_regdest);
+        if (m_intrq & INTRQ_RPLY) return;
         SetWord(ea, GetN() ? 0177777 : 0);
-        if (m_RPLYrq) return;
+        if (m_intrq & INTRQ_RPLY) return;
     }
     else
         SetReg(m_regdest, GetN() ? 0177777 : 0); //sign extend
 
     if (!GetN()) new_psw |= PSW_Z;
     SetLPSW(new_psw);
-    m_internalTick = CLR_TIMING[m_methdest];
+    m_internalTick = CLR_TIMING[methdest];
 }
 
+template<uint8_t methdest>
 void CProcessor::ExecuteMTPS ()  // MTPS - move to PS
 {
     uint8_t dst;
-    if (m_methdest)
+    if (methdest)
     {
-        uint16_t ea = GetByteAddr(m_methdest, m_regdest);
-        if (m_RPLYrq) return;
+        uint16_t ea = GetByteAddr<methdest>(m_regdest);
+        if (m_intrq & INTRQ_RPLY) return;
         dst = GetByte(ea);
-        if (m_RPLYrq) return;
+        if (m_intrq & INTRQ_RPLY) return;
     }
     else
         dst = GetLReg(m_regdest);
 
     SetLPSW((GetLPSW() & 0x10) | (dst & 0xEF));
     SetPC(GetPC());
-    m_internalTick = MTPS_TIMING[m_methdest];
+    m_internalTick = MTPS_TIMING[methdest];
 }
 
+template<uint8_t methdest>
 void CProcessor::ExecuteMFPS ()  // MFPS - move from PS
 {
     uint8_t psw = GetLPSW();
     uint8_t new_psw = psw & 0xF1;
 
-    if (m_methdest)
+    if (methdest)
     {
-        uint16_t ea = GetByteAddr(m_methdest, m_regdest);
-        if (m_RPLYrq) return;
+        uint16_t ea = GetByteAddr<methdest>(m_regdest);
+        if (m_intrq & INTRQ_RPLY) return;
         GetByte(ea);  // RMW write
-        if (m_RPLYrq) return;
+        if (m_intrq & INTRQ_RPLY) return;
         SetByteRMW(ea, psw);  // RMW write
-        if (m_RPLYrq) return;
+        if (m_intrq & INTRQ_RPLY) return;
     }
     else
         SetReg(m_regdest, (uint16_t)(signed short)(char)psw); //sign extend
@@ -1659,7 +2307,7 @@ void CProcessor::ExecuteMFPS ()  // MFPS - move from PS
     if (psw & 0200) new_psw |= PSW_N;
     if (psw == 0) new_psw |= PSW_Z;
     SetLPSW(new_psw);
-    m_internalTick = CLR_TIMING[m_methdest];
+    m_internalTick = CLR_TIMING[methdest];
 }
 
 void CProcessor::ExecuteBR ()
@@ -1822,34 +2470,35 @@ void CProcessor::ExecuteBLO ()
     }
 }
 
+template<uint8_t methdest>
 void CProcessor::ExecuteXOR ()  // XOR
 {
     uint16_t dst;
     uint16_t ea = 0;
     uint8_t new_psw = GetLPSW() & 0xF1;
 
-    if (m_methdest)
+    if (methdest)
     {
-        ea = GetWordAddr(m_methdest, m_regdest);
-        if (m_RPLYrq) return;
+        ea = GetWordAddr<methdest>(m_regdest);
+        if (m_intrq & INTRQ_RPLY) return;
         dst = GetWord(ea);  // RMW read
-        if (m_RPLYrq) return;
+        if (m_intrq & INTRQ_RPLY) return;
     }
     else
         dst = GetReg(m_regdest);
 
     dst = dst ^ GetReg(m_regsrc);
 
-    if (m_methdest)
+    if (methdest)
         SetWordRMW(ea, dst);  // RMW write
     else
         SetReg(m_regdest, dst);
-    if (m_RPLYrq) return;
+    if (m_intrq & INTRQ_RPLY) return;
 
     if (dst & 0100000) new_psw |= PSW_N;
     if (dst == 0) new_psw |= PSW_Z;
     SetLPSW(new_psw);
-    m_internalTick = XOR_TIMING[m_methdest];
+    m_internalTick = XOR_TIMING[methdest];
 }
 
 void CProcessor::ExecuteMUL()  // MUL - multiply
@@ -1860,9 +2509,9 @@ void CProcessor::ExecuteMUL()  // MUL - multiply
     uint8_t new_psw = GetLPSW() & 0xF0;
 
     if (m_methdest) ea = GetWordAddr(m_methdest, m_regdest);
-    if (m_RPLYrq) return;
+    if (m_intrq & INTRQ_RPLY) return;
     src = m_methdest ? GetWord(ea) : GetReg(m_regdest);
-    if (m_RPLYrq) return;
+    if (m_intrq & INTRQ_RPLY) return;
 
     res = (signed short)dst * (signed short)src;
 
@@ -1884,9 +2533,9 @@ void CProcessor::ExecuteDIV()  // DIV - divide
     uint8_t new_psw = GetLPSW() & 0xF0;
 
     if (m_methdest) ea = GetWordAddr(m_methdest, m_regdest);
-    if (m_RPLYrq) return;
+    if (m_intrq & INTRQ_RPLY) return;
     src2 = (int)(signed short)(m_methdest ? GetWord(ea) : GetReg(m_regdest));
-    if (m_RPLYrq) return;
+    if (m_intrq & INTRQ_RPLY) return;
 
     longsrc = (int32_t)(((uint32_t)GetReg(m_regsrc | 1)) | ((uint32_t)GetReg(m_regsrc) << 16));
 
@@ -1931,9 +2580,9 @@ void CProcessor::ExecuteASH()  // ASH - arithmetic shift
     uint8_t new_psw = GetLPSW() & 0xF0;
 
     if (m_methdest) ea = GetWordAddr(m_methdest, m_regdest);
-    if (m_RPLYrq) return;
+    if (m_intrq & INTRQ_RPLY) return;
     src = (short)(m_methdest ? GetWord(ea) : GetReg(m_regdest));
-    if (m_RPLYrq) return;
+    if (m_intrq & INTRQ_RPLY) return;
     src &= 0x3F;
     src |= (src & 040) ? 0177700 : 0;
     dst = (short)GetReg(m_regsrc);
@@ -1975,9 +2624,9 @@ void CProcessor::ExecuteASHC()  // ASHC - arithmetic shift combined
     uint8_t new_psw = GetLPSW() & 0xF0;
 
     if (m_methdest) ea = GetWordAddr(m_methdest, m_regdest);
-    if (m_RPLYrq) return;
+    if (m_intrq & INTRQ_RPLY) return;
     src = (int16_t)(m_methdest ? GetWord(ea) : GetReg(m_regdest));
-    if (m_RPLYrq) return;
+    if (m_intrq & INTRQ_RPLY) return;
     src &= 0x3F;
     src |= (src & 040) ? 0177700 : 0;
     dst = ((uint32_t)GetReg(m_regsrc | 1)) | ((uint32_t)GetReg(m_regsrc) << 16);
@@ -2024,498 +2673,548 @@ void CProcessor::ExecuteSOB()  // SOB - subtract one: R = R - 1 ; if R != 0 : PC
     {
         m_internalTick = SOB_TIMING;
         SetPC(GetPC() - (m_instruction & (uint16_t)077) * 2 );
+        if (m_okBlockMode && (m_instruction & 077) == 2)
+            ExecuteSOBIdiom();
     }
 }
 
+// Loops MOV(B) (Rs)+,(Rd)+ / SOB and CLR(B) (Rd)+ / SOB over RAM: the next iterations at once, at most
+// IDIOM_MAX_TICKS; registers, flags, memory and ticks are the same as after the instructions one by one.
+// Devices and interrupts wait till the end, as in translated blocks.
+void CProcessor::ExecuteSOBIdiom()
+{
+    if (m_intrq != 0 || (m_psw & PSW_T) != 0 || m_regsrc == 7)
+        return;
+    bool okHaltMode = IsHaltMode();
+    uint16_t pc = GetPC();
+    uint32_t codeoffset;
+    int codetype = m_pBoard->TranslateAddress(pc, okHaltMode, true, &codeoffset);
+    if (codetype > ADDRTYPE_ROM)
+        return;
+    uint16_t instruction = (codetype == ADDRTYPE_ROM) ?
+            m_pBoard->GetROMWord((uint16_t)(codeoffset & 0xfffe)) : m_pBoard->GetRAMWord(codeoffset & ~1);
+
+    bool okClear, okByte = (instruction & 0100000) != 0;
+    uint8_t regsrc = GetDigit(instruction, 2), regdest = GetDigit(instruction, 0);
+    uint16_t bodyticks;
+    if ((instruction & 0077770) == 0005020)  // CLR(B) (Rd)+
+    {
+        okClear = true;
+        regsrc = regdest;
+        bodyticks = CLR_TIMING[2] + 1;
+    }
+    else if ((instruction & 0077070) == 0012020)  // MOV(B) (Rs)+,(Rd)+
+    {
+        okClear = false;
+        bodyticks = GetInstructionTiming(instruction);
+    }
+    else
+        return;
+    if (regsrc >= 6 || regdest >= 6 || regsrc == m_regsrc || regdest == m_regsrc || (!okClear && regsrc == regdest))
+        return;
+
+    uint16_t step = okByte ? 1 : 2;
+    uint16_t src = GetReg(regsrc), dst = GetReg(regdest);
+    if (!okByte && ((src | dst) & 1) != 0)
+        return;
+    // Iterations left, each is the instruction and SOB; the last SOB falls through
+    uint32_t count = GetReg(m_regsrc);
+    uint32_t iterticks = bodyticks + SOB_TIMING + 1u;
+    uint32_t maxcount = (IDIOM_MAX_TICKS - SOB_TIMING - 1u) / iterticks;
+    if (count > maxcount) count = maxcount;
+    // Both blocks in their 8 KB windows
+    uint32_t srcleft = (020000 - (src & 017777)) / step, dstleft = (020000 - (dst & 017777)) / step;
+    if (count > srcleft) count = srcleft;
+    if (count > dstleft) count = dstleft;
+    if (count == 0)
+        return;
+    uint16_t size = (uint16_t)(count * step);
+
+    uint32_t srcoffset, dstoffset;
+    int dsttype = m_pBoard->GetRAMBlockType(dst, size, okHaltMode, &dstoffset);
+    if (dsttype < 0 || (!okClear && m_pBoard->GetRAMBlockType(src, size, okHaltMode, &srcoffset) < 0))
+        return;
+    if (codetype != ADDRTYPE_ROM && dstoffset < codeoffset + 4 && codeoffset < dstoffset + size)
+        return;  // The loop overwrites itself
+
+    uint16_t value = 0;
+    if (okClear)
+        m_pBoard->ClearRAMBlock(dstoffset, dsttype, size);
+    else
+        value = m_pBoard->CopyRAMBlock(dstoffset, dsttype, srcoffset, size, okByte);
+    if (!okClear)
+        SetReg(regsrc, (uint16_t)(src + size));
+    SetReg(regdest, (uint16_t)(dst + size));
+    SetResultFlags(okClear ? LAZY_TST : LAZY_LOGIC, okByte ? (uint16_t)(value << 8) : value);
+
+    uint16_t counter = (uint16_t)(GetReg(m_regsrc) - count);
+    SetReg(m_regsrc, counter);
+    uint32_t ticks = SOB_TIMING + 1u + count * iterticks;
+    if (counter == 0)  // The last SOB falls through
+    {
+        ticks -= SOB_TIMING - SOB_LAST_TIMING;
+        SetPC(m_instructionpc + 2);
+    }
+    m_internalTick = (uint16_t)(ticks - 1);
+}
+
+template<uint8_t methsrc, uint8_t methdest>
 void CProcessor::ExecuteMOV()  // MOV - move
 {
     uint16_t src_addr, dst_addr;
-    uint8_t new_psw = GetLPSW() & 0xF1;
     uint16_t dst;
 
-    if (m_methsrc)
+    if (methsrc)
     {
-        src_addr = GetWordAddr(m_methsrc, m_regsrc);
-        if (m_RPLYrq) return;
+        src_addr = GetWordAddr<methsrc>(m_regsrc);
+        if (m_intrq & INTRQ_RPLY) return;
         dst = GetWord(src_addr);
-        if (m_RPLYrq) return;
+        if (m_intrq & INTRQ_RPLY) return;
     }
     else
         dst = GetReg(m_regsrc);
 
-    if (m_methdest)
+    if (methdest)
     {
-        dst_addr = GetWordAddr(m_methdest, m_regdest);
-        if (m_RPLYrq) return;
+        dst_addr = GetWordAddr<methdest>(m_regdest);
+        if (m_intrq & INTRQ_RPLY) return;
         SetWord(dst_addr, dst);
-        if (m_RPLYrq) return;
+        if (m_intrq & INTRQ_RPLY) return;
     }
     else
         SetReg(m_regdest, dst);
 
-    if (dst & 0100000) new_psw |= PSW_N;
-    if (dst == 0) new_psw |= PSW_Z;
-    SetLPSW(new_psw);
+    SetResultFlags(LAZY_LOGIC, dst);
 
-    m_internalTick = GetInstructionTiming12x12(MOV_TIMING, m_instruction) - 1;
+    m_internalTick = m_instrtiming - 1;
 }
 
+template<uint8_t methsrc, uint8_t methdest>
 void CProcessor::ExecuteMOVB()  // MOVB - move byte
 {
     uint16_t src_addr, dst_addr;
-    uint8_t new_psw = GetLPSW() & 0xF1;
     uint8_t dst;
 
-    if (m_methsrc)
+    if (methsrc)
     {
-        src_addr = GetByteAddr(m_methsrc, m_regsrc);
-        if (m_RPLYrq) return;
+        src_addr = GetByteAddr<methsrc>(m_regsrc);
+        if (m_intrq & INTRQ_RPLY) return;
         dst = GetByte(src_addr);
-        if (m_RPLYrq) return;
+        if (m_intrq & INTRQ_RPLY) return;
     }
     else
         dst = GetLReg(m_regsrc);
 
-    if (m_methdest)
+    if (methdest)
     {
-        dst_addr = GetByteAddr(m_methdest, m_regdest);
-        if (m_RPLYrq) return;
+        dst_addr = GetByteAddr<methdest>(m_regdest);
+        if (m_intrq & INTRQ_RPLY) return;
         GetByte(dst_addr);  // RMW read
-        if (m_RPLYrq) return;
+        if (m_intrq & INTRQ_RPLY) return;
         SetByteRMW(dst_addr, dst);  // RMW write
-        if (m_RPLYrq) return;
+        if (m_intrq & INTRQ_RPLY) return;
     }
     else
         SetReg(m_regdest, (uint16_t)(signed short)(char)dst);
 
-    if (dst & 0200) new_psw |= PSW_N;
-    if (dst == 0) new_psw |= PSW_Z;
-    SetLPSW(new_psw);
+    SetResultFlags(LAZY_LOGIC, (uint16_t)(dst << 8));
 
-    m_internalTick = GetInstructionTiming12x12(MOVB_TIMING, m_instruction) - 1;
+    m_internalTick = m_instrtiming - 1;
 }
 
+template<uint8_t methsrc, uint8_t methdest>
 void CProcessor::ExecuteCMP()  // CMP - compare
 {
     uint16_t src_addr, dst_addr;
-    uint8_t new_psw = GetLPSW() & 0xF0;
 
     uint16_t src;
     uint16_t src2;
     uint16_t dst;
 
-    if (m_methsrc)
+    if (methsrc)
     {
-        src_addr = GetWordAddr(m_methsrc, m_regsrc);
-        if (m_RPLYrq) return;
+        src_addr = GetWordAddr<methsrc>(m_regsrc);
+        if (m_intrq & INTRQ_RPLY) return;
         src = GetWord(src_addr);
-        if (m_RPLYrq) return;
+        if (m_intrq & INTRQ_RPLY) return;
     }
     else
         src = GetReg(m_regsrc);
 
-    if (m_methdest)
+    if (methdest)
     {
-        dst_addr = GetWordAddr(m_methdest, m_regdest);
-        if (m_RPLYrq) return;
+        dst_addr = GetWordAddr<methdest>(m_regdest);
+        if (m_intrq & INTRQ_RPLY) return;
         src2 = GetWord(dst_addr);
-        if (m_RPLYrq) return;
+        if (m_intrq & INTRQ_RPLY) return;
     }
     else
         src2 = GetReg(m_regdest);
 
     dst = src - src2;
 
-    if (dst & 0100000) new_psw |= PSW_N;
-    if (dst == 0) new_psw |= PSW_Z;
-    if (((src ^ src2) & ~(dst ^ src2)) & 0100000) new_psw |= PSW_V;
-    if (((~src & src2) | (~(src ^ src2) & dst)) & 0100000) new_psw |= PSW_C;
-    SetLPSW(new_psw);
+    SetResultFlags(LAZY_SUB, dst, src, src2);
 
-    m_internalTick = GetInstructionTiming12x12(BIT_TIMING, m_instruction) - 1;
+    m_internalTick = m_instrtiming - 1;
 }
 
+template<uint8_t methsrc, uint8_t methdest>
 void CProcessor::ExecuteCMPB()  // CMPB - compare byte
 {
     uint16_t src_addr, dst_addr;
-    uint8_t new_psw = GetLPSW() & 0xF0;
 
     uint8_t src;
     uint8_t src2;
     uint8_t dst;
 
-    if (m_methsrc)
+    if (methsrc)
     {
-        src_addr = GetByteAddr(m_methsrc, m_regsrc);
-        if (m_RPLYrq) return;
+        src_addr = GetByteAddr<methsrc>(m_regsrc);
+        if (m_intrq & INTRQ_RPLY) return;
         src = GetByte(src_addr);
-        if (m_RPLYrq) return;
+        if (m_intrq & INTRQ_RPLY) return;
     }
     else
         src = GetLReg(m_regsrc);
 
-    if (m_methdest)
+    if (methdest)
     {
-        dst_addr = GetByteAddr(m_methdest, m_regdest);
-        if (m_RPLYrq) return;
+        dst_addr = GetByteAddr<methdest>(m_regdest);
+        if (m_intrq & INTRQ_RPLY) return;
         src2 = GetByte(dst_addr);
-        if (m_RPLYrq) return;
+        if (m_intrq & INTRQ_RPLY) return;
     }
     else
         src2 = GetLReg(m_regdest);
 
     dst = src - src2;
 
-    if (dst & 0200) new_psw |= PSW_N;
-    if (dst == 0) new_psw |= PSW_Z;
-    if (((src ^ src2) & ~(dst ^ src2)) & 0200) new_psw |= PSW_V;
-    if (((~src & src2) | (~(src ^ src2) & dst)) & 0200) new_psw |= PSW_C;
-    SetLPSW(new_psw);
+    SetResultFlags(LAZY_SUB, (uint16_t)(dst << 8), (uint16_t)(src << 8), (uint16_t)(src2 << 8));
 
-    m_internalTick = GetInstructionTiming12x12(BITB_TIMING, m_instruction) - 1;
+    m_internalTick = m_instrtiming - 1;
 }
 
+template<uint8_t methsrc, uint8_t methdest>
 void CProcessor::ExecuteBIT()  // BIT - bit test
 {
     uint16_t src_addr, dst_addr;
-    uint8_t new_psw = GetLPSW() & 0xF1;
     uint16_t src;
     uint16_t src2;
     uint16_t dst;
 
-    if (m_methsrc)
+    if (methsrc)
     {
-        src_addr = GetWordAddr(m_methsrc, m_regsrc);
-        if (m_RPLYrq) return;
+        src_addr = GetWordAddr<methsrc>(m_regsrc);
+        if (m_intrq & INTRQ_RPLY) return;
         src = GetWord(src_addr);
-        if (m_RPLYrq) return;
+        if (m_intrq & INTRQ_RPLY) return;
     }
     else
         src  = GetReg(m_regsrc);
 
-    if (m_methdest)
+    if (methdest)
     {
-        dst_addr = GetWordAddr(m_methdest, m_regdest);
-        if (m_RPLYrq) return;
+        dst_addr = GetWordAddr<methdest>(m_regdest);
+        if (m_intrq & INTRQ_RPLY) return;
         src2 = GetWord(dst_addr);
-        if (m_RPLYrq) return;
+        if (m_intrq & INTRQ_RPLY) return;
     }
     else
         src2 = GetReg(m_regdest);
 
     dst = src2 & src;
 
-    if (dst & 0100000) new_psw |= PSW_N;
-    if (dst == 0) new_psw |= PSW_Z;
-    SetLPSW(new_psw);
+    SetResultFlags(LAZY_LOGIC, dst);
 
-    m_internalTick = GetInstructionTiming12x12(BIT_TIMING, m_instruction) - 1;
+    m_internalTick = m_instrtiming - 1;
 }
 
+template<uint8_t methsrc, uint8_t methdest>
 void CProcessor::ExecuteBITB()  // BITB - bit test on byte
 {
     uint16_t src_addr, dst_addr;
-    uint8_t new_psw = GetLPSW() & 0xF1;
     uint8_t src;
     uint8_t src2;
     uint8_t dst;
 
-    if (m_methsrc)
+    if (methsrc)
     {
-        src_addr = GetByteAddr(m_methsrc, m_regsrc);
-        if (m_RPLYrq) return;
+        src_addr = GetByteAddr<methsrc>(m_regsrc);
+        if (m_intrq & INTRQ_RPLY) return;
         src = GetByte(src_addr);
-        if (m_RPLYrq) return;
+        if (m_intrq & INTRQ_RPLY) return;
     }
     else
         src = GetLReg(m_regsrc);
 
-    if (m_methdest)
+    if (methdest)
     {
-        dst_addr = GetByteAddr(m_methdest, m_regdest);
-        if (m_RPLYrq) return;
+        dst_addr = GetByteAddr<methdest>(m_regdest);
+        if (m_intrq & INTRQ_RPLY) return;
         src2 = GetByte(dst_addr);
-        if (m_RPLYrq) return;
+        if (m_intrq & INTRQ_RPLY) return;
     }
     else
         src2 = GetLReg(m_regdest);
 
     dst = src2 & src;
 
-    if (dst & 0200) new_psw |= PSW_N;
-    if (dst == 0) new_psw |= PSW_Z;
-    SetLPSW(new_psw);
+    SetResultFlags(LAZY_LOGIC, (uint16_t)(dst << 8));
 
-    m_internalTick = GetInstructionTiming12x12(BITB_TIMING, m_instruction) - 1;
+    m_internalTick = m_instrtiming - 1;
 }
 
+template<uint8_t methsrc, uint8_t methdest>
 void CProcessor::ExecuteBIC()  // BIC - bit clear
 {
     uint16_t src_addr, dst_addr = 0;
-    uint8_t new_psw = GetLPSW() & 0xF1;
     uint16_t src;
     uint16_t src2;
     uint16_t dst;
 
-    if (m_methsrc)
+    if (methsrc)
     {
-        src_addr = GetWordAddr(m_methsrc, m_regsrc);
-        if (m_RPLYrq) return;
+        src_addr = GetWordAddr<methsrc>(m_regsrc);
+        if (m_intrq & INTRQ_RPLY) return;
         src = GetWord(src_addr);
-        if (m_RPLYrq) return;
+        if (m_intrq & INTRQ_RPLY) return;
     }
     else
         src  = GetReg(m_regsrc);
 
-    if (m_methdest)
+    if (methdest)
     {
-        dst_addr = GetWordAddr(m_methdest, m_regdest);
-        if (m_RPLYrq) return;
+        dst_addr = GetWordAddr<methdest>(m_regdest);
+        if (m_intrq & INTRQ_RPLY) return;
         src2 = GetWord(dst_addr);  // RMW read
-        if (m_RPLYrq) return;
+        if (m_intrq & INTRQ_RPLY) return;
     }
     else
         src2 = GetReg(m_regdest);
 
     dst = src2 & (~src);
 
-    if (m_methdest)
+    if (methdest)
         SetWordRMW(dst_addr, dst);  // RMW write
     else
         SetReg(m_regdest, dst);
-    if (m_RPLYrq) return;
+    if (m_intrq & INTRQ_RPLY) return;
 
-    if (dst & 0100000) new_psw |= PSW_N;
-    if (dst == 0) new_psw |= PSW_Z;
-    SetLPSW(new_psw);
+    SetResultFlags(LAZY_LOGIC, dst);
 
-    m_internalTick = GetInstructionTiming12x12(ADD_TIMING, m_instruction) - 1;
+    m_internalTick = m_instrtiming - 1;
 }
 
+template<uint8_t methsrc, uint8_t methdest>
 void CProcessor::ExecuteBICB()  // BICB - bit clear
 {
     uint16_t src_addr, dst_addr = 0;
-    uint8_t new_psw = GetLPSW() & 0xF1;
     uint8_t src;
     uint8_t src2;
     uint8_t dst;
 
-    if (m_methsrc)
+    if (methsrc)
     {
-        src_addr = GetByteAddr(m_methsrc, m_regsrc);
-        if (m_RPLYrq) return;
+        src_addr = GetByteAddr<methsrc>(m_regsrc);
+        if (m_intrq & INTRQ_RPLY) return;
         src = GetByte(src_addr);
-        if (m_RPLYrq) return;
+        if (m_intrq & INTRQ_RPLY) return;
     }
     else
         src = GetLReg(m_regsrc);
 
-    if (m_methdest)
+    if (methdest)
     {
-        dst_addr = GetByteAddr(m_methdest, m_regdest);
-        if (m_RPLYrq) return;
+        dst_addr = GetByteAddr<methdest>(m_regdest);
+        if (m_intrq & INTRQ_RPLY) return;
         src2 = GetByte(dst_addr);  // RMW read
-        if (m_RPLYrq) return;
+        if (m_intrq & INTRQ_RPLY) return;
     }
     else
         src2 = GetLReg(m_regdest);
 
     dst = src2 & (~src);
 
-    if (m_methdest)
+    if (methdest)
         SetByteRMW(dst_addr, dst);  // RMW write
     else
         SetLReg(m_regdest, dst);
-    if (m_RPLYrq) return;
+    if (m_intrq & INTRQ_RPLY) return;
 
-    if (dst & 0200) new_psw |= PSW_N;
-    if (dst == 0) new_psw |= PSW_Z;
-    SetLPSW(new_psw);
+    SetResultFlags(LAZY_LOGIC, (uint16_t)(dst << 8));
 
-    m_internalTick = GetInstructionTiming12x12(MOVB_TIMING, m_instruction) - 1;
+    m_internalTick = m_instrtiming - 1;
 }
 
+template<uint8_t methsrc, uint8_t methdest>
 void CProcessor::ExecuteBIS()  // BIS - bit set
 {
     uint16_t src_addr, dst_addr = 0;
-    uint8_t new_psw = GetLPSW() & 0xF1;
     uint16_t src;
     uint16_t src2;
     uint16_t dst;
 
-    if (m_methsrc)
+    if (methsrc)
     {
-        src_addr = GetWordAddr(m_methsrc, m_regsrc);
-        if (m_RPLYrq) return;
+        src_addr = GetWordAddr<methsrc>(m_regsrc);
+        if (m_intrq & INTRQ_RPLY) return;
         src = GetWord(src_addr);
-        if (m_RPLYrq) return;
+        if (m_intrq & INTRQ_RPLY) return;
     }
     else
         src  = GetReg(m_regsrc);
 
-    if (m_methdest)
+    if (methdest)
     {
-        dst_addr = GetWordAddr(m_methdest, m_regdest);
-        if (m_RPLYrq) return;
+        dst_addr = GetWordAddr<methdest>(m_regdest);
+        if (m_intrq & INTRQ_RPLY) return;
         src2 = GetWord(dst_addr);  // RMW read
-        if (m_RPLYrq) return;
+        if (m_intrq & INTRQ_RPLY) return;
     }
     else
         src2 = GetReg(m_regdest);
 
     dst = src2 | src;
 
-    if (m_methdest)
+    if (methdest)
         SetWordRMW(dst_addr, dst);  // RMW write
     else
         SetReg(m_regdest, dst);
-    if (m_RPLYrq) return;
+    if (m_intrq & INTRQ_RPLY) return;
 
-    if (dst & 0100000) new_psw |= PSW_N;
-    if (dst == 0) new_psw |= PSW_Z;
-    SetLPSW(new_psw);
+    SetResultFlags(LAZY_LOGIC, dst);
 
-    m_internalTick = GetInstructionTiming12x12(ADD_TIMING, m_instruction) - 1;
+    m_internalTick = m_instrtiming - 1;
 }
 
+template<uint8_t methsrc, uint8_t methdest>
 void CProcessor::ExecuteBISB()  // BISB - bit set on byte
 {
     uint16_t src_addr, dst_addr = 0;
-    uint8_t new_psw = GetLPSW() & 0xF1;
     uint8_t src;
     uint8_t src2;
     uint8_t dst;
 
-    if (m_methsrc)
+    if (methsrc)
     {
-        src_addr = GetByteAddr(m_methsrc, m_regsrc);
-        if (m_RPLYrq) return;
+        src_addr = GetByteAddr<methsrc>(m_regsrc);
+        if (m_intrq & INTRQ_RPLY) return;
         src = GetByte(src_addr);
-        if (m_RPLYrq) return;
+        if (m_intrq & INTRQ_RPLY) return;
     }
     else
         src = GetLReg(m_regsrc);
 
-    if (m_methdest)
+    if (methdest)
     {
-        dst_addr = GetByteAddr(m_methdest, m_regdest);
-        if (m_RPLYrq) return;
+        dst_addr = GetByteAddr<methdest>(m_regdest);
+        if (m_intrq & INTRQ_RPLY) return;
         src2 = GetByte(dst_addr);  // RMW read
-        if (m_RPLYrq) return;
+        if (m_intrq & INTRQ_RPLY) return;
     }
     else
         src2 = GetLReg(m_regdest);
 
     dst = src2 | src;
 
-    if (m_methdest)
+    if (methdest)
         SetByteRMW(dst_addr, dst);  // RMW write
     else
         SetLReg(m_regdest, dst);
-    if (m_RPLYrq) return;
+    if (m_intrq & INTRQ_RPLY) return;
 
-    if (dst & 0200) new_psw |= PSW_N;
-    if (dst == 0) new_psw |= PSW_Z;
-    SetLPSW(new_psw);
+    SetResultFlags(LAZY_LOGIC, (uint16_t)(dst << 8));
 
-    m_internalTick = GetInstructionTiming12x12(MOVB_TIMING, m_instruction) - 1;
+    m_internalTick = m_instrtiming - 1;
 }
 
+template<uint8_t methsrc, uint8_t methdest>
 void CProcessor::ExecuteADD ()  // ADD
 {
     uint16_t src_addr, dst_addr = 0;
-    uint8_t new_psw = GetLPSW() & 0xF0;
     uint16_t src, src2, dst;
 
-    if (m_methsrc)
+    if (methsrc)
     {
-        src_addr = GetWordAddr(m_methsrc, m_regsrc);
-        if (m_RPLYrq) return;
+        src_addr = GetWordAddr<methsrc>(m_regsrc);
+        if (m_intrq & INTRQ_RPLY) return;
         src = GetWord(src_addr);
-        if (m_RPLYrq) return;
+        if (m_intrq & INTRQ_RPLY) return;
     }
     else
         src = GetReg(m_regsrc);
 
-    if (m_methdest)
+    if (methdest)
     {
-        dst_addr = GetWordAddr(m_methdest, m_regdest);
-        if (m_RPLYrq) return;
+        dst_addr = GetWordAddr<methdest>(m_regdest);
+        if (m_intrq & INTRQ_RPLY) return;
         src2 = GetWord(dst_addr);  // RMW read
-        if (m_RPLYrq) return;
+        if (m_intrq & INTRQ_RPLY) return;
     }
     else
         src2 = GetReg(m_regdest);
 
     dst = src2 + src;
 
-    if (m_methdest)
+    if (methdest)
         SetWordRMW(dst_addr, dst);  // RMW write
     else
         SetReg(m_regdest, dst);
-    if (m_RPLYrq) return;
+    if (m_intrq & INTRQ_RPLY) return;
 
-    if (dst & 0100000) new_psw |= PSW_N;
-    if (dst == 0) new_psw |= PSW_Z;
-    if ((~(src ^ src2) & (dst ^ src2)) & 0100000) new_psw |= PSW_V;
-    if (((src & src2) | ((src ^ src2) & ~dst)) & 0100000) new_psw |= PSW_C;
-    SetLPSW(new_psw);
+    SetResultFlags(LAZY_ADD, dst, src, src2);
 
-    m_internalTick = GetInstructionTiming12x12(ADD_TIMING, m_instruction) - 1;
+    m_internalTick = m_instrtiming - 1;
 }
 
+template<uint8_t methsrc, uint8_t methdest>
 void CProcessor::ExecuteSUB()  // SUB
 {
     uint16_t src_addr, dst_addr = 0;
-    uint8_t new_psw = GetLPSW() & 0xF0;
     uint16_t src, src2, dst;
 
-    if (m_methsrc)
+    if (methsrc)
     {
-        src_addr = GetWordAddr(m_methsrc, m_regsrc);
-        if (m_RPLYrq) return;
+        src_addr = GetWordAddr<methsrc>(m_regsrc);
+        if (m_intrq & INTRQ_RPLY) return;
         src = GetWord(src_addr);
-        if (m_RPLYrq) return;
+        if (m_intrq & INTRQ_RPLY) return;
     }
     else
         src = GetReg(m_regsrc);
 
-    if (m_methdest)
+    if (methdest)
     {
-        dst_addr = GetWordAddr(m_methdest, m_regdest);
-        if (m_RPLYrq) return;
+        dst_addr = GetWordAddr<methdest>(m_regdest);
+        if (m_intrq & INTRQ_RPLY) return;
         src2 = GetWord(dst_addr);  // RMW read
-        if (m_RPLYrq) return;
+        if (m_intrq & INTRQ_RPLY) return;
     }
     else
         src2 = GetReg(m_regdest);
 
     dst = src2 - src;
 
-    if (m_methdest)
+    if (methdest)
         SetWordRMW(dst_addr, dst);  // RMW write
     else
         SetReg(m_regdest, dst);
-    if (m_RPLYrq) return;
+    if (m_intrq & INTRQ_RPLY) return;
 
-    if (dst & 0100000) new_psw |= PSW_N;
-    if (dst == 0) new_psw |= PSW_Z;
-    if (((src ^ src2) & ~(dst ^ src)) & 0100000) new_psw |= PSW_V;
-    if (((src & ~src2) | (~(src ^ src2) & dst)) & 0100000) new_psw |= PSW_C;
-    SetLPSW(new_psw);
+    SetResultFlags(LAZY_SUB, dst, src2, src);
 
-    m_internalTick = GetInstructionTiming12x12(ADD_TIMING, m_instruction) - 1;
+    m_internalTick = m_instrtiming - 1;
 }
 
 void CProcessor::ExecuteEMT()  // EMT - emulator trap
 {
-    m_EMT_rq = true;
+    m_intrq |= INTRQ_EMT;
     m_internalTick = EMT_TIMING;
 }
 
 void CProcessor::ExecuteTRAP()
 {
-    m_TRAPrq = true;
+    m_intrq |= INTRQ_TRAP;
     m_internalTick = EMT_TIMING;
 }
 
@@ -2524,20 +3223,20 @@ void CProcessor::ExecuteJSR()  // JSR - jump subroutine: *--SP = R; R = PC; PC =
     if (m_methdest == 0)
     {
         // Неправильный метод адресации
-        m_ILLGrq = true;
+        m_intrq |= INTRQ_ILLG;
         m_internalTick = EMT_TIMING;
     }
     else
     {
         uint16_t dst;
         dst = GetWordAddr(m_methdest, m_regdest);
-        if (m_RPLYrq) return;
+        if (m_intrq & INTRQ_RPLY) return;
 
         SetSP( GetSP() - 2 );
         SetWord( GetSP(), GetReg(m_regsrc) );
         SetReg(m_regsrc, GetPC());
         SetPC(dst);
-        if (m_RPLYrq) return;
+        if (m_intrq & INTRQ_RPLY) return;
 
         m_internalTick = JSR_TIMING[m_methdest - 1];
     }
@@ -2549,7 +3248,7 @@ void CProcessor::ExecuteMARK ()  // MARK
     SetPC( GetReg(5) );
     SetReg(5, GetWord( GetSP() ));
     SetSP( GetSP() + 2 );
-    if (m_RPLYrq) return;
+    if (m_intrq & INTRQ_RPLY) return;
 
     m_internalTick = MARK_TIMING;
 }
@@ -2570,40 +3269,40 @@ void CProcessor::SaveToImage(uint8_t* pImage) const
 {
     // Processor data                               // Offset Size
     uint16_t* pwImage = (uint16_t*) pImage;         //    0    --
-    *pwImage++ = m_psw;                             //    0     2   PSW
+    *pwImage++ = GetPSW();                          //    0     2   PSW
     memcpy(pwImage, m_R, 2 * 8);  pwImage += 8;     //    2    16   Registers R0-R7
     *pwImage++ = m_savepc;                          //   18     2   PC'
-    *pwImage++ = m_savepsw;                         //   20     2   PSW'
+    *pwImage++ = GetCPSW();                         //   20     2   PSW'
     *pwImage++ = (m_okStopped ? 1 : 0);             //   22     2   Stopped
     *pwImage++ = m_internalTick;                    //   24     2   Internal tick count
     uint8_t* pbImage = (uint8_t*) pwImage;
     uint8_t flags0 = 0;
     flags0 |= (m_stepmode ?   1 : 0);
     flags0 |= (m_buserror ?   2 : 0);
-    flags0 |= (m_haltpin  ?   4 : 0);
+    flags0 |= ((m_intrq & INTRQ_HALTPIN) ? 4 : 0);
     flags0 |= (m_DCLOpin  ?   8 : 0);
     flags0 |= (m_ACLOpin  ?  16 : 0);
     flags0 |= (m_waitmode ?  32 : 0);
     *pbImage++ = flags0;                            //   26     1   Flags
     uint8_t flags1 = 0;
-    flags1 |= (m_STRTrq ?   1 : 0);
-    flags1 |= (m_RPLYrq ?   2 : 0);
-    flags1 |= (m_ILLGrq ?   4 : 0);
-    flags1 |= (m_RSVDrq ?   8 : 0);
-    flags1 |= (m_TBITrq ?  16 : 0);
-    flags1 |= (m_ACLOrq ?  32 : 0);
-    flags1 |= (m_HALTrq ?  64 : 0);
-    flags1 |= (m_EVNTrq ? 128 : 0);
+    flags1 |= ((m_intrq & INTRQ_STRT) ?   1 : 0);
+    flags1 |= ((m_intrq & INTRQ_RPLY) ?   2 : 0);
+    flags1 |= ((m_intrq & INTRQ_ILLG) ?   4 : 0);
+    flags1 |= ((m_intrq & INTRQ_RSVD) ?   8 : 0);
+    flags1 |= ((m_intrq & INTRQ_TBIT) ?  16 : 0);
+    flags1 |= ((m_intrq & INTRQ_ACLO) ?  32 : 0);
+    flags1 |= ((m_intrq & INTRQ_HALT) ?  64 : 0);
+    flags1 |= ((m_intrq & INTRQ_EVNT) ? 128 : 0);
     *pbImage++ = flags1;                            //   27     1   Flags
     uint8_t flags2 = 0;
-    flags2 |= (m_FIS_rq ?   1 : 0);
-    flags2 |= (m_BPT_rq ?   2 : 0);
-    flags2 |= (m_IOT_rq ?   4 : 0);
-    flags2 |= (m_EMT_rq ?   8 : 0);
-    flags2 |= (m_TRAPrq ?  16 : 0);
+    flags2 |= ((m_intrq & INTRQ_FIS)  ?   1 : 0);
+    flags2 |= ((m_intrq & INTRQ_BPT)  ?   2 : 0);
+    flags2 |= ((m_intrq & INTRQ_IOT)  ?   4 : 0);
+    flags2 |= ((m_intrq & INTRQ_EMT)  ?   8 : 0);
+    flags2 |= ((m_intrq & INTRQ_TRAP) ?  16 : 0);
     flags2 |= (m_ACLOreset ? 32 : 0);
     flags2 |= (m_EVNTreset ? 64 : 0);
-    flags2 |= (m_VIRQrq ? 128 : 0);
+    flags2 |= ((m_intrq & INTRQ_VIRQ) ? 128 : 0);
     *pbImage++ = flags2;                            //   28     1   Flags
     //                                              //   29    35   Reserved
 }
@@ -2612,6 +3311,7 @@ void CProcessor::LoadFromImage(const uint8_t* pImage)
 {
     const uint16_t* pwImage = (const uint16_t*) pImage;  //    0    --
     m_psw = *pwImage++;                             //    0     2   PSW
+    m_flagsop = LAZY_NONE;
     memcpy(m_R, pwImage, 2 * 8);  pwImage += 8;     //    2    16   Registers R0-R7
     m_savepc    = *pwImage++;                       //   18     2   PC'
     m_savepsw   = *pwImage++;                       //   20     2   PSW'
@@ -2621,32 +3321,34 @@ void CProcessor::LoadFromImage(const uint8_t* pImage)
     uint8_t flags0 = *pbImage++;                    //   26     1   Flags
     m_stepmode  = ((flags0 &  1) != 0);
     m_buserror  = ((flags0 &  2) != 0);
-    m_haltpin   = ((flags0 &  4) != 0);
+    m_intrq     = (flags0 & 4) ? INTRQ_HALTPIN : 0;
     m_DCLOpin   = ((flags0 &  8) != 0);
     m_ACLOpin   = ((flags0 & 16) != 0);
     m_waitmode  = ((flags0 & 32) != 0);
     uint8_t flags1 = *pbImage++;                    //   27     1   Flags
-    m_STRTrq    = ((flags1 &   1) != 0);
-    m_RPLYrq    = ((flags1 &   2) != 0);
-    m_ILLGrq    = ((flags1 &   4) != 0);
-    m_RSVDrq    = ((flags1 &   8) != 0);
-    m_TBITrq    = ((flags1 &  16) != 0);
-    m_ACLOrq    = ((flags1 &  32) != 0);
-    m_HALTrq    = ((flags1 &  64) != 0);
-    m_EVNTrq    = ((flags1 & 128) != 0);
+    if (flags1 &   1) m_intrq |= INTRQ_STRT;
+    if (flags1 &   2) m_intrq |= INTRQ_RPLY;
+    if (flags1 &   4) m_intrq |= INTRQ_ILLG;
+    if (flags1 &   8) m_intrq |= INTRQ_RSVD;
+    if (flags1 &  16) m_intrq |= INTRQ_TBIT;
+    if (flags1 &  32) m_intrq |= INTRQ_ACLO;
+    if (flags1 &  64) m_intrq |= INTRQ_HALT;
+    if (flags1 & 128) m_intrq |= INTRQ_EVNT;
     uint8_t flags2 = *pbImage++;                    //   28     1   Flags
-    m_FIS_rq    = ((flags2 &  1) != 0);
-    m_BPT_rq    = ((flags2 &  2) != 0);
-    m_IOT_rq    = ((flags2 &  4) != 0);
-    m_EMT_rq    = ((flags2 &  8) != 0);
-    m_TRAPrq    = ((flags2 & 16) != 0);
+    if (flags2 &   1) m_intrq |= INTRQ_FIS;
+    if (flags2 &   2) m_intrq |= INTRQ_BPT;
+    if (flags2 &   4) m_intrq |= INTRQ_IOT;
+    if (flags2 &   8) m_intrq |= INTRQ_EMT;
+    if (flags2 &  16) m_intrq |= INTRQ_TRAP;
     m_ACLOreset = ((flags2 & 32) != 0);
     m_EVNTreset = ((flags2 & 64) != 0);
-    m_VIRQrq    = ((flags2 & 128) != 0);
+    if (flags2 & 128) m_intrq |= INTRQ_VIRQ;
     //                                              //   29    35   Reserved
 }
 
-uint16_t CProcessor::GetWordAddr (uint8_t meth, uint8_t reg)
+// Operand address calculation, with addressing mode known at compile time
+template<uint8_t meth>
+inline uint16_t CProcessor::GetWordAddr (uint8_t reg)
 {
     switch (meth)
     {
@@ -2684,7 +3386,7 @@ uint16_t CProcessor::GetWordAddr (uint8_t meth, uint8_t reg)
             uint16_t addr = GetWord(GetPC());
             SetPC(GetPC() + 2);
             addr = GetReg(reg) + addr;
-            if (!m_RPLYrq)
+            if ((m_intrq & INTRQ_RPLY) == 0)
                 return GetWord(addr);
             return addr;
         }
@@ -2692,7 +3394,8 @@ uint16_t CProcessor::GetWordAddr (uint8_t meth, uint8_t reg)
     return 0;
 }
 
-uint16_t CProcessor::GetByteAddr (uint8_t meth, uint8_t reg)
+template<uint8_t meth>
+inline uint16_t CProcessor::GetByteAddr (uint8_t reg)
 {
     uint16_t addr;
 
@@ -2729,12 +3432,42 @@ uint16_t CProcessor::GetByteAddr (uint8_t meth, uint8_t reg)
         addr = GetWord(GetPC());
         SetPC(GetPC() + 2);
         addr = GetReg(reg) + addr;
-        if (!m_RPLYrq) addr = GetWord(addr);
+        if ((m_intrq & INTRQ_RPLY) == 0) addr = GetWord(addr);
         break;
     }
 
     return addr;
 }
 
+uint16_t CProcessor::GetWordAddr (uint8_t meth, uint8_t reg)
+{
+    switch (meth)
+    {
+    case 1: return GetWordAddr<1>(reg);
+    case 2: return GetWordAddr<2>(reg);
+    case 3: return GetWordAddr<3>(reg);
+    case 4: return GetWordAddr<4>(reg);
+    case 5: return GetWordAddr<5>(reg);
+    case 6: return GetWordAddr<6>(reg);
+    case 7: return GetWordAddr<7>(reg);
+    }
+    return 0;
+}
+
+uint16_t CProcessor::GetByteAddr (uint8_t meth, uint8_t reg)
+{
+    switch (meth)
+    {
+    case 1: return GetByteAddr<1>(reg);
+    case 2: return GetByteAddr<2>(reg);
+    case 3: return GetByteAddr<3>(reg);
+    case 4: return GetByteAddr<4>(reg);
+    case 5: return GetByteAddr<5>(reg);
+    case 6: return GetByteAddr<6>(reg);
+    case 7: return GetByteAddr<7>(reg);
+    }
+    return 0;
+}
+
 
 //////////////////////////////////////////////////////////////////////
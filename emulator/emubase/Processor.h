@@ -18,24 +18,102 @@ NEONBTL. If not, see <http://www.gnu.org/licenses/>. */
 
 //////////////////////////////////////////////////////////////////////
 
+// Decoded instruction cache constants
+#define DECODE_CACHE_SIZE   4096        // Number of cache entries, power of 2
+#define DECODE_TAG_ROM      0x80000000  // Tag flag for instructions located in ROM
+#define DECODE_TAG_INVALID  0xffffffff  // Tag for empty cache entry
+
+// Translated block cache constants
+#define BLOCK_CACHE_SIZE    512     // Number of translated block cache entries, power of 2
+#define BLOCK_MAX_LENGTH    16      // Max number of instructions in the block
+#define BLOCK_HOT_COUNT     16      // Number of entries to the block start before the translation
+#define BLOCK_PAGE_SHIFT    9       // Code page size for the block invalidation, 512 bytes
+#define BLOCK_PAGE_ROMBASE  ((4096 * 1024) >> BLOCK_PAGE_SHIFT)  // First ROM page, after max RAM size
+#define BLOCK_PAGE_COUNT    (BLOCK_PAGE_ROMBASE + (16384 >> BLOCK_PAGE_SHIFT))
+#define IDIOM_MAX_TICKS     4096    // Max CPU ticks of copy/fill loop iterations done at once in block mode
+
+// Interrupt request bits, the higher bit the higher priority
+#define INTRQ_STRT      0100000     // Start
+#define INTRQ_HALT      0040000     // HALT command
+#define INTRQ_BPT       0020000     // BPT command
+#define INTRQ_IOT       0010000     // IOT command
+#define INTRQ_EMT       0004000     // EMT command
+#define INTRQ_TRAP      0002000     // TRAP command
+#define INTRQ_FIS       0001000     // FIS command
+#define INTRQ_RPLY      0000400     // Hangup
+#define INTRQ_ILLG      0000200     // Illegal instruction
+#define INTRQ_RSVD      0000100     // Reserved instruction
+#define INTRQ_TBIT      0000040     // T-bit, except in WAIT
+#define INTRQ_ACLO      0000020     // Power down, when PSW bits 7,8 are not both set
+#define INTRQ_HALTPIN   0000010     // HALT signal, in USER mode only
+#define INTRQ_EVNT      0000004     // Timer event, when PSW bit 7 is clear
+#define INTRQ_VIRQ      0000002     // VIRQ signal, when PSW bit 7 is clear
+// Commands requesting the interrupt right after the instruction
+#define INTRQ_COMMANDS  (INTRQ_HALT | INTRQ_BPT | INTRQ_IOT | INTRQ_EMT | INTRQ_TRAP | INTRQ_FIS)
+// Level requests, not cleared when the interrupt is taken
+#define INTRQ_LEVELS    (INTRQ_ACLO | INTRQ_HALTPIN | INTRQ_EVNT | INTRQ_VIRQ)
+
+// Lazy condition codes: kind of the last flag-setting operation
+// N and Z come from the result; byte operations keep operands and result in the high byte
+#define LAZY_NONE       0   // Flags are in PSW
+#define LAZY_LOGIC      1   // MOV, BIT, BIC, BIS: V=0, C unchanged
+#define LAZY_INC        2   // INC: V when result is 100000, C unchanged
+#define LAZY_DEC        3   // DEC: V when operand was 100000, C unchanged
+#define LAZY_TST        4   // TST, CLR: V=0, C=0
+#define LAZY_ADD        5   // ADD: result = a + b
+#define LAZY_SUB        6   // CMP, SUB: result = a - b
+
 // KM1801VM2 processor
 class CProcessor
 {
 public:  // Constructor / initialization
     CProcessor(CMotherboard* pBoard);
-    void        SetHALTPin(bool value) { m_haltpin = value; }
-    bool        GetHALTPin() const { return m_haltpin; }
-    bool        GetVIRQPin() const { return m_VIRQrq; }
+    ~CProcessor();
+    void        SetHALTPin(bool value);
+    bool        GetHALTPin() const { return (m_intrq & INTRQ_HALTPIN) != 0; }
+    bool        GetVIRQPin() const { return (m_intrq & INTRQ_VIRQ) != 0; }
     void        SetDCLOPin(bool value);
     void        SetACLOPin(bool value);
     void        MemoryError();
 
-public:
-    static void Init();  // Initialize static tables
-    static void Done();  // Release memory used for static tables
 protected:  // Statics
     typedef void ( CProcessor::*ExecuteMethodRef )();
-    static ExecuteMethodRef* m_pExecuteMethodMap;
+    static const uint8_t m_OpcodeClassMap[1024];      // Opcode class by opcode bits 15..6
+    static const uint8_t m_OpcodeClassMap2[3][64];    // Opcode class by opcode bits 5..0, for blocks with mixed classes
+    static const ExecuteMethodRef m_ExecuteMethods[]; // Command implementation method by opcode class
+    static const ExecuteMethodRef m_ExecuteMethodsD[][8];    // Methods instantiated by destination mode
+    static const ExecuteMethodRef m_ExecuteMethodsSD[][64];  // Methods instantiated by source and destination modes
+    static uint8_t GetOpcodeClass(uint16_t instruction);
+    static ExecuteMethodRef GetExecuteMethod(uint16_t instruction);
+
+protected:  // Decoded instruction cache
+    struct DecodedInstruction
+    {
+        uint32_t    tag;            // Physical location: RAM offset or ROM offset | DECODE_TAG_ROM
+        uint16_t    instruction;    // Instruction word
+        uint16_t    timing;         // Timing from *_TIMING tables, for two-operand instructions
+        ExecuteMethodRef methodref; // Command implementation method
+        uint8_t     regsrc, methsrc, regdest, methdest;
+    };
+    DecodedInstruction* m_pDecodeCache;  // Direct-mapped cache indexed by physical word address
+    DecodedInstruction  m_decodeTemp;    // Decoded instruction fetched from I/O or emulated registers area
+
+protected:  // Translated block cache
+    // Straight-line run of decoded instructions, executed without device ticks in between
+    struct TranslatedBlock
+    {
+        uint32_t    tag;            // Physical location of the first instruction, as in decode cache
+        uint16_t    hits;           // Number of entries before the translation
+        uint16_t    length;         // Number of instructions, 0 = not translated yet
+        uint32_t    page[2];        // Code pages of the first and the last instruction word
+        uint32_t    pagegen[2];     // Code page generations at the translation time
+        uint16_t    pc[BLOCK_MAX_LENGTH];  // Address of every instruction
+        DecodedInstruction instrs[BLOCK_MAX_LENGTH];
+    };
+    bool        m_okBlockMode;      // Execute translated blocks
+    TranslatedBlock* m_pBlockCache; // Direct-mapped cache indexed by physical word address
+    // Generation by code page, odd value means the page has translated code
+    uint32_t*   m_pCodePageGen;
 
 protected:  // Processor state
     uint16_t    m_internalTick;     // How many ticks waiting to the end of current instruction
@@ -46,14 +124,22 @@ protected:  // Processor state
     bool        m_okStopped;        // "Processor stopped" flag
     bool        m_stepmode;         // Read true if it's step mode
     bool        m_buserror;         // Read true if occured bus error for implementing double bus error if needed
-    bool        m_haltpin;          // HALT pin
     bool        m_DCLOpin;          // DCLO pin
     bool        m_ACLOpin;          // ACLO pin
     bool        m_waitmode;         // WAIT
+protected:  // Lazy condition codes, see LAZY_Xxx
+    uint8_t     m_flagsop;          // Last flag-setting operation, LAZY_NONE when NZVC are in m_psw
+    uint16_t    m_flagsres;         // Result of the operation
+    uint16_t    m_flagsa;           // First operand
+    uint16_t    m_flagsb;           // Second operand
+    bool        m_okLazyFlags;      // false = update PSW flags on every instruction
+    bool        m_okNativeFIS;      // Execute FIS instructions natively instead of the ROM routine
 
 protected:  // Current instruction processing
     uint16_t    m_instruction;      // Current instruction
     uint16_t    m_instructionpc;    // Address of the current instruction
+    uint16_t    m_instrtiming;      // Precomputed timing of the current two-operand instruction
+    ExecuteMethodRef m_instrmethod; // Implementation method of the current instruction
     uint8_t     m_regsrc;           // Source register number
     uint8_t     m_methsrc;          // Source address mode
     uint16_t    m_addrsrc;          // Source address
@@ -61,31 +147,22 @@ protected:  // Current instruction processing
     uint8_t     m_methdest;         // Destination address mode
     uint16_t    m_addrdest;         // Destination address
 protected:  // Interrupt processing
-    bool        m_STRTrq;           // Start interrupt pending
-    bool        m_RPLYrq;           // Hangup interrupt pending
-    bool        m_ILLGrq;           // Illegal instruction interrupt pending
-    bool        m_RSVDrq;           // Reserved instruction interrupt pending
-    bool        m_TBITrq;           // T-bit interrupt pending
-    bool        m_ACLOrq;           // Power down interrupt pending
-    bool        m_HALTrq;           // HALT command or HALT signal
-    bool        m_EVNTrq;           // Timer event interrupt pending
-    bool        m_FIS_rq;           // FIS command interrupt pending
-    bool        m_BPT_rq;           // BPT command interrupt pending
-    bool        m_IOT_rq;           // IOT command interrupt pending
-    bool        m_EMT_rq;           // EMT command interrupt pending
-    bool        m_TRAPrq;           // TRAP command interrupt pending
-    bool        m_VIRQrq;           // VIRQ interrupt request
+    uint16_t    m_intrq;            // Pending interrupt requests and HALT pin, see INTRQ_Xxx bits
     bool        m_ACLOreset;        // Power fail interrupt request reset
     bool        m_EVNTreset;        // EVNT interrupt request reset
 protected:
     CMotherboard* m_pBoard;
 
 public:  // Register control
-    uint16_t    GetPSW() const { return m_psw; }  // Get the processor status word register value
-    uint16_t    GetCPSW() const { return m_savepsw; }
-    uint8_t     GetLPSW() const { return (uint8_t)(m_psw & 0xff); }  // Get PSW lower byte
+    // Get the processor status word register value
+    uint16_t    GetPSW() const { return (m_flagsop == LAZY_NONE) ? m_psw : GetLazyPSW(); }
+    uint16_t    GetCPSW() const
+    {
+        return (m_flagsop != LAZY_NONE && (m_psw & 0600) != 0600) ? GetLazyPSW() : m_savepsw;
+    }
+    uint8_t     GetLPSW() const { return (uint8_t)(GetPSW() & 0xff); }  // Get PSW lower byte
     void        SetPSW(uint16_t word);  // Set the processor status word register value
-    void        SetCPSW(uint16_t word) { m_savepsw = word; }
+    void        SetCPSW(uint16_t word) { UpdateFlags(); m_savepsw = word; }
     void        SetLPSW(uint8_t byte);
     uint16_t    GetReg(int regno) const { return m_R[regno]; }  // Get register value, regno=0..7
     void        SetReg(int regno, uint16_t word);  // Set register value
@@ -100,13 +177,19 @@ public:  // Register control
 
 public:  // PSW bits control
     void        SetC(bool bFlag);
-    uint16_t    GetC() const { return (m_psw & PSW_C) != 0; }
+    uint16_t    GetC() const { return (GetPSW() & PSW_C) != 0; }
     void        SetV(bool bFlag);
-    uint16_t    GetV() const { return (m_psw & PSW_V) != 0; }
+    uint16_t    GetV() const { return (GetPSW() & PSW_V) != 0; }
     void        SetN(bool bFlag);
-    uint16_t    GetN() const { return (m_psw & PSW_N) != 0; }
+    uint16_t    GetN() const
+    {
+        return (m_flagsop == LAZY_NONE) ? (m_psw & PSW_N) != 0 : (m_flagsres & 0100000) != 0;
+    }
     void        SetZ(bool bFlag);
-    uint16_t    GetZ() const { return (m_psw & PSW_Z) != 0; }
+    uint16_t    GetZ() const
+    {
+        return (m_flagsop == LAZY_NONE) ? (m_psw & PSW_Z) != 0 : m_flagsres == 0;
+    }
     void        SetHALT(bool bFlag);
     uint16_t    GetHALT() const { return (m_psw & PSW_HALT) != 0; }
 
@@ -115,6 +198,8 @@ public:  // Processor state
     bool        IsStopped() const { return m_okStopped; }
     // HALT flag (true - HALT mode, false - USER mode)
     bool        IsHaltMode() const { return ((m_psw & 0400) != 0); }
+    // WAIT command executed, waiting for an interrupt
+    bool        IsWaitMode() const { return m_waitmode; }
 public:  // Processor control
     void        TickEVNT();  // EVNT signal
     // External interrupt via VIRQ signal
@@ -127,15 +212,49 @@ public:  // Processor control
     void        CommandExecution();
     int         GetInternalTick() const { return m_internalTick; }
     void        ClearInternalTick() { m_internalTick = 0; }
+    // Execute up to maxticks ticks of the current instruction at once; returns number of ticks done
+    int         SkipInternalTicks(int maxticks)
+    {
+        if (m_okStopped) return 0;
+        int ticks = (m_internalTick < maxticks) ? m_internalTick : maxticks;
+        m_internalTick = (uint16_t)(m_internalTick - ticks);
+        return ticks;
+    }
     uint16_t    GetInstructionPC() const { return m_instructionpc; }  // Address of the current instruction
 
+public:  // Decoded instruction cache
+    // Called on every write to RAM, offset is RAM offset
+    void        InvalidateInstruction(uint32_t offset);
+    // Called when RAM or ROM changed as a whole
+    void        FlushDecodeCache();
+
+public:  // Translated blocks
+    // Block mode: hot straight-line code runs as translated blocks, devices are not ticked inside the block
+    void        SetBlockMode(bool okBlockMode) { m_okBlockMode = okBlockMode; }
+    bool        IsBlockMode() const { return m_okBlockMode; }
+
+public:  // Lazy condition codes
+    // Lazy mode: NZVC are computed from the last operation when read; eager mode is for validation
+    void        SetLazyFlags(bool okLazyFlags) { UpdateFlags(); m_okLazyFlags = okLazyFlags; }
+    bool        IsLazyFlags() const { return m_okLazyFlags; }
+
+public:  // Floating point
+    // Native FIS: FADD/FSUB/FMUL/FDIV on operands in RAM are done without the ROM trap, same results
+    void        SetNativeFIS(bool okNativeFIS) { m_okNativeFIS = okNativeFIS; }
+    bool        IsNativeFIS() const { return m_okNativeFIS; }
+
 public:  // Saving/loading emulator status (pImage addresses up to 32 bytes)
     void        SaveToImage(uint8_t* pImage) const;
     void        LoadFromImage(const uint8_t* pImage);
 
 protected:  // Implementation
     void        FetchInstruction();      // Read next instruction
+    void        SetInstruction(const DecodedInstruction* pEntry);  // Make the decoded instruction current
     void        TranslateInstruction();  // Execute the instruction
+    static void DecodeInstruction(DecodedInstruction* pEntry, uint16_t instruction);
+    bool        BlockExecution();  // Execute translated block at PC, false if no block
+    void        TranslateBlock(TranslatedBlock* pBlock, uint16_t pc, uint32_t offset);
+    void        FlushBlockCache();
 protected:  // Implementation - memory access
     // Read word from the bus for execution
     uint16_t    GetWordExec(uint16_t address) { return m_pBoard->GetWordExec(address, IsHaltMode()); }
@@ -147,6 +266,11 @@ protected:  // Implementation - memory access
     void        SetByte(uint16_t address, uint8_t byte) { m_pBoard->SetByte(address, IsHaltMode(), byte); }
     void        SetByteRMW(uint16_t address, uint8_t byte) { m_pBoard->SetByte(address, IsHaltMode(), byte, true); }
 
+protected:  // Lazy condition codes - implementation
+    uint16_t    GetLazyPSW() const;  // PSW with NZVC computed from the last operation
+    void        UpdateFlags();  // Put the pending NZVC into PSW
+    void        SetResultFlags(uint8_t op, uint16_t result, uint16_t a = 0, uint16_t b = 0);
+
 protected:  // PSW bits calculations
     bool static CheckForNegative(uint8_t byte) { return (byte & 0200) != 0; }
     bool static CheckForNegative(uint16_t word) { return (word & 0100000) != 0; }
@@ -164,6 +288,8 @@ protected:  // PSW bits calculations
 protected:  // Implementation - instruction execution
     uint16_t    GetWordAddr (uint8_t meth, uint8_t reg);
     uint16_t    GetByteAddr (uint8_t meth, uint8_t reg);
+    template<uint8_t meth> uint16_t GetWordAddr (uint8_t reg);
+    template<uint8_t meth> uint16_t GetByteAddr (uint8_t reg);
 
     // No fields
     void        ExecuteUNKNOWN ();  // There is no such instruction -- just call TRAP 10
@@ -182,6 +308,7 @@ protected:  // Implementation - instruction execution
     void        ExecuteSTEP ();
     void        ExecuteRSEL ();
     void        ExecuteFIS ();
+    bool        ExecuteFISNative();  // false if the ROM routine should do the work
     void        ExecuteRUN ();
     void        ExecuteRTT ();
     void        ExecuteCCC ();
@@ -192,35 +319,35 @@ protected:  // Implementation - instruction execution
 
     // Two fields
     void        ExecuteJMP ();
-    void        ExecuteSWAB ();
-    void        ExecuteCLR ();
-    void        ExecuteCLRB ();
-    void        ExecuteCOM ();
-    void        ExecuteCOMB ();
-    void        ExecuteINC ();
-    void        ExecuteINCB ();
-    void        ExecuteDEC ();
-    void        ExecuteDECB ();
-    void        ExecuteNEG ();
-    void        ExecuteNEGB ();
-    void        ExecuteADC ();
-    void        ExecuteADCB ();
-    void        ExecuteSBC ();
-    void        ExecuteSBCB ();
-    void        ExecuteTST ();
-    void        ExecuteTSTB ();
-    void        ExecuteROR ();
-    void        ExecuteRORB ();
-    void        ExecuteROL ();
-    void        ExecuteROLB ();
-    void        ExecuteASR ();
-    void        ExecuteASRB ();
-    void        ExecuteASL ();
-    void        ExecuteASLB ();
+    template<uint8_t methdest> void ExecuteSWAB ();
+    template<uint8_t methdest> void ExecuteCLR ();
+    template<uint8_t methdest> void ExecuteCLRB ();
+    template<uint8_t methdest> void ExecuteCOM ();
+    template<uint8_t methdest> void ExecuteCOMB ();
+    template<uint8_t methdest> void ExecuteINC ();
+    template<uint8_t methdest> void ExecuteINCB ();
+    template<uint8_t methdest> void ExecuteDEC ();
+    template<uint8_t methdest> void ExecuteDECB ();
+    template<uint8_t methdest> void ExecuteNEG ();
+    template<uint8_t methdest> void ExecuteNEGB ();
+    template<uint8_t methdest> void ExecuteADC ();
+    template<uint8_t methdest> void ExecuteADCB ();
+    template<uint8_t methdest> void ExecuteSBC ();
+    template<uint8_t methdest> void ExecuteSBCB ();
+    template<uint8_t methdest> void ExecuteTST ();
+    template<uint8_t methdest> void ExecuteTSTB ();
+    template<uint8_t methdest> void ExecuteROR ();
+    template<uint8_t methdest> void ExecuteRORB ();
+    template<uint8_t methdest> void ExecuteROL ();
+    template<uint8_t methdest> void ExecuteROLB ();
+    template<uint8_t methdest> void ExecuteASR ();
+    template<uint8_t methdest> void ExecuteASRB ();
+    template<uint8_t methdest> void ExecuteASL ();
+    template<uint8_t methdest> void ExecuteASLB ();
     void        ExecuteMARK ();
-    void        ExecuteSXT ();
-    void        ExecuteMTPS ();
-    void        ExecuteMFPS ();
+    template<uint8_t methdest> void ExecuteSXT ();
+    template<uint8_t methdest> void ExecuteMTPS ();
+    template<uint8_t methdest> void ExecuteMFPS ();
 
     // Branchs & interrupts
     void        ExecuteBR ();
@@ -244,36 +371,39 @@ protected:  // Implementation - instruction execution
 
     // Three fields
     void        ExecuteJSR ();
-    void        ExecuteXOR ();
+    template<uint8_t methdest> void ExecuteXOR ();
     void        ExecuteSOB ();
+    void        ExecuteSOBIdiom();  // Copy/fill loop of one instruction and SOB, done natively
     void        ExecuteMUL ();
     void        ExecuteDIV ();
     void        ExecuteASH ();
     void        ExecuteASHC ();
 
     // Four fields
-    void        ExecuteMOV ();
-    void        ExecuteMOVB ();
-    void        ExecuteCMP ();
-    void        ExecuteCMPB ();
-    void        ExecuteBIT ();
-    void        ExecuteBITB ();
-    void        ExecuteBIC ();
-    void        ExecuteBICB ();
-    void        ExecuteBIS ();
-    void        ExecuteBISB ();
-
-    void        ExecuteADD ();
-    void        ExecuteSUB ();
+    template<uint8_t methsrc, uint8_t methdest> void ExecuteMOV ();
+    template<uint8_t methsrc, uint8_t methdest> void ExecuteMOVB ();
+    template<uint8_t methsrc, uint8_t methdest> void ExecuteCMP ();
+    template<uint8_t methsrc, uint8_t methdest> void ExecuteCMPB ();
+    template<uint8_t methsrc, uint8_t methdest> void ExecuteBIT ();
+    template<uint8_t methsrc, uint8_t methdest> void ExecuteBITB ();
+    template<uint8_t methsrc, uint8_t methdest> void ExecuteBIC ();
+    template<uint8_t methsrc, uint8_t methdest> void ExecuteBICB ();
+    template<uint8_t methsrc, uint8_t methdest> void ExecuteBIS ();
+    template<uint8_t methsrc, uint8_t methdest> void ExecuteBISB ();
+
+    template<uint8_t methsrc, uint8_t methdest> void ExecuteADD ();
+    template<uint8_t methsrc, uint8_t methdest> void ExecuteSUB ();
 };
 
 inline void CProcessor::SetPSW(uint16_t word)
 {
+    UpdateFlags();
     m_psw = word & 0777;
     if ((m_psw & 0600) != 0600) m_savepsw = m_psw;
 }
 inline void CProcessor::SetLPSW(uint8_t byte)
 {
+    UpdateFlags();
     m_psw = (m_psw & 0xFF00) | (uint16_t)byte;
     if ((m_psw & 0600) != 0600) m_savepsw = m_psw;
 }
@@ -296,33 +426,101 @@ inline void CProcessor::SetPC(uint16_t word)
 // PSW bits control - implementation
 inline void CProcessor::SetC (bool bFlag)
 {
+    UpdateFlags();
     if (bFlag) m_psw |= PSW_C; else m_psw &= ~PSW_C;
     if ((m_psw & 0600) != 0600) m_savepsw = m_psw;
 }
 inline void CProcessor::SetV (bool bFlag)
 {
+    UpdateFlags();
     if (bFlag) m_psw |= PSW_V; else m_psw &= ~PSW_V;
     if ((m_psw & 0600) != 0600) m_savepsw = m_psw;
 }
 inline void CProcessor::SetN (bool bFlag)
 {
+    UpdateFlags();
     if (bFlag) m_psw |= PSW_N; else m_psw &= ~PSW_N;
     if ((m_psw & 0600) != 0600) m_savepsw = m_psw;
 }
 inline void CProcessor::SetZ (bool bFlag)
 {
+    UpdateFlags();
     if (bFlag) m_psw |= PSW_Z; else m_psw &= ~PSW_Z;
     if ((m_psw & 0600) != 0600) m_savepsw = m_psw;
 }
 
 inline void CProcessor::SetHALT (bool bFlag)
 {
+    UpdateFlags();
     if (bFlag) m_psw |= PSW_HALT; else m_psw &= ~PSW_HALT;
 }
 
 inline void CProcessor::SetVIRQ(bool value)
 {
-    m_VIRQrq = value;
+    if (value) m_intrq |= INTRQ_VIRQ; else m_intrq &= ~INTRQ_VIRQ;
+}
+
+inline void CProcessor::SetHALTPin(bool value)
+{
+    if (value) m_intrq |= INTRQ_HALTPIN; else m_intrq &= ~INTRQ_HALTPIN;
+}
+
+inline void CProcessor::InvalidateInstruction(uint32_t offset)
+{
+    DecodedInstruction* pEntry = m_pDecodeCache + ((offset >> 1) & (DECODE_CACHE_SIZE - 1));
+    if (pEntry->tag == (offset & ~1))
+        pEntry->tag = DECODE_TAG_INVALID;
+    // Counted in any mode, so the translated blocks stay valid while the block mode is off
+    uint32_t* pGen = m_pCodePageGen + (offset >> BLOCK_PAGE_SHIFT);
+    if (*pGen & 1)  // The page has translated code
+        (*pGen)++;
+}
+
+// Lazy condition codes - implementation
+inline uint16_t CProcessor::GetLazyPSW() const
+{
+    uint16_t psw = m_psw & ~(PSW_N | PSW_Z | PSW_V | PSW_C);
+    uint16_t res = m_flagsres, a = m_flagsa, b = m_flagsb;
+    if (res & 0100000) psw |= PSW_N;
+    if (res == 0) psw |= PSW_Z;
+    switch (m_flagsop)
+    {
+    case LAZY_INC:
+        if (res == 0100000) psw |= PSW_V;
+        break;
+    case LAZY_DEC:
+        if (a == 0100000) psw |= PSW_V;
+        break;
+    case LAZY_ADD:
+        if ((~(a ^ b) & (res ^ b)) & 0100000) psw |= PSW_V;
+        if (((a & b) | ((a ^ b) & ~res)) & 0100000) psw |= PSW_C;
+        break;
+    case LAZY_SUB:
+        if (((a ^ b) & ~(res ^ b)) & 0100000) psw |= PSW_V;
+        if (((~a & b) | (~(a ^ b) & res)) & 0100000) psw |= PSW_C;
+        break;
+    }
+    if (m_flagsop < LAZY_TST)  // C unchanged
+        psw |= m_psw & PSW_C;
+    return psw;
+}
+inline void CProcessor::UpdateFlags()
+{
+    if (m_flagsop == LAZY_NONE) return;
+    m_psw = GetLazyPSW();
+    m_flagsop = LAZY_NONE;
+    if ((m_psw & 0600) != 0600) m_savepsw = m_psw;
+}
+inline void CProcessor::SetResultFlags(uint8_t op, uint16_t result, uint16_t a, uint16_t b)
+{
+    if (op < LAZY_TST && m_flagsop >= LAZY_TST)
+        UpdateFlags();  // The new operation keeps C computed by the pending one
+    m_flagsop = op;
+    m_flagsres = result;
+    m_flagsa = a;
+    m_flagsb = b;
+    if (!m_okLazyFlags)
+        UpdateFlags();
 }
 
 // PSW bits calculations - implementation
@@ -0,0 +1,105 @@
+﻿/*  This file is part of NEONBTL.
+NEONBTL is free software: you can redistribute it and/or modify it under the terms
+of the GNU Lesser General Public License as published by the Free Software Foundation,
+either version 3 of the License, or (at your option) any later version.
+NEONBTL is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+See the GNU Lesser General Public License for more details.
+You should have received a copy of the GNU Lesser General Public License along with
+NEONBTL. If not, see <http://www.gnu.org/licenses/>. */
+
+// SoundBlep.cpp
+//
+
+#include "stdafx.h"
+#include <cmath>
+#include "Emubase.h"
+
+
+//////////////////////////////////////////////////////////////////////
+
+SoundBlep::SoundBlep()
+{
+    // Kernel row is the band-limited step difference for the step at the sub-sample position:
+    // Blackman windowed sinc, cut off at 90% of the Nyquist frequency
+    const double pi = 3.14159265358979323846;
+    const double cutoff = 0.9;
+    for (int phase = 0; phase < SOUNDBLEP_PHASES; phase++)
+    {
+        double taps[SOUNDBLEP_WIDTH];
+        double sum = 0.0;
+        for (int i = 0; i < SOUNDBLEP_WIDTH; i++)
+        {
+            double x = i - SOUNDBLEP_WIDTH / 2 + 0.5 - (double)phase / SOUNDBLEP_PHASES;
+            double sinc = (x == 0.0) ? 1.0 : sin(pi * cutoff * x) / (pi * cutoff * x);
+            double w = 2.0 * pi * (x + SOUNDBLEP_WIDTH / 2) / SOUNDBLEP_WIDTH;
+            double window = 0.42 - 0.5 * cos(w) + 0.08 * cos(2.0 * w);
+            taps[i] = sinc * window;
+            sum += taps[i];
+        }
+        // Every row sums up to the unit step exactly, the rounding error goes to the center tap
+        int32_t total = 0;
+        for (int i = 0; i < SOUNDBLEP_WIDTH; i++)
+        {
+            m_kernel[phase][i] = (int32_t)floor(taps[i] / sum * (1 << SOUNDBLEP_BITS) + 0.5);
+            total += m_kernel[phase][i];
+        }
+        m_kernel[phase][SOUNDBLEP_WIDTH / 2] += (1 << SOUNDBLEP_BITS) - total;
+    }
+
+    SetSampleRate(SOUNDSAMPLERATE);
+}
+
+void SoundBlep::SetSampleRate(int rate)
+{
+    if (rate < 25)
+        rate = 25;
+    if (rate > SOUNDBLEP_MAXRATE)
+        rate = SOUNDBLEP_MAXRATE;
+    m_framesamples = rate / 25;
+    m_rate = m_framesamples * 25;
+    Clear();
+}
+
+void SoundBlep::Clear()
+{
+    m_level = 0;
+    ::memset(m_buffer, 0, sizeof(m_buffer));
+}
+
+void SoundBlep::AddDelta(uint32_t time, int delta)
+{
+    if (time > SOUNDBLEP_FRAMETICKS)
+        time = SOUNDBLEP_FRAMETICKS;
+    uint32_t pos = (uint32_t)((uint64_t)time * m_framesamples * SOUNDBLEP_PHASES / SOUNDBLEP_FRAMETICKS);
+    const int32_t* kernel = m_kernel[pos % SOUNDBLEP_PHASES];
+    int32_t* buffer = m_buffer + pos / SOUNDBLEP_PHASES;
+    for (int i = 0; i < SOUNDBLEP_WIDTH; i++)
+        buffer[i] += kernel[i] * delta;
+}
+
+int SoundBlep::EndFrame(uint32_t time)
+{
+    if (time > SOUNDBLEP_FRAMETICKS)
+        time = SOUNDBLEP_FRAMETICKS;
+    int count = (int)((uint64_t)time * m_framesamples / SOUNDBLEP_FRAMETICKS);
+    for (int i = 0; i < count; i++)
+    {
+        m_level += m_buffer[i];
+        int32_t sample = m_level >> SOUNDBLEP_BITS;
+        if (sample > 32767)  // The step ringing must not wrap around
+            sample = 32767;
+        if (sample < -32768)
+            sample = -32768;
+        m_samples[i] = (uint16_t)sample;
+    }
+
+    // The tails of the steps near the frame end go to the next frame
+    ::memmove(m_buffer, m_buffer + count, SOUNDBLEP_WIDTH * sizeof(int32_t));
+    ::memset(m_buffer + SOUNDBLEP_WIDTH, 0, count * sizeof(int32_t));
+
+    return count;
+}
+
+
+//////////////////////////////////////////////////////////////////////
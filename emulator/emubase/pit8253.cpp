@@ -126,6 +126,149 @@ void PIT8253::Tick()
     Tick(1);
     Tick(2);
 }
+// Ticks till the output changes, for the gate input keeping the value; PIT_NEVER if the output stays.
+// Follows Tick() phase by phase, see the tables there.
+uint32_t PIT8253::GetOutputChangeTicks(uint8_t channel, bool gate) const
+{
+    const PIT8253_chan& chan = m_chan[channel];
+    uint8_t mode = (chan.control >> 1) & 7;
+    uint32_t value = chan.value, count = chan.count;
+    switch (mode)
+    {
+    case 0:  // Output goes high once, at the end of phase 2
+        if (chan.output || chan.phase == 0 || chan.phase > 2 || !gate)
+            return PIT_NEVER;
+        if (chan.phase == 1)
+            return 1 + (count <= 1 ? 1 : count);
+        return value <= 1 ? 1 : value;
+    case 2:  // Output goes low at the first reload and stays low
+        if (!gate || chan.phase == 0)
+            return chan.output ? PIT_NEVER : 1;
+        if (!chan.output)
+            return PIT_NEVER;
+        if (chan.phase == 1)
+            return 1 + (count <= 2 ? 2 : count);
+        if (chan.phase == 2)
+            return value <= 2 ? 2 : value;
+        return 1;
+    case 3:  // Output is high for the counter values above count / 2
+        {
+            if (!gate || chan.phase == 0)
+                return chan.output ? PIT_NEVER : 1;
+            uint32_t half = count / 2;
+            uint32_t ticks = 0;
+            if (chan.phase == 1)
+            {
+                ticks = 1;
+                value = count;
+            }
+            // Counter values after the ticks: value - 1 .. 1, then count .. 1 again and again
+            if (value > 1)
+            {
+                if (chan.output ? (value - 1 <= half) : (value - 1 > half))
+                    return ticks + 1;
+                if (chan.output && half > 0)
+                    return ticks + value - half;
+                ticks += value - 1;
+            }
+            ticks++;  // Reload with count
+            if (chan.output ? (count <= half) : (count > half))
+                return ticks;
+            if (!chan.output || half == 0)
+                return PIT_NEVER;
+            return ticks + count - half;
+        }
+    default:  // Modes 1, 4, 5 are not implemented
+        return PIT_NEVER;
+    }
+}
+
+// Do the ticks at once, for the gate input keeping the value; same as Tick() called again and again
+void PIT8253::Advance(uint8_t channel, bool gate, uint32_t ticks)
+{
+    PIT8253_chan& chan = m_chan[channel];
+    chan.gate = gate;
+    uint8_t mode = (chan.control >> 1) & 7;
+    if (mode > 3 || mode == 1 || ticks == 0)
+        return;
+    if (mode != 0 && (!gate || chan.phase == 0))
+    {
+        chan.output = true;
+        return;
+    }
+    if (chan.phase == 1)
+    {
+        chan.value = chan.count;
+        chan.phase = 2;
+        ticks--;
+    }
+    while (ticks > 0)
+    {
+        uint16_t count = chan.count;
+        switch (mode)
+        {
+        case 0:
+            if (chan.phase == 0 || !gate)
+                return;
+            if (chan.phase == 2)
+            {
+                if (chan.value <= 1)
+                {
+                    chan.phase = 3;
+                    chan.value = 0xffff;
+                    chan.output = true;
+                    ticks--;
+                    break;
+                }
+                uint32_t steps = (ticks < chan.value - 1u) ? ticks : chan.value - 1u;
+                chan.value = (uint16_t)(chan.value - steps);
+                ticks -= steps;
+                break;
+            }
+            chan.value = (uint16_t)(chan.value - ticks);
+            return;
+        case 2:
+            if (chan.phase == 2)
+            {
+                if (chan.value <= 2)
+                {
+                    chan.phase = 3;
+                    ticks--;
+                    break;
+                }
+                uint32_t steps = (ticks < chan.value - 2u) ? ticks : chan.value - 2u;
+                chan.value = (uint16_t)(chan.value - steps);
+                ticks -= steps;
+                break;
+            }
+            chan.output = false;
+            chan.value = count;
+            chan.phase = 2;
+            ticks--;
+            ticks %= (count <= 2) ? 2 : count;  // Whole reload periods change nothing
+            break;
+        case 3:
+            if (chan.value > 1)
+            {
+                uint32_t steps = (ticks < chan.value - 1u) ? ticks : chan.value - 1u;
+                chan.value = (uint16_t)(chan.value - steps);
+                ticks -= steps;
+            }
+            else
+            {
+                chan.value = count;
+                ticks--;
+                if (count == 0)
+                    ticks = 0;
+                else
+                    ticks %= count;  // Whole periods change nothing
+            }
+            chan.output = (chan.value > count / 2);
+            break;
+        }
+    }
+}
+
 void PIT8253::Tick(uint8_t channel)
 {
     PIT8253_chan& chan = m_chan[channel];
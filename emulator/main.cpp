@@ -37,6 +37,12 @@ const char CommandLineHelp[] =
     OPTIONSTR "noautostart " OPTIONSTR "autostartoff    Do not start emulation on window open\n"
     OPTIONSTR "sound " OPTIONSTR "soundon    Turn sound on\n"
     OPTIONSTR "nosound " OPTIONSTR "soundoff    Turn sound off\n"
+    OPTIONSTR "blocks " OPTIONSTR "blockson    Turn translated blocks on: faster, less exact device timing\n"
+    OPTIONSTR "noblocks " OPTIONSTR "blocksoff    Turn translated blocks off\n"
+    OPTIONSTR "fis " OPTIONSTR "fison    Turn native FIS on: FADD/FSUB/FMUL/FDIV without the ROM trap\n"
+    OPTIONSTR "nofis " OPTIONSTR "fisoff    Turn native FIS off\n"
+    OPTIONSTR "hle " OPTIONSTR "hleon    Turn emulated register HLE on: passive reads without the ROM handler\n"
+    OPTIONSTR "nohle " OPTIONSTR "hleoff    Turn emulated register HLE off\n"
     OPTIONSTR "diskN:filePath    Attach disk image, N=0..3\n"
     OPTIONSTR "hardN:filePath    Attach hard disk image, N=1..2\n";
 
@@ -67,6 +73,9 @@ int main(int argc, char *argv[])
     ParseCommandLine(argc, argv);  // Override settings by command-line option if needed
 
     Emulator_SetSound(Settings_GetSound());
+    Emulator_SetBlockMode(Settings_GetBlockMode());
+    Emulator_SetNativeFIS(Settings_GetNativeFIS());
+    Emulator_SetEmulHLE(Settings_GetEmulHLE());
 
     if (!Emulator_Init())
         return 255;
@@ -186,6 +195,30 @@ void ParseCommandLine(int argc, char *argv[])
             {
                 Settings_SetSound(false);
             }
+            else if (option == "blocks" || option == "blockson")
+            {
+                Settings_SetBlockMode(true);
+            }
+            else if (option == "blocksoff" || option == "noblocks")
+            {
+                Settings_SetBlockMode(false);
+            }
+            else if (option == "fis" || option == "fison")
+            {
+                Settings_SetNativeFIS(true);
+            }
+            else if (option == "fisoff" || option == "nofis")
+            {
+                Settings_SetNativeFIS(false);
+            }
+            else if (option == "hle" || option == "hleon")
+            {
+                Settings_SetEmulHLE(true);
+            }
+            else if (option == "hleoff" || option == "nohle")
+            {
+                Settings_SetEmulHLE(false);
+            }
             else if (option.startsWith("disk") && option.length() > 6 && // "/diskN:filePath", N=0..3
                     option[4] >= '0' && option[4] <= '3' && option[5] == ':')
             {
@@ -35,6 +35,12 @@ void Settings_SetAutostart(bool flag);
 bool Settings_GetAutostart();
 void Settings_SetSound(bool flag);
 bool Settings_GetSound();
+void Settings_SetBlockMode(bool flag);
+bool Settings_GetBlockMode();
+void Settings_SetNativeFIS(bool flag);
+bool Settings_GetNativeFIS();
+void Settings_SetEmulHLE(bool flag);
+bool Settings_GetEmulHLE();
 void Settings_SetDebugMemoryMode(quint16 mode);
 quint16 Settings_GetDebugMemoryMode();
 void Settings_SetDebugMemoryAddress(quint16 address);
@@ -233,7 +233,8 @@ void QConsoleView::cmdShowHelp(const ConsoleCommandParams& /*params*/)
             "  so         Step Over; executes and stops after the current instruction\r\n"
             "  b          List breakpoints set\r\n"
             "  bXXXXXX    Set breakpoint at address XXXXXX\r\n"
-            "  bcXXXXXX   Remove breakpoint at address XXXXXX\r\n"
+            "  bXXXXXX-YYYYYY  Set breakpoint at every address from XXXXXX to YYYYYY\r\n"
+            "  bcXXXXXX   Remove breakpoint at address XXXXXX, or the range with it\r\n"
             "  bc         Remove all breakpoints\r\n"
 //            "  u          Save memory dump to file memdump.bin\r\n"
                   ));
@@ -416,10 +417,20 @@ void QConsoleView::cmdSetBreakpointAtAddress(const ConsoleCommandParams & params
     Global_RedrawDisasmView();
 }
 
+void QConsoleView::cmdSetBreakpointRange(const ConsoleCommandParams & params)
+{
+    bool result = Emulator_AddCPUBreakpointRange(params.paramOct1, params.paramOct2);
+    if (!result)
+        this->print(tr("  Failed to add breakpoint range.\r\n"));
+    Global_RedrawDebugView();
+    Global_RedrawDisasmView();
+}
+
 void QConsoleView::cmdPrintAllBreakpoints(const ConsoleCommandParams &)
 {
     const quint16* pbps = Emulator_GetCPUBreakpointList();
-    if (pbps == nullptr || *pbps == 0177777)
+    const quint16* pranges = Emulator_GetCPUBreakpointRangeList();
+    if ((pbps == nullptr || *pbps == 0177777) && *pranges == 0177777)
     {
         this->print(tr("  No breakpoints.\r\n"));
         return;
@@ -431,13 +442,19 @@ void QConsoleView::cmdPrintAllBreakpoints(const ConsoleCommandParams &)
         this->print(line);
         pbps++;
     }
+    while (*pranges != 0177777)
+    {
+        QString line;  line.sprintf("  %06ho-%06ho\r\n", pranges[0], pranges[1]);
+        this->print(line);
+        pranges += 2;
+    }
 }
 
 void QConsoleView::cmdRemoveBreakpointAtAddress(const ConsoleCommandParams & params)
 {
     quint16 value = params.paramOct1;
 
-    bool result = Emulator_RemoveCPUBreakpoint(value);
+    bool result = Emulator_RemoveCPUBreakpoint(value) || Emulator_RemoveCPUBreakpointRange(value);
     if (!result)
         this->print("  Failed to remove breakpoint.\r\n");
     Global_RedrawDebugView();
@@ -495,6 +512,7 @@ static ConsoleCommands[] =
     { _T("m"), ARGINFO_NONE, &QConsoleView::cmdPrintMemoryDumpAtPC },
     { _T("g%ho"), ARGINFO_OCT, &QConsoleView::cmdRunToAddress },
     { _T("g"), ARGINFO_NONE, &QConsoleView::cmdRun },
+    { _T("b%ho-%ho"), ARGINFO_OCT_OCT, &QConsoleView::cmdSetBreakpointRange },
     { _T("b%ho"), ARGINFO_OCT, &QConsoleView::cmdSetBreakpointAtAddress },
     { _T("b"), ARGINFO_NONE, &QConsoleView::cmdPrintAllBreakpoints },
     { _T("bc%ho"), ARGINFO_OCT, &QConsoleView::cmdRemoveBreakpointAtAddress },
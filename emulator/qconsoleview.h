@@ -69,6 +69,7 @@ public:
     void cmdRunToAddress(const ConsoleCommandParams& params);
     void cmdRun(const ConsoleCommandParams& params);
     void cmdSetBreakpointAtAddress(const ConsoleCommandParams& params);
+    void cmdSetBreakpointRange(const ConsoleCommandParams& params);
     void cmdPrintAllBreakpoints(const ConsoleCommandParams& params);
     void cmdRemoveBreakpointAtAddress(const ConsoleCommandParams& params);
     void cmdRemoveAllBreakpoints(const ConsoleCommandParams& params);
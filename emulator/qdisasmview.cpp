@@ -74,9 +74,9 @@ void QDisasmView::mousePressEvent(QMouseEvent * event)
                         if (!result)
                             AlertWarning(tr("Failed to add breakpoint at %1.").arg(address, 6, 8, QLatin1Char('0')));
                     }
-                    else
+                    else  // The breakpoint itself, or else the range the address is in
                     {
-                        bool result = Emulator_RemoveCPUBreakpoint(address);
+                        bool result = Emulator_RemoveCPUBreakpoint(address) || Emulator_RemoveCPUBreakpointRange(address);
                         if (!result)
                             AlertWarning(tr("Failed to remove breakpoint at %1.").arg(address, 6, 8, QLatin1Char('0')));
                     }
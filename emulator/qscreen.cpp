@@ -1,4 +1,4 @@
-#include "stdafx.h"
+﻿#include "stdafx.h"
 #include <QtGui>
 #include <QMenu>
 #include "qscreen.h"
@@ -51,6 +51,7 @@ void QEmulatorScreen::createDisplay()
     Emulator_GetScreenSize(m_mode, &cxScreenWidth, &cyScreenHeight);
 
     m_image = new QImage(cxScreenWidth, cyScreenHeight, QImage::Format_RGB32);
+    Emulator_InvalidateScreen();  // The new image may reuse the bits of the old one
 
     setMinimumSize(cxScreenWidth, cyScreenHeight);
     setMaximumSize(cxScreenWidth + 60, cyScreenHeight + 40);
@@ -58,7 +59,7 @@ void QEmulatorScreen::createDisplay()
 
 void QEmulatorScreen::paintEvent(QPaintEvent * /*event*/)
 {
-    Emulator_PrepareScreenRGB32(m_image->bits(), m_mode);
+    Emulator_PrepareScreenRGB32(m_image->bits(), m_image->width(), m_image->height());
 
     QPainter painter(this);
     painter.drawImage(0, 0, *m_image);
@@ -2,12 +2,8 @@
 #include "QAudioFormat"
 
 QSoundOut::QSoundOut(QObject *parent) :
-    QObject(parent)
+    QObject(parent), m_ringrd(0), m_ringwr(0), m_underruns(0), m_overruns(0), m_running(0)
 {
-    rcnt = 0;
-    rrd = 0;
-    rwr = 0;
-    fptr = 0;
     m_audio = nullptr;
     m_dev = nullptr;
 
@@ -52,62 +48,55 @@ QSoundOut::~QSoundOut()
 
 void QSoundOut::OnNotify()
 {
-    char dummy[FRAMEBYTES];
+    unsigned char buffer[FRAMEBYTES];
 
     if ((m_dev == nullptr) || (m_audio == nullptr))
         return;
 
-    m_lock.lock();
-    if (rcnt)
-    {
-        m_dev->write((const char*)&rbuf[rrd], (qint64)FRAMEBYTES);
-        rrd++;
-        if (rrd >= BUFFERS)
-            rrd = 0;
-        rcnt--;
-    }
-    else
+    unsigned int rd = (unsigned int)m_ringrd.loadAcquire();
+    unsigned int count = (unsigned int)m_ringwr.loadAcquire() - rd;
+    if (count > FRAMESAMPLES)
+        count = FRAMESAMPLES;
+    if (count < FRAMESAMPLES && (count > 0 || m_running.loadAcquire() != 0))  // No samples while stopped is not an underrun
+        m_underruns.fetchAndAddRelaxed(1);
+
+    int bptr = 0;
+    for (unsigned int i = 0; i < count; i++)
     {
-        memset(dummy, 0, FRAMEBYTES);
-        m_dev->write((const char*)dummy, (qint64)FRAMEBYTES);
+        quint32 sample = m_ring[(rd + i) & (RINGSAMPLES - 1)];
+        unsigned short left = (unsigned short)(sample & 0xffff);
+        unsigned short right = (unsigned short)(sample >> 16);
+        switch (SAMPLESIZE)
+        {
+        case 8:
+            buffer[bptr++] = left >> 8;
+            buffer[bptr++] = right >> 8;
+            break;
+        case 16:
+            buffer[bptr++] = left & 0xff;
+            buffer[bptr++] = left >> 8;
+            buffer[bptr++] = right & 0xff;
+            buffer[bptr++] = right >> 8;
+            break;
+        }
     }
-    m_lock.unlock();
+    m_ringrd.storeRelease((int)(rd + count));
+
+    memset(buffer + bptr, 0, FRAMEBYTES - bptr);
+    m_dev->write((const char*)buffer, (qint64)FRAMEBYTES);
 }
 
 void QSoundOut::FeedDAC(unsigned short left, unsigned short right)
 {
     if ((m_dev == nullptr) || (m_audio == nullptr))
         return;
-    switch (SAMPLESIZE)
-    {
-    case 8:
-        fbuf[fptr++] = left >> 8;
-        fbuf[fptr++] = right >> 8;
-        break;
-    case 16:
-        fbuf[fptr++] = left & 0xff;
-        fbuf[fptr++] = left >> 8;
-        fbuf[fptr++] = right & 0xff;
-        fbuf[fptr++] = right >> 8;
-        break;
-    }
-    if (fptr >= FRAMEBYTES)
+
+    unsigned int wr = (unsigned int)m_ringwr.loadAcquire();
+    if (wr - (unsigned int)m_ringrd.loadAcquire() >= RINGSAMPLES)
     {
-        fptr = 0;
-        m_lock.lock();
-        if (rcnt >= BUFFERS)
-        {
-            m_dev->write((const char*)&rbuf[rrd], (qint64)FRAMEBYTES);
-            rrd++;
-            if (rrd >= BUFFERS)
-                rrd = 0;
-            rcnt--;
-        }
-        memcpy(&rbuf[rwr], fbuf, FRAMEBYTES);
-        rwr++;
-        if (rwr >= BUFFERS)
-            rwr = 0;
-        rcnt++;
-        m_lock.unlock();
+        m_overruns.fetchAndAddRelaxed(1);
+        return;
     }
+    m_ring[wr & (RINGSAMPLES - 1)] = (quint32)left | ((quint32)right << 16);
+    m_ringwr.storeRelease((int)(wr + 1));
 }
@@ -4,16 +4,18 @@
 #include <QObject>
 #include <QAudioOutput>
 #include <QIODevice>
-#include <QMutex>
+#include <QAtomicInt>
 #include <QTimer>
 
-#define SAMPLERATE          22050
+#define SAMPLERATE          44100
 #define FRAMESAMPLES        (SAMPLERATE/25)
 #define SAMPLESIZE          16
 #define CHANNELS            2
 #define FRAMEBYTES          ((FRAMESAMPLES)*(SAMPLESIZE/8)*CHANNELS)
-#define BUFFERS             5
+#define RINGSAMPLES         8192    // Ring size in samples, power of two, about 5 frames
 
+// The emulator thread feeds the samples, the audio notify takes them out; the ring has one producer
+// and one consumer, so the indices only are atomic and nobody waits for a lock
 class QSoundOut : public QObject
 {
     Q_OBJECT
@@ -21,6 +23,10 @@ public:
     explicit QSoundOut(QObject *parent = nullptr);
     ~QSoundOut();
 
+    int GetUnderrunCount() const { return m_underruns.loadAcquire(); }  // Frames padded with silence
+    int GetOverrunCount() const { return m_overruns.loadAcquire(); }  // Samples dropped on the full ring
+    void SetRunning(bool okRunning) { m_running.storeRelease(okRunning ? 1 : 0); }  // Samples are expected
+
 signals:
 
 public slots:
@@ -32,14 +38,13 @@ private slots:
 private:
     QAudioOutput * m_audio;
     QIODevice * m_dev;
-    QMutex  m_lock;
     QTimer m_kick;
-    unsigned char rbuf[BUFFERS][FRAMEBYTES];
-    unsigned char fbuf[FRAMEBYTES];
-    int rcnt;
-    int rrd;
-    int rwr;
-    int fptr;
+    quint32 m_ring[RINGSAMPLES];  // Samples, left in the low word, right in the high word
+    QAtomicInt m_ringrd;  // Free running read index, the consumer only writes it
+    QAtomicInt m_ringwr;  // Free running write index, the producer only writes it
+    QAtomicInt m_underruns;
+    QAtomicInt m_overruns;
+    QAtomicInt m_running;
 };
 
 #endif // QSOUNDOUT_H